@@ -24,6 +24,7 @@
 #include "buffer_pool.h"
 #include "x3a_result_factory.h"
 #include "smart_analyzer.h"
+#include "frame_recorder.h"
 
 using namespace XCam;
 
@@ -54,7 +55,7 @@ private:
     void close_file ();
 
 private:
-    FILE *_file;
+    SmartPtr<FrameRecorder> _recorder;
     bool _save_file;
     uint32_t _interval;
     uint32_t _frame_save;
@@ -63,14 +64,18 @@ private:
 };
 
 FrameSaver::FrameSaver (bool save, uint32_t interval, uint32_t count)
-    : _file (NULL)
-    , _save_file (save)
+    : _save_file (save)
     , _interval (interval)
     , _frame_save (count)
     , _frame_count (0)
 {
 }
 
+FrameSaver::~FrameSaver ()
+{
+    close_file ();
+}
+
 void
 FrameSaver::save_frame (XCamVideoBuffer *buffer)
 {
@@ -89,37 +94,35 @@ FrameSaver::save_frame (XCamVideoBuffer *buffer)
 
     open_file ();
 
-    if (!_file) {
+    if (!_recorder.ptr ()) {
         XCAM_LOG_ERROR ("open file failed");
         return;
     }
 
-    if (fwrite (buffer->data, buffer->info.size, 1, _file) <= 0) {
-        XCAM_LOG_WARNING ("write frame failed.");
-    }
-    close_file ();
+    _recorder->record (buffer);
 }
 
+// one raw .yuv file per saved frame, recorder of previous frame closed here
 void
 FrameSaver::open_file ()
 {
-    if ((_file) && (_frame_save == 0))
-        return;
-
     char file_name[512];
-    if (_frame_save != 0) {
-        snprintf (file_name, sizeof(file_name), "%s%d%s", DEFAULT_SAVE_FRAME_NAME, _frame_count, ".yuv");
-    }
 
-    _file = fopen(file_name, "wb");
+    close_file ();
+    snprintf (file_name, sizeof(file_name), "%s%d%s", DEFAULT_SAVE_FRAME_NAME, _frame_count, ".yuv");
+
+    _recorder = new FrameRecorder (file_name);
+    _recorder->set_frame_header (false);
+    if (_recorder->start () != XCAM_RETURN_NO_ERROR)
+        _recorder.release ();
 }
 
 void
 FrameSaver::close_file ()
 {
-    if (_file)
-        fclose (_file);
-    _file = NULL;
+    if (_recorder.ptr ())
+        _recorder->stop ();
+    _recorder.release ();
 }
 
 class SampleHandler
@@ -0,0 +1,302 @@
+/*
+ * test-3a-replay.cpp - replay recorded 3a stats through an analyzer
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "x3a_analyzer_simple.h"
+#include "x3a_analyzer_loader.h"
+#include "x3a_stats_recorder.h"
+#include "latency_histogram.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include "test_common.h"
+
+#define MAX_REPORTED_DIFFS   10
+
+using namespace XCam;
+
+enum AnalyzerType {
+    AnalyzerTypeSimple = 0,
+    AnalyzerTypeDynamic,
+};
+
+struct ReplayFrame {
+    int64_t       timestamp;
+    int64_t       analyze_time;
+    std::string   results;
+};
+
+typedef std::vector<ReplayFrame> ReplayFrameList;
+
+// analyzer runs in sync mode, results arrive within push_3a_stats
+class ReplayCallback
+    : public AnalyzerCallback
+{
+public:
+    virtual void x3a_calculation_done (XAnalyzer *analyzer, X3aResultList &results);
+    virtual void x3a_calculation_failed (XAnalyzer *analyzer, int64_t timestamp, const char *msg) {
+        XCAM_UNUSED (analyzer);
+        XCAM_LOG_WARNING ("analysis of stats(ts:%" PRId64 ") failed: %s", timestamp, XCAM_STR (msg));
+        _pending += "failed ";
+    }
+
+    void take_results (std::string &results) {
+        results.swap (_pending);
+        _pending.clear ();
+    }
+
+private:
+    std::string   _pending;
+};
+
+void
+ReplayCallback::x3a_calculation_done (XAnalyzer *analyzer, X3aResultList &results)
+{
+    char str[128];
+
+    XCAM_UNUSED (analyzer);
+    for (X3aResultList::iterator i_res = results.begin (); i_res != results.end (); ++i_res) {
+        SmartPtr<X3aResult> &res = *i_res;
+        SmartPtr<X3aExposureResult> exposure = res.dynamic_cast_ptr<X3aExposureResult> ();
+        SmartPtr<X3aWhiteBalanceResult> wb = res.dynamic_cast_ptr<X3aWhiteBalanceResult> ();
+
+        if (exposure.ptr ()) {
+            const XCam3aResultExposure &value = exposure->get_standard_result ();
+            snprintf (
+                str, sizeof (str), "ae:%d/%.4f/%.4f ",
+                value.exposure_time, value.analog_gain, value.digital_gain);
+        } else if (wb.ptr ()) {
+            const XCam3aResultWhiteBalance &value = wb->get_standard_result ();
+            snprintf (
+                str, sizeof (str), "awb:%.4f/%.4f/%.4f/%.4f ",
+                value.r_gain, value.gr_gain, value.gb_gain, value.b_gain);
+        } else {
+            snprintf (str, sizeof (str), "type%d ", res->get_type ());
+        }
+        _pending += str;
+    }
+}
+
+static SmartPtr<X3aAnalyzer>
+create_analyzer (AnalyzerType type, const char *lib_path, SmartPtr<X3aAnalyzerLoader> &loader)
+{
+    SmartPtr<X3aAnalyzer> analyzer;
+
+    switch (type) {
+    case AnalyzerTypeSimple:
+        analyzer = new X3aAnalyzerSimple ();
+        break;
+    case AnalyzerTypeDynamic:
+        loader = new X3aAnalyzerLoader (lib_path);
+        analyzer = loader->load_dynamic_analyzer (loader);
+        break;
+    }
+    return analyzer;
+}
+
+static int
+replay_once (
+    X3aStatsReader &reader, AnalyzerType type, const char *lib_path, double framerate,
+    ReplayFrameList &frames)
+{
+    XCamReturn ret = XCAM_RETURN_NO_ERROR;
+    SmartPtr<X3aAnalyzerLoader> loader;
+    SmartPtr<X3aAnalyzer> analyzer;
+    SmartPtr<X3aStats> stats;
+    ReplayCallback callback;
+    const XCam3AStatsInfo *info = NULL;
+
+    CHECK (reader.rewind (), "rewind stats recording failed");
+    ret = reader.read (stats);
+    CHECK_EXP (ret == XCAM_RETURN_NO_ERROR, "no stats in recording");
+    info = &stats->get_stats ()->info;
+
+    analyzer = create_analyzer (type, lib_path, loader);
+    CHECK_EXP (analyzer.ptr (), "create analyzer failed");
+    analyzer->set_sync_mode (true);
+    analyzer->set_results_callback (&callback);
+    CHECK (analyzer->prepare_handlers (), "analyzer prepare handlers failed");
+    CHECK (
+        analyzer->init (info->width * info->grid_pixel_size, info->height * info->grid_pixel_size, framerate),
+        "analyzer init failed");
+    CHECK (analyzer->start (), "analyzer start failed");
+
+    frames.clear ();
+    while (ret == XCAM_RETURN_NO_ERROR) {
+        ReplayFrame frame;
+        int64_t start_time = xcam_get_monotonic_time ();
+
+        frame.timestamp = stats->get_timestamp ();
+        ret = analyzer->push_3a_stats (stats);
+        frame.analyze_time = xcam_get_monotonic_time () - start_time;
+        CHECK_CONTINUE (ret, "analyze stats(ts:%" PRId64 ") failed", frame.timestamp);
+        callback.take_results (frame.results);
+        frames.push_back (frame);
+
+        stats.release ();
+        ret = reader.read (stats);
+    }
+
+    analyzer->stop ();
+    analyzer->deinit ();
+    CHECK_EXP (ret == XCAM_RETURN_BYPASS, "read stats recording failed");
+    return 0;
+}
+
+static void
+print_timing (const ReplayFrameList &frames, uint32_t run)
+{
+    LatencyHistogram histogram;
+
+    for (uint32_t i = 0; i < frames.size (); ++i)
+        histogram.add (frames[i].analyze_time);
+
+    printf (
+        "run %d: %" PRIu64 " frames, analyze time(us) mean:%" PRId64 " p50:%" PRId64
+        " p99:%" PRId64 " max:%" PRId64 "\n",
+        run, histogram.get_count (), histogram.get_mean (),
+        histogram.get_percentile (50), histogram.get_percentile (99), histogram.get_max ());
+}
+
+static uint32_t
+diff_runs (const ReplayFrameList &base, const ReplayFrameList &frames, uint32_t run)
+{
+    uint32_t diffs = 0;
+
+    if (base.size () != frames.size ())
+        printf ("run %d: %d frames, run 0 had %d\n", run, (int)frames.size (), (int)base.size ());
+
+    for (uint32_t i = 0; i < XCAM_MIN (base.size (), frames.size ()); ++i) {
+        if (base[i].results == frames[i].results)
+            continue;
+        if (diffs < MAX_REPORTED_DIFFS)
+            printf (
+                "run %d: frame %d differs\n\trun 0: %s\n\trun %d: %s\n",
+                run, i, base[i].results.c_str (), run, frames[i].results.c_str ());
+        ++diffs;
+    }
+    return diffs;
+}
+
+static bool
+save_frames (const char *path, const ReplayFrameList &frames)
+{
+    FILE *file = fopen (path, "w");
+
+    CHECK_DECLARE (ERROR, file, return false, "open results file(%s) failed", path);
+    fprintf (file, "# frame timestamp analyze_time(us) results\n");
+    for (uint32_t i = 0; i < frames.size (); ++i)
+        fprintf (
+            file, "%d %" PRId64 " %" PRId64 " %s\n",
+            i, frames[i].timestamp, frames[i].analyze_time, frames[i].results.c_str ());
+    fclose (file);
+    return true;
+}
+
+void print_help (const char *bin_name)
+{
+    printf ("Usage: %s -i stats_file [-a analyzer]\n"
+            "\t -i stats_file  stats recorded by test-device-manager --record-stats\n"
+            "\t -a analyzer    specify a analyzer\n"
+            "\t                select from [simple, dynamic], default is [simple]\n"
+            "\t -l lib_path    3a library of dynamic analyzer, default is [%s]\n"
+            "\t -f framerate   framerate given to analyzer, default is [30]\n"
+            "\t -r runs        replay times, results of later runs diffed with first run\n"
+            "\t -o file        save per-frame analyze time and results of first run\n"
+            "\t -h             help\n"
+            , bin_name
+            , DEFAULT_DYNAMIC_3A_LIB);
+}
+
+int main (int argc, char *argv[])
+{
+    const char *input = NULL;
+    const char *output = NULL;
+    const char *lib_path = DEFAULT_DYNAMIC_3A_LIB;
+    AnalyzerType analyzer_type = AnalyzerTypeSimple;
+    double framerate = 30.0;
+    uint32_t runs = 1;
+    uint32_t total_diffs = 0;
+    ReplayFrameList base, frames;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "i:a:l:f:r:o:h")) != -1) {
+        switch (opt) {
+        case 'i':
+            input = optarg;
+            break;
+        case 'a': {
+            if (!strcasecmp (optarg, "simple"))
+                analyzer_type = AnalyzerTypeSimple;
+            else if (!strcasecmp (optarg, "dynamic"))
+                analyzer_type = AnalyzerTypeDynamic;
+            else {
+                print_help (argv[0]);
+                return -1;
+            }
+            break;
+        }
+        case 'l':
+            lib_path = optarg;
+            break;
+        case 'f':
+            framerate = atof (optarg);
+            break;
+        case 'r':
+            runs = atoi (optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'h':
+            print_help (argv[0]);
+            return 0;
+        default:
+            print_help (argv[0]);
+            return -1;
+        }
+    }
+
+    if (!input || !runs || framerate <= 0.0) {
+        print_help (argv[0]);
+        return -1;
+    }
+
+    X3aStatsReader reader (input);
+    CHECK (reader.open (), "open stats recording(%s) failed", input);
+
+    for (uint32_t run = 0; run < runs; ++run) {
+        ReplayFrameList &result = run ? frames : base;
+
+        if (replay_once (reader, analyzer_type, lib_path, framerate, result) != 0)
+            return -1;
+        print_timing (result, run);
+        if (run)
+            total_diffs += diff_runs (base, frames, run);
+    }
+
+    if (output && !save_frames (output, base))
+        return -1;
+
+    if (runs > 1)
+        printf ("determinism: %d frames differ in %d runs\n", total_diffs, runs);
+    return total_diffs ? -1 : 0;
+}
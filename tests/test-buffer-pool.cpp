@@ -0,0 +1,328 @@
+/*
+ * test-buffer-pool.cpp - test buffer pool under thread contention
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "xcam_utils.h"
+#include "host_buffer_pool.h"
+#include "xcam_thread.h"
+#include "ring_queue.h"
+#include <unistd.h>
+#include <inttypes.h>
+#include <vector>
+#include <getopt.h>
+#include <sys/time.h>
+#include "test_common.h"
+
+#define DEFAULT_THREAD_COUNT  4
+#define DEFAULT_LOOP_COUNT    100000
+#define DEFAULT_HOLD_COUNT    2
+#define DEFAULT_CACHE_SIZE    4
+#define HANDOFF_QUEUE_SIZE    4
+
+#define ELASTIC_RESERVE       2
+#define ELASTIC_HARD_CAP      4
+#define ELASTIC_IDLE_TIME     200000  // us
+#define ELASTIC_WAIT_TIMEOUT  10000   // us
+
+using namespace XCam;
+
+typedef SpscRingQueue<VideoBuffer> VideoBufList;
+
+/*
+ * producer gets @hold buffers from pool each loop, releases half of them
+ * and hands the others to a consumer thread which releases them there,
+ * buffers not fitting into the bounded hand-off queue are released by producer.
+ */
+class PoolProducer
+    : public Thread
+{
+public:
+    PoolProducer (SmartPtr<BufferPool> &pool, VideoBufList &queue, uint32_t loops, uint32_t hold)
+        : Thread ("PoolProducer")
+        , _pool (pool)
+        , _queue (queue)
+        , _loops (loops)
+        , _held (hold)
+        , _failed (0)
+    {}
+
+    uint32_t get_failed () const {
+        return _failed;
+    }
+
+protected:
+    virtual bool loop ();
+
+private:
+    SmartPtr<BufferPool>                  _pool;
+    VideoBufList                         &_queue;
+    uint32_t                              _loops;
+    std::vector<SmartPtr<BufferProxy> >   _held;
+    uint32_t                              _failed;
+};
+
+bool
+PoolProducer::loop ()
+{
+    if (!_loops--) {
+        while (!_queue.push (NULL))
+            usleep (100);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < _held.size (); ++i) {
+        _held[i] = _pool->get_buffer (_pool, 100000);
+        if (!_held[i].ptr ())
+            ++_failed;
+    }
+    for (uint32_t i = 0; i < _held.size (); ++i) {
+        SmartPtr<VideoBuffer> buf = std::move (_held[i]);
+        if (i % 2 == 0 && buf.ptr ())
+            _queue.push (std::move (buf));
+    }
+    return true;
+}
+
+class PoolConsumer
+    : public Thread
+{
+public:
+    PoolConsumer (VideoBufList &queue)
+        : Thread ("PoolConsumer")
+        , _queue (queue)
+    {}
+
+protected:
+    virtual bool loop () {
+        SmartPtr<VideoBuffer> buf = _queue.pop (-1);
+        return buf.ptr () != NULL;
+    }
+
+private:
+    VideoBufList          &_queue;
+};
+
+class ExhaustedCounter
+    : public BufferPoolCallback
+{
+public:
+    ExhaustedCounter ()
+        : _count (0)
+        , _in_flight (0)
+    {}
+
+    uint32_t get_count () const {
+        return _count;
+    }
+    uint32_t get_in_flight () const {
+        return _in_flight;
+    }
+
+    virtual void buffer_pool_exhausted (BufferPool *pool, const BufferPoolStats &stats) {
+        XCAM_UNUSED (pool);
+        ++_count;
+        _in_flight = stats.in_flight;
+    }
+
+private:
+    uint32_t    _count;
+    uint32_t    _in_flight;
+};
+
+/*
+ * single thread, no thread cache:
+ * pool grows up to hard cap, get_buffer times out with NULL past it,
+ * then shrinks one data per idle time back to reserved count
+ */
+static int
+run_elastic ()
+{
+    VideoBufferInfo info;
+    SmartPtr<BufferPool> pool = new HostBufferPool;
+    ExhaustedCounter counter;
+    std::vector<SmartPtr<BufferProxy> > held;
+    SmartPtr<BufferProxy> buf;
+    BufferPoolStats stats;
+
+    info.init (V4L2_PIX_FMT_NV12, 64, 64);
+    pool->set_video_info (info);
+    CHECK_EXP (pool->reserve (ELASTIC_RESERVE), "elastic: buffer pool reserve failed");
+    pool->set_elastic (ELASTIC_HARD_CAP, ELASTIC_IDLE_TIME);
+    pool->set_callback (&counter);
+
+    // grow
+    for (uint32_t i = 0; i < ELASTIC_HARD_CAP; ++i) {
+        held.push_back (pool->get_buffer (pool, 0));
+        CHECK_EXP (held.back ().ptr (), "elastic: get buffer %d failed below hard cap", i);
+    }
+    pool->get_stats (stats);
+    CHECK_EXP (
+        stats.allocated == ELASTIC_HARD_CAP && stats.grows == ELASTIC_HARD_CAP - ELASTIC_RESERVE,
+        "elastic: pool grew to %d with %" PRIu64 " grows, expected %d",
+        stats.allocated, stats.grows, ELASTIC_HARD_CAP);
+    CHECK_EXP (!counter.get_count (), "elastic: exhausted before hard cap");
+
+    // timeout at hard cap
+    buf = pool->get_buffer (pool, ELASTIC_WAIT_TIMEOUT);
+    CHECK_EXP (!buf.ptr (), "elastic: got buffer beyond hard cap");
+    pool->get_stats (stats);
+    CHECK_EXP (
+        stats.allocated == ELASTIC_HARD_CAP && stats.waits == 1 && stats.timeouts == 1,
+        "elastic: timeout counted wrong, allocated:%d, waits:%" PRIu64 ", timeouts:%" PRIu64,
+        stats.allocated, stats.waits, stats.timeouts);
+    CHECK_EXP (
+        counter.get_count () == 1 && counter.get_in_flight () == ELASTIC_HARD_CAP,
+        "elastic: exhausted callback fired %d times with %d in flight",
+        counter.get_count (), counter.get_in_flight ());
+
+    // released right after the wait, pool still busy, no shrink
+    held.clear ();
+    pool->get_stats (stats);
+    CHECK_EXP (
+        stats.allocated == ELASTIC_HARD_CAP && !stats.shrinks && !stats.in_flight,
+        "elastic: pool shrank while busy, allocated:%d", stats.allocated);
+
+    // shrink, one data per idle time
+    for (uint32_t i = 0; i < ELASTIC_HARD_CAP; ++i) {
+        held.push_back (pool->get_buffer (pool, 0));
+        CHECK_EXP (held.back ().ptr (), "elastic: get released buffer %d failed", i);
+    }
+    for (uint32_t i = 0; i < ELASTIC_HARD_CAP; ++i) {
+        usleep (ELASTIC_IDLE_TIME * 3 / 2);
+        held[i].release ();
+    }
+    pool->get_stats (stats);
+    CHECK_EXP (
+        stats.allocated == ELASTIC_RESERVE && stats.shrinks == ELASTIC_HARD_CAP - ELASTIC_RESERVE,
+        "elastic: pool shrank to %d with %" PRIu64 " shrinks, expected %d",
+        stats.allocated, stats.shrinks, ELASTIC_RESERVE);
+    CHECK_EXP (counter.get_count () == 1, "elastic: exhausted callback fired without shortage");
+
+    pool->stop ();
+    printf ("elastic: grew to %d, timed out once, shrank back to %d\n", ELASTIC_HARD_CAP, ELASTIC_RESERVE);
+    return 0;
+}
+
+static double
+run_contention (
+    uint32_t thread_count, uint32_t loops, uint32_t hold, uint32_t cache_size, uint32_t reserve)
+{
+    VideoBufferInfo info;
+    SmartPtr<BufferPool> pool = new HostBufferPool;
+    std::vector<SmartPtr<VideoBufList> > queues (thread_count);
+    std::vector<SmartPtr<PoolProducer> > producers (thread_count);
+    std::vector<SmartPtr<PoolConsumer> > consumers (thread_count);
+    BufferPoolStats stats;
+    uint32_t failed = 0;
+    struct timeval start, end;
+    double time_us = 0.0;
+
+    info.init (V4L2_PIX_FMT_NV12, 64, 64);
+    pool->set_video_info (info);
+    pool->set_thread_cache (cache_size);
+    if (!pool->reserve (reserve))
+        return -1.0;
+
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        queues[i] = new VideoBufList (HANDOFF_QUEUE_SIZE);
+        producers[i] = new PoolProducer (pool, *queues[i].ptr (), loops, hold);
+        consumers[i] = new PoolConsumer (*queues[i].ptr ());
+    }
+
+    gettimeofday (&start, NULL);
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        consumers[i]->start ();
+        producers[i]->start ();
+    }
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        while (producers[i]->is_running () || consumers[i]->is_running ())
+            usleep (1000);
+        failed += producers[i]->get_failed ();
+    }
+    gettimeofday (&end, NULL);
+
+    time_us = (end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec);
+    pool->get_stats (stats);
+    printf ("threads:%d, thread cache:%d, buffers:%d, waits:%" PRIu64 ", missed:%d, %.3f us per buffer\n",
+            thread_count, cache_size, stats.allocated, stats.waits, failed,
+            time_us / ((double)thread_count * loops * hold));
+
+    pool->stop ();
+    return time_us;
+}
+
+void print_help (const char *bin_name)
+{
+    printf ("Usage: %s [-t threads] [-n loops] [-b hold] [-s size]\n"
+            "\t -t threads   producer/consumer pairs, default is %d\n"
+            "\t -n loops     loops per producer, default is %d\n"
+            "\t -b hold      buffers got per loop, default is %d\n"
+            "\t -s size      thread cache size compared with no cache, default is %d\n"
+            "\t -h           help\n"
+            , bin_name
+            , DEFAULT_THREAD_COUNT
+            , DEFAULT_LOOP_COUNT
+            , DEFAULT_HOLD_COUNT
+            , DEFAULT_CACHE_SIZE);
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t thread_count = DEFAULT_THREAD_COUNT;
+    uint32_t loops = DEFAULT_LOOP_COUNT;
+    uint32_t hold = DEFAULT_HOLD_COUNT;
+    uint32_t cache_size = DEFAULT_CACHE_SIZE;
+    uint32_t reserve = 0;
+    double shared_time = 0.0, cached_time = 0.0;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "t:n:b:s:h")) != -1) {
+        switch (opt) {
+        case 't':
+            thread_count = atoi (optarg);
+            break;
+        case 'n':
+            loops = atoi (optarg);
+            break;
+        case 'b':
+            hold = atoi (optarg);
+            break;
+        case 's':
+            cache_size = atoi (optarg);
+            break;
+        case 'h':
+            print_help (argv[0]);
+            return 0;
+        default:
+            print_help (argv[0]);
+            return -1;
+        }
+    }
+    CHECK_EXP (thread_count > 0 && loops > 0 && hold > 0, "threads, loops and hold must be positive");
+    CHECK_EXP (run_elastic () == 0, "elastic buffer pool test failed");
+
+    // same pool size for both runs, enough to fill every magazine
+    reserve = thread_count * (hold + HANDOFF_QUEUE_SIZE + cache_size * 2);
+    shared_time = run_contention (thread_count, loops, hold, 0, reserve);
+    cached_time = run_contention (thread_count, loops, hold, cache_size, reserve);
+    CHECK_EXP (shared_time > 0.0 && cached_time > 0.0, "buffer pool reserve failed");
+
+    printf ("thread cache speedup: %.2fx\n", shared_time / cached_time);
+    return 0;
+}
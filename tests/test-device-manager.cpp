@@ -21,9 +21,12 @@
 #include "device_manager.h"
 #include "atomisp_device.h"
 #include "uvc_device.h"
+#include "virtual_v4l2_device.h"
 #include "isp_controller.h"
 #include "isp_image_processor.h"
 #include "x3a_analyzer_simple.h"
+#include "xcam_trace.h"
+#include "frame_recorder.h"
 #if HAVE_IA_AIQ
 #include "x3a_analyzer_aiq.h"
 #endif
@@ -56,8 +59,7 @@ class MainDeviceManager
 {
 public:
     MainDeviceManager ()
-        : _file (NULL)
-        , _save_file (false)
+        : _save_file (false)
         , _interval (1)
         , _frame_count (0)
         , _frame_save (0)
@@ -66,7 +68,6 @@ public:
 #if HAVE_LIBDRM
         _display = DrmDisplay::instance();
 #endif
-        XCAM_OBJ_PROFILING_INIT;
     }
 
     ~MainDeviceManager () {
@@ -101,14 +102,13 @@ private:
     void open_file ();
     void close_file ();
 
-    FILE      *_file;
+    SmartPtr<FrameRecorder> _recorder;
     bool       _save_file;
     uint32_t   _interval;
     uint32_t   _frame_count;
     uint32_t   _frame_save;
     SmartPtr<DrmDisplay> _display;
     bool       _enable_display;
-    XCAM_OBJ_PROFILING_DEFINES;
 };
 
 void
@@ -122,12 +122,10 @@ MainDeviceManager::handle_buffer (const SmartPtr<VideoBuffer> &buf)
 {
     FPS_CALCULATION (fps_buf, 30);
 
-    XCAM_OBJ_PROFILING_START;
-
-    if (_enable_display)
+    if (_enable_display) {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_PROCESSOR, "main_dev_manager_display");
         display_buf (buf);
-
-    XCAM_OBJ_PROFILING_END("main_dev_manager_display", 30);
+    }
 
     if (!_save_file)
         return ;
@@ -142,51 +140,14 @@ MainDeviceManager::handle_buffer (const SmartPtr<VideoBuffer> &buf)
         return;
     }
 
-    const VideoBufferInfo & frame_info = buf->get_video_info ();
-    uint8_t *frame = buf->map ();
-
-    if (frame == NULL)
-        return;
-
-    uint32_t size = 0;
-
-    switch(frame_info.format)  {
-    case V4L2_PIX_FMT_NV12:  // 420
-    case V4L2_PIX_FMT_NV21:
-        size = XCAM_ALIGN_UP(frame_info.width, 2) * XCAM_ALIGN_UP(frame_info.height, 2) * 3 / 2;
-        break;
-    case V4L2_PIX_FMT_YUV422P: // 422 Planar
-    case V4L2_PIX_FMT_YUYV: // 422
-    case V4L2_PIX_FMT_SBGGR10:
-    case V4L2_PIX_FMT_SGBRG10:
-    case V4L2_PIX_FMT_SGRBG10:
-    case V4L2_PIX_FMT_SRGGB10:
-    case V4L2_PIX_FMT_SBGGR12:
-    case V4L2_PIX_FMT_SGBRG12:
-    case V4L2_PIX_FMT_SGRBG12:
-    case V4L2_PIX_FMT_SRGGB12:
-        size = XCAM_ALIGN_UP(frame_info.width, 2) * XCAM_ALIGN_UP(frame_info.height, 2) * 2;
-        break;
-    case XCAM_PIX_FMT_RGBA64:
-        size = XCAM_ALIGN_UP(frame_info.width, 2) * XCAM_ALIGN_UP(frame_info.height, 2) * 2 * 4;
-        break;
-    default:
-        XCAM_LOG_ERROR (
-            "unknown v4l2 format(%s) in buffer handle",
-            xcam_fourcc_to_string (frame_info.format));
-        return;
-    }
-
     open_file ();
 
-    if (!_file) {
+    if (!_recorder.ptr ()) {
         XCAM_LOG_ERROR ("open file failed");
         return;
     }
 
-    if (fwrite (frame, size, 1, _file) <= 0) {
-        XCAM_LOG_WARNING ("write frame failed.");
-    }
+    _recorder->record (buf);
 }
 
 int
@@ -214,25 +175,25 @@ MainDeviceManager::display_buf (const SmartPtr<VideoBuffer> &data)
 void
 MainDeviceManager::open_file ()
 {
-    if ((_file) && (_frame_save == 0))
+    if (_recorder.ptr ())
         return;
 
     std::string file_name = DEFAULT_SAVE_FILE_NAME;
-
-    if (_frame_save != 0) {
-        file_name += std::to_string(_frame_count);
-    }
     file_name += ".raw";
 
-    _file = fopen(file_name.c_str(), "wb");
+    _recorder = new FrameRecorder (file_name.c_str ());
+    // copy, pipeline buffers go back to pools before disk write
+    _recorder->set_copy_buffers (true);
+    if (_recorder->start () != XCAM_RETURN_NO_ERROR)
+        _recorder.release ();
 }
 
 void
 MainDeviceManager::close_file ()
 {
-    if (_file)
-        fclose (_file);
-    _file = NULL;
+    if (_recorder.ptr ())
+        _recorder->stop ();
+    _recorder.release ();
 }
 
 #define V4L2_CAPTURE_MODE_STILL   0x2000
@@ -283,6 +244,12 @@ void print_help (const char *bin_name)
             "\t -e display_mode    preview mode\n"
             "\t                select from [primary, overlay], default is [primary]\n"
             "\t --sync        set analyzer in sync mode\n"
+            "\t --epoll       poll capture and event devices in one epoll thread\n"
+            "\t --virtual     specify raw frames file or directory to replay instead of capture\n"
+            "\t --virtual-rate    replay rate of virtual device\n"
+            "\t               select from [fixed, free, timestamps], default is [fixed]\n"
+            "\t --virtual-stats   generate 3a stats from replayed frames\n"
+            "\t --record-stats    record 3a stats to file for test-3a-replay\n"
             "\t -h            help\n"
 #if HAVE_LIBCL
             "CL features:\n"
@@ -348,6 +315,11 @@ int main (int argc, char *argv[])
     int32_t brightness_level = 128;
     bool    have_usbcam = 0;
     char*   usb_device_name = NULL;
+    const char *virtual_source = NULL;
+    VirtualCaptureRate virtual_rate = VIRTUAL_CAPTURE_RATE_FIXED;
+    bool virtual_stats = false;
+    const char *record_stats = NULL;
+    SmartPtr<X3aStatsRecorder> stats_recorder;
     bool sync_mode = false;
     int frame_rate;
 
@@ -364,6 +336,11 @@ int main (int argc, char *argv[])
         {"enable-tonemapping", no_argument, NULL, 'M'},
         {"usb", required_argument, NULL, 'U'},
         {"sync", no_argument, NULL, 'Y'},
+        {"epoll", no_argument, NULL, 'O'},
+        {"virtual", required_argument, NULL, 'V'},
+        {"virtual-rate", required_argument, NULL, 'R'},
+        {"virtual-stats", no_argument, NULL, 'A'},
+        {"record-stats", required_argument, NULL, 'W'},
         {"capture", required_argument, NULL, 'C'},
         {"pipeline", required_argument, NULL, 'P'},
         {0, 0, 0, 0},
@@ -459,6 +436,31 @@ int main (int argc, char *argv[])
         case 'Y':
             sync_mode = true;
             break;
+        case 'O':
+            device_manager->set_poll_mode (POLL_MODE_EPOLL);
+            break;
+        case 'V':
+            virtual_source = optarg;
+            break;
+        case 'R': {
+            if (!strcmp (optarg, "fixed"))
+                virtual_rate = VIRTUAL_CAPTURE_RATE_FIXED;
+            else if (!strcmp (optarg, "free"))
+                virtual_rate = VIRTUAL_CAPTURE_RATE_FREE_RUN;
+            else if (!strcmp (optarg, "timestamps"))
+                virtual_rate = VIRTUAL_CAPTURE_RATE_TIMESTAMPS;
+            else {
+                print_help (bin_name);
+                return -1;
+            }
+            break;
+        }
+        case 'A':
+            virtual_stats = true;
+            break;
+        case 'W':
+            record_stats = optarg;
+            break;
 #if HAVE_LIBCL
         case 'H': {
             if (!strcasecmp (optarg, "rgb"))
@@ -551,7 +553,13 @@ int main (int argc, char *argv[])
         device_manager->set_display_mode (display_mode);
     }
     if (!device.ptr ())  {
-        if (have_usbcam) {
+        if (virtual_source) {
+            SmartPtr<VirtualV4l2Device> virtual_device = new VirtualV4l2Device (virtual_source);
+            virtual_device->set_capture_rate (virtual_rate);
+            if (virtual_stats)
+                virtual_device->set_stats_callback (device_manager.ptr ());
+            device = virtual_device;
+        } else if (have_usbcam) {
             device = new UVCDevice (usb_device_name);
         } else {
             if (capture_mode == V4L2_CAPTURE_MODE_STILL)
@@ -564,7 +572,8 @@ int main (int argc, char *argv[])
     }
     if (!event_device.ptr ())
         event_device = new V4l2SubDevice (DEFAULT_EVENT_DEVICE);
-    if (!isp_controller.ptr ())
+    // no isp behind virtual sources
+    if (!isp_controller.ptr () && !virtual_source)
         isp_controller = new IspController (device);
 
     switch (analyzer_type) {
@@ -573,9 +582,11 @@ int main (int argc, char *argv[])
         break;
 #if HAVE_IA_AIQ
     case AnalyzerTypeAiq:
+        CHECK_EXP (isp_controller.ptr (), "aiq analyzer needs isp, not supported with virtual source");
         analyzer = new X3aAnalyzerAiq (isp_controller, DEFAULT_CPF_FILE);
         break;
     case AnalyzerTypeHybrid: {
+        CHECK_EXP (isp_controller.ptr (), "hybrid analyzer needs isp, not supported with virtual source");
         path_of_3a = DEFAULT_HYBRID_3A_LIB;
         loader = new X3aAnalyzerLoader (path_of_3a);
         analyzer = loader->load_hybrid_analyzer (loader, isp_controller, DEFAULT_CPF_FILE);
@@ -617,7 +628,8 @@ int main (int argc, char *argv[])
     ret = device->set_format (1920, 1080, pixel_format, V4L2_FIELD_NONE, 1920 * 2);
     CHECK (ret, "device(%s) set format failed", device->get_device_name());
 
-    ret = event_device->open ();
+    // no 3a events without isp
+    ret = virtual_source ? XCAM_RETURN_ERROR_PARAM : event_device->open ();
     if (ret == XCAM_RETURN_NO_ERROR) {
         CHECK (ret, "event device(%s) open failed", event_device->get_device_name());
         int event = V4L2_EVENT_ATOMISP_3A_STATS_READY;
@@ -637,17 +649,24 @@ int main (int argc, char *argv[])
     }
 
     device_manager->set_capture_device (device);
-    device_manager->set_isp_controller (isp_controller);
+    if (isp_controller.ptr ())
+        device_manager->set_isp_controller (isp_controller);
     if (analyzer.ptr())
         device_manager->set_3a_analyzer (analyzer);
+    if (record_stats) {
+        stats_recorder = new X3aStatsRecorder (record_stats);
+        CHECK (stats_recorder->open (), "open stats recording(%s) failed", record_stats);
+        device_manager->set_stats_recorder (stats_recorder);
+    }
 
-    if (have_cl_processor)
-        isp_processor = new IspExposureImageProcessor (isp_controller);
-    else
+    // without isp, cl processor alone, or isp processor passing frames through
+    if (!have_cl_processor)
         isp_processor = new IspImageProcessor (isp_controller);
+    else if (isp_controller.ptr ())
+        isp_processor = new IspExposureImageProcessor (isp_controller);
 
-    XCAM_ASSERT (isp_processor.ptr ());
-    device_manager->add_image_processor (isp_processor);
+    if (isp_processor.ptr ())
+        device_manager->add_image_processor (isp_processor);
 #if HAVE_LIBCL
     if ((display_mode == DRM_DISPLAY_MODE_PRIMARY) && need_display && (!have_cl_processor)) {
         cl_csc_proccessor = new CLCscImageProcessor();
@@ -0,0 +1,257 @@
+/*
+ * test-multi-stream.cpp - test multi stream manager with virtual sources
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "multi_stream_manager.h"
+#include "virtual_v4l2_device.h"
+#include "x3a_analyzer_simple.h"
+#include <unistd.h>
+#include <inttypes.h>
+#include <atomic>
+#include "test_common.h"
+
+#define TEST_STREAM_COUNT    2
+#define TEST_WIDTH           64
+#define TEST_HEIGHT          48
+#define TEST_FRAME_COUNT     8
+#define TEST_FRAMERATE       100     // per stream
+#define TEST_RUN_TIME        500000  // us
+#define TEST_SLOW_PROCESS    20000   // us per frame of shared processor, slower than both streams
+
+using namespace XCam;
+
+/*
+ * frames passed through unchanged, @delay per frame,
+ * frames of all streams counted by stream id
+ */
+class PassThroughProcessor
+    : public ImageProcessor
+{
+public:
+    PassThroughProcessor (const char *name, int64_t delay)
+        : ImageProcessor (name)
+        , _delay (delay)
+    {
+        for (uint32_t i = 0; i < TEST_STREAM_COUNT; ++i)
+            _processed[i] = 0;
+    }
+
+    uint64_t get_processed (uint32_t stream_id) const {
+        return _processed[stream_id].load ();
+    }
+
+protected:
+    virtual bool can_process_result (SmartPtr<X3aResult> &result) {
+        XCAM_UNUSED (result);
+        return false;
+    }
+    virtual XCamReturn apply_3a_results (X3aResultList &results) {
+        XCAM_UNUSED (results);
+        return XCAM_RETURN_NO_ERROR;
+    }
+    virtual XCamReturn apply_3a_result (SmartPtr<X3aResult> &result) {
+        XCAM_UNUSED (result);
+        return XCAM_RETURN_NO_ERROR;
+    }
+    virtual XCamReturn process_buffer (SmartPtr<VideoBuffer> &input, SmartPtr<VideoBuffer> &output) {
+        if (_delay)
+            usleep (_delay);
+        if (input->get_stream_id () < TEST_STREAM_COUNT)
+            ++_processed[input->get_stream_id ()];
+        output = input;
+        return XCAM_RETURN_NO_ERROR;
+    }
+
+private:
+    int64_t                  _delay;
+    std::atomic<uint64_t>    _processed[TEST_STREAM_COUNT];
+};
+
+class TestMultiStreamManager
+    : public MultiStreamManager
+{
+public:
+    TestMultiStreamManager ()
+        : _bad_stream_ids (0)
+        , _dropped (0)
+    {
+        reset_counts ();
+    }
+
+    void reset_counts () {
+        for (uint32_t i = 0; i < TEST_STREAM_COUNT; ++i)
+            _handled[i] = 0;
+        _bad_stream_ids = 0;
+        _dropped = 0;
+    }
+    uint64_t get_handled (uint32_t stream_id) const {
+        return _handled[stream_id].load ();
+    }
+    uint64_t get_bad_stream_ids () const {
+        return _bad_stream_ids.load ();
+    }
+    uint64_t get_dropped () const {
+        return _dropped.load ();
+    }
+
+protected:
+    virtual void handle_buffer (uint32_t stream_id, const SmartPtr<VideoBuffer> &buf) {
+        if (stream_id >= TEST_STREAM_COUNT || buf->get_stream_id () != stream_id)
+            ++_bad_stream_ids;
+        else
+            ++_handled[stream_id];
+    }
+    virtual void process_buffer_dropped (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf, uint64_t dropped) {
+        MultiStreamManager::process_buffer_dropped (processor, buf, dropped);
+        ++_dropped;
+    }
+
+private:
+    std::atomic<uint64_t>    _handled[TEST_STREAM_COUNT];
+    std::atomic<uint64_t>    _bad_stream_ids;
+    std::atomic<uint64_t>    _dropped;
+};
+
+// TEST_FRAME_COUNT NV12 frames, luma of frame i is @base + i * 16
+static bool
+create_source (char *path, uint8_t base)
+{
+    const uint32_t luma_size = TEST_WIDTH * TEST_HEIGHT;
+    const uint32_t frame_size = luma_size * 3 / 2;
+    uint8_t frame[frame_size];
+    int fd = mkstemp (path);
+
+    CHECK_DECLARE (ERROR, fd >= 0, return false, "create source file(%s) failed", path);
+    for (uint32_t i = 0; i < TEST_FRAME_COUNT; ++i) {
+        memset (frame, base + i * 16, luma_size);
+        memset (frame + luma_size, 128, frame_size - luma_size);
+        if (write (fd, frame, frame_size) != (ssize_t)frame_size) {
+            XCAM_LOG_ERROR ("write source file(%s) failed", path);
+            close (fd);
+            return false;
+        }
+    }
+    close (fd);
+    return true;
+}
+
+static SmartPtr<VirtualV4l2Device>
+open_source (const char *path)
+{
+    SmartPtr<VirtualV4l2Device> device = new VirtualV4l2Device (path);
+
+    device->set_capture_rate (VIRTUAL_CAPTURE_RATE_FIXED);
+    device->set_framerate (TEST_FRAMERATE, 1);
+    device->set_mem_type (V4L2_MEMORY_MMAP);
+    device->set_buffer_count (4);
+    if (device->open () != XCAM_RETURN_NO_ERROR ||
+            device->set_format (TEST_WIDTH, TEST_HEIGHT, V4L2_PIX_FMT_NV12, V4L2_FIELD_NONE, TEST_WIDTH) != XCAM_RETURN_NO_ERROR)
+        return NULL;
+    return device;
+}
+
+/*
+ * one start/run/stop cycle: both streams reach handle_buffer with their own id,
+ * stream 0 also through its stream processor,
+ * the slow shared processor drops frames instead of stalling capture
+ */
+static int
+run_cycle (
+    SmartPtr<TestMultiStreamManager> &manager, SmartPtr<PassThroughProcessor> &stream_processor,
+    SmartPtr<X3aAnalyzer> &analyzer, uint32_t cycle)
+{
+    PipelineMetrics metrics;
+    uint64_t stream_processed = stream_processor->get_processed (0);
+
+    manager->reset_counts ();
+    CHECK (manager->start (), "cycle %d: multi stream manager start failed", cycle);
+    CHECK_EXP (manager->is_running (), "cycle %d: manager not running after start", cycle);
+    usleep (TEST_RUN_TIME);
+    manager->get_metrics (metrics);
+    CHECK (manager->stop (), "cycle %d: multi stream manager stop failed", cycle);
+    CHECK_EXP (!manager->is_running (), "cycle %d: manager running after stop", cycle);
+
+    printf (
+        "cycle %d: handled stream0:%" PRIu64 " stream1:%" PRIu64 ", dropped:%" PRIu64
+        ", captured:%" PRIu64 ", stats analyzed:%" PRIu64 "\n",
+        cycle, manager->get_handled (0), manager->get_handled (1), manager->get_dropped (),
+        metrics.captured_frames, metrics.stats_analyzed);
+
+    CHECK_EXP (!manager->get_bad_stream_ids (), "cycle %d: frames handled with wrong stream id", cycle);
+    for (uint32_t i = 0; i < TEST_STREAM_COUNT; ++i)
+        CHECK_EXP (manager->get_handled (i) > 0, "cycle %d: no frame of stream %d handled", cycle, i);
+    CHECK_EXP (
+        stream_processor->get_processed (0) > stream_processed && !stream_processor->get_processed (1),
+        "cycle %d: stream processor got wrong frames", cycle);
+    CHECK_EXP (manager->get_dropped () > 0, "cycle %d: slow shared processor dropped nothing", cycle);
+    CHECK_EXP (
+        metrics.captured_frames >= manager->get_handled (0) + manager->get_handled (1),
+        "cycle %d: more frames handled than captured", cycle);
+    CHECK_EXP (!analyzer.ptr () || metrics.stats_analyzed > 0, "cycle %d: stream analyzer got no stats", cycle);
+    return 0;
+}
+
+int main ()
+{
+    char paths[TEST_STREAM_COUNT][32];
+    SmartPtr<VirtualV4l2Device> devices[TEST_STREAM_COUNT];
+    SmartPtr<TestMultiStreamManager> manager = new TestMultiStreamManager;
+    SmartPtr<PassThroughProcessor> stream_processor = new PassThroughProcessor ("stream0", 0);
+    SmartPtr<PassThroughProcessor> shared_processor = new PassThroughProcessor ("shared", TEST_SLOW_PROCESS);
+    SmartPtr<X3aAnalyzer> analyzer = new X3aAnalyzerSimple ();
+    int ret = 0;
+
+    for (uint32_t i = 0; i < TEST_STREAM_COUNT; ++i) {
+        uint32_t stream_id = 0;
+
+        snprintf (paths[i], sizeof (paths[i]), "/tmp/xcam-stream%d-XXXXXX", i);
+        CHECK_EXP (create_source (paths[i], 32 + i * 64), "create source of stream %d failed", i);
+        devices[i] = open_source (paths[i]);
+        CHECK_EXP (devices[i].ptr (), "open virtual device(%s) failed", paths[i]);
+        CHECK_EXP (
+            manager->add_stream (devices[i], stream_id) && stream_id == i,
+            "add stream %d failed", i);
+    }
+
+    CHECK_EXP (manager->add_stream_processor (0, stream_processor), "add stream processor failed");
+    // 2 * TEST_FRAMERATE arriving, far more than the shared processor takes
+    shared_processor->set_input_queue (4, BACKPRESSURE_DROP_NEWEST);
+    CHECK_EXP (manager->add_shared_processor (shared_processor), "add shared processor failed");
+
+    // analyzer without stats source is refused, start undone
+    CHECK_EXP (manager->set_stream_analyzer (1, analyzer), "set stream analyzer failed");
+    CHECK_EXP (manager->start () == XCAM_RETURN_ERROR_PARAM, "analyzer without stats source accepted");
+    CHECK_EXP (!manager->is_running (), "manager running after failed start");
+
+    devices[1]->set_stats_callback (manager->get_stats_callback (1));
+
+    // second cycle checks teardown leaves streams restartable
+    for (uint32_t cycle = 0; cycle < 2 && !ret; ++cycle)
+        ret = run_cycle (manager, stream_processor, analyzer, cycle);
+
+    manager.release ();
+    for (uint32_t i = 0; i < TEST_STREAM_COUNT; ++i) {
+        devices[i]->close ();
+        unlink (paths[i]);
+    }
+
+    if (!ret)
+        printf ("multi stream tests passed\n");
+    return ret;
+}
@@ -0,0 +1,251 @@
+/*
+ * test-priority-queue.cpp - test priority buffer queue policies
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "xcam_utils.h"
+#include "priority_buffer_queue.h"
+#include <list>
+#include <getopt.h>
+#include <sys/time.h>
+#include "test_common.h"
+
+#define DEFAULT_OPERATION_COUNT  1000000
+#define DEFAULT_HANDLER_COUNT    6
+#define DEFAULT_STREAM_COUNT     2
+
+using namespace XCam;
+
+typedef SmartPtr<PriorityBuffer> PriorityBufPtr;
+
+/*
+ * sorted list insert, as PriorityBufferQueue did before sorted vector,
+ * kept here as baseline
+ */
+class PriorityBufferList {
+public:
+    void push (const PriorityBufPtr &buf) {
+        SmartLock lock (_mutex);
+        std::list<PriorityBufPtr>::iterator iter = _list.begin ();
+        for (; iter != _list.end (); ++iter) {
+            if (buf->priority_less_than (*iter->ptr ()))
+                break;
+        }
+        _list.insert (iter, buf);
+    }
+    PriorityBufPtr pop () {
+        SmartLock lock (_mutex);
+        PriorityBufPtr buf = _list.front ();
+        _list.pop_front ();
+        return buf;
+    }
+
+private:
+    Mutex                      _mutex;
+    std::list<PriorityBufPtr>  _list;
+};
+
+/*
+ * keep @in_flight buffers queued: pop the top one, push it back with next rank,
+ * or push a new frame of next stream when it passed all handlers.
+ */
+template <typename Queue>
+static double
+run_schedule (
+    Queue &queue, PriorityBufPtr (Queue::*pop) (), bool (Queue::*push) (const PriorityBufPtr &),
+    uint32_t in_flight, uint32_t handlers, uint32_t streams, uint32_t operations)
+{
+    std::vector<uint32_t> seq_nums (streams, 0);
+    uint32_t next_stream = 0;
+    struct timeval start, end;
+
+    for (uint32_t i = 0; i < in_flight; ++i) {
+        PriorityBufPtr buf = new PriorityBuffer;
+        buf->stream_id = next_stream;
+        buf->set_seq_num (seq_nums[next_stream]++);
+        buf->rank = i % handlers;
+        next_stream = (next_stream + 1) % streams;
+        (queue.*push) (buf);
+    }
+
+    gettimeofday (&start, NULL);
+    for (uint32_t i = 0; i < operations; ++i) {
+        PriorityBufPtr buf = (queue.*pop) ();
+        if (buf->rank + 1 < handlers) {
+            buf->down_rank ();
+        } else {
+            buf = new PriorityBuffer;
+            buf->stream_id = next_stream;
+            buf->set_seq_num (seq_nums[next_stream]++);
+            next_stream = (next_stream + 1) % streams;
+        }
+        (queue.*push) (buf);
+    }
+    gettimeofday (&end, NULL);
+
+    for (uint32_t i = 0; i < in_flight; ++i)
+        (queue.*pop) ();
+
+    return ((end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec)) * 1000.0 / operations;
+}
+
+class ListAdapter {
+public:
+    PriorityBufPtr pop () {
+        return _list.pop ();
+    }
+    bool push (const PriorityBufPtr &buf) {
+        _list.push (buf);
+        return true;
+    }
+
+private:
+    PriorityBufferList  _list;
+};
+
+class QueueAdapter {
+public:
+    explicit QueueAdapter (PriorityPolicy policy)
+        : _queue (policy)
+    {
+        // second stream with tighter budget
+        _queue.set_latency_budget (1, XCAM_PRIORITY_DEFAULT_LATENCY_BUDGET / 2);
+    }
+    PriorityBufPtr pop () {
+        return _queue.pop (0);
+    }
+    bool push (const PriorityBufPtr &buf) {
+        return _queue.push_priority_buf (buf);
+    }
+
+private:
+    PriorityBufferQueue  _queue;
+};
+
+static PriorityBufPtr
+new_frame (uint32_t stream_id, uint32_t seq_num)
+{
+    PriorityBufPtr buf = new PriorityBuffer;
+    buf->stream_id = stream_id;
+    buf->set_seq_num (seq_num);
+    return buf;
+}
+
+/*
+ * stream-fifo: each stream pops in its own push order and streams alternate,
+ * a stream joining late neither jumps ahead nor waits behind the other's backlog
+ */
+static int
+check_stream_fifo ()
+{
+    PriorityBufferQueue queue (PRIORITY_POLICY_STREAM_FIFO);
+    // {stream_id, seq_num} in pop order
+    const uint32_t expected[][2] = {{1, 0}, {0, 2}, {1, 1}, {0, 3}, {1, 2}, {0, 4}};
+
+    for (uint32_t i = 0; i < 4; ++i)
+        queue.push_priority_buf (new_frame (0, i));
+    queue.pop (0);
+    queue.pop (0);
+
+    // stream 0 served 2 frames, stream 1 joins at that round
+    for (uint32_t i = 0; i < 3; ++i)
+        queue.push_priority_buf (new_frame (1, i));
+    queue.push_priority_buf (new_frame (0, 4));
+
+    for (uint32_t i = 0; i < sizeof (expected) / sizeof (expected[0]); ++i) {
+        PriorityBufPtr buf = queue.pop (0);
+        CHECK_EXP (buf.ptr (), "stream-fifo queue empty at pop %d", i);
+        CHECK_EXP (
+            buf->stream_id == expected[i][0] && buf->seq_num == expected[i][1],
+            "stream-fifo pop %d got stream %d frame %d, expected stream %d frame %d",
+            i, buf->stream_id, buf->seq_num, expected[i][0], expected[i][1]);
+    }
+    CHECK_EXP (queue.is_empty (), "stream-fifo queue not empty");
+    return 0;
+}
+
+void print_help (const char *bin_name)
+{
+    printf ("Usage: %s [-n operations] [-c handlers] [-s streams]\n"
+            "\t -n operations  pop/push pairs per run, default is %d\n"
+            "\t -c handlers    handler ranks per frame, default is %d\n"
+            "\t -s streams     interleaved streams, default is %d\n"
+            "\t -h             help\n"
+            , bin_name
+            , DEFAULT_OPERATION_COUNT
+            , DEFAULT_HANDLER_COUNT
+            , DEFAULT_STREAM_COUNT);
+}
+
+int main (int argc, char *argv[])
+{
+    const uint32_t in_flights[] = {8, 32, 128};
+    const PriorityPolicy policies[] = {
+        PRIORITY_POLICY_FIXED_DELAY, PRIORITY_POLICY_DEADLINE, PRIORITY_POLICY_STREAM_FIFO
+    };
+    const char *policy_names[] = {"fixed-delay", "deadline", "stream-fifo"};
+    uint32_t operations = DEFAULT_OPERATION_COUNT;
+    uint32_t handlers = DEFAULT_HANDLER_COUNT;
+    uint32_t streams = DEFAULT_STREAM_COUNT;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "n:c:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            operations = atoi (optarg);
+            break;
+        case 'c':
+            handlers = atoi (optarg);
+            break;
+        case 's':
+            streams = atoi (optarg);
+            break;
+        case 'h':
+            print_help (argv[0]);
+            return 0;
+        default:
+            print_help (argv[0]);
+            return -1;
+        }
+    }
+    CHECK_EXP (operations > 0 && handlers > 0 && streams > 0, "operations, handlers and streams must be positive");
+    if (check_stream_fifo () != 0)
+        return -1;
+
+    printf ("handlers:%d, streams:%d, ns per pop+push\n", handlers, streams);
+    printf ("%-12s %10s", "in-flight", "list");
+    for (uint32_t p = 0; p < sizeof (policies) / sizeof (policies[0]); ++p)
+        printf (" %12s", policy_names[p]);
+    printf ("\n");
+
+    for (uint32_t i = 0; i < sizeof (in_flights) / sizeof (in_flights[0]); ++i) {
+        ListAdapter list;
+        printf ("%-12d %10.1f", in_flights[i],
+                run_schedule (list, &ListAdapter::pop, &ListAdapter::push,
+                              in_flights[i], handlers, streams, operations));
+
+        for (uint32_t p = 0; p < sizeof (policies) / sizeof (policies[0]); ++p) {
+            QueueAdapter queue (policies[p]);
+            printf (" %12.1f",
+                    run_schedule (queue, &QueueAdapter::pop, &QueueAdapter::push,
+                                  in_flights[i], handlers, streams, operations));
+        }
+        printf ("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,272 @@
+/*
+ * test-smart-ptr.cpp - test smart pointer allocations and ref count ops per frame
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "xcam_utils.h"
+#include "smartptr.h"
+#include "host_buffer_pool.h"
+#include "x3a_result.h"
+#include "ring_queue.h"
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+#include <getopt.h>
+#include <sys/time.h>
+#include "test_common.h"
+
+#define DEFAULT_FRAME_COUNT   1000
+#define DEFAULT_HANDLER_COUNT 4
+#define DEFAULT_RESULT_COUNT  8
+
+// build xcore and this test with -DXCAM_SEPARATE_REF_COUNT=1 to measure the non-intrusive path
+#ifndef XCAM_SEPARATE_REF_COUNT
+#define XCAM_SEPARATE_REF_COUNT 0
+#endif
+
+using namespace XCam;
+
+static std::atomic<uint64_t> g_alloc_count (0);
+
+// count every heap allocation, kept out of line so compiler won't pair malloc/free with new/delete
+__attribute__ ((noinline)) void *operator new (size_t size)
+{
+    void *ptr = malloc (size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc ();
+    ++g_alloc_count;
+    return ptr;
+}
+
+__attribute__ ((noinline)) void operator delete (void *ptr) noexcept
+{
+    free (ptr);
+}
+
+/*
+ * one frame through CL 3A pipeline:
+ * capture buffer and 3a stats from pools, 3a results from analyzer,
+ * one output buffer per cl handler, each attached/chained to previous one.
+ * @objects counts SmartPtr owned objects created in this frame.
+ */
+static void
+run_frame (
+    SmartPtr<BufferPool> &capture_pool, SmartPtr<BufferPool> &stats_pool,
+    SmartPtr<BufferPool> &cl_pool, uint32_t handler_count, uint32_t result_count,
+    uint32_t &objects)
+{
+    SmartPtr<BufferProxy> input = capture_pool->get_buffer (capture_pool);
+    SmartPtr<BufferProxy> stats = stats_pool->get_buffer (stats_pool);
+    X3aResultList results;
+    objects += 2;
+
+    for (uint32_t i = 0; i < result_count; ++i) {
+        SmartPtr<X3aExposureResult> result =
+            make_smart<X3aExposureResult> (XCAM_3A_RESULT_EXPOSURE);
+        results.push_back (result);
+        ++objects;
+    }
+    input->set_meta (VIDEO_BUFFER_META_3A_STATS, stats);
+
+    SmartPtr<BufferProxy> buf = input;
+    for (uint32_t i = 0; i < handler_count; ++i) {
+        SmartPtr<BufferProxy> output = cl_pool->get_buffer (cl_pool);
+        output->copy_attaches (buf);
+        buf = output;
+        ++objects;
+    }
+    buf->clear_metas ();
+}
+
+typedef SpscRingQueue<VideoBuffer> VideoBufQueue;
+
+static void
+notify_buffer_done (const SmartPtr<VideoBuffer> &buf)
+{
+    XCAM_UNUSED (buf);
+}
+
+/*
+ * frame hand-off in copy style, how poll -> process center -> handlers -> done queue
+ * passed buffers before move semantics
+ */
+static void
+handoff_frame_copy (
+    SmartPtr<BufferPool> &capture_pool, SmartPtr<BufferPool> &cl_pool,
+    VideoBufQueue &input_queue, VideoBufQueue &done_queue, uint32_t handler_count)
+{
+    SmartPtr<BufferProxy> buf = capture_pool->get_buffer (capture_pool);
+    {
+        SmartPtr<VideoBuffer> video_buf = buf;
+        input_queue.push (video_buf);
+    }
+    buf.release ();
+
+    SmartPtr<VideoBuffer> input = input_queue.pop (0);
+    SmartPtr<BufferProxy> data = input.dynamic_cast_ptr<BufferProxy> ();
+    input.release ();
+    for (uint32_t i = 0; i < handler_count; ++i) {
+        SmartPtr<BufferProxy> in_data = data;
+        SmartPtr<BufferProxy> output = cl_pool->get_buffer (cl_pool);
+        output->copy_attaches (SmartPtr<BufferProxy> (in_data));
+        data = output;
+    }
+    done_queue.push (data);
+    data.release ();
+
+    SmartPtr<BufferProxy> done_buf = done_queue.pop (0).dynamic_cast_ptr<BufferProxy> ();
+    notify_buffer_done (done_buf);
+}
+
+/*
+ * same hand-off with move and BorrowedPtr, as the frame path does now
+ */
+static void
+handoff_frame_move (
+    SmartPtr<BufferPool> &capture_pool, SmartPtr<BufferPool> &cl_pool,
+    VideoBufQueue &input_queue, VideoBufQueue &done_queue, uint32_t handler_count)
+{
+    SmartPtr<BufferProxy> buf = capture_pool->get_buffer (capture_pool);
+    input_queue.push (SmartPtr<VideoBuffer> (std::move (buf)));
+
+    SmartPtr<VideoBuffer> input = input_queue.pop (0);
+    SmartPtr<BufferProxy> data = input.dynamic_cast_ptr<BufferProxy> ();
+    input.release ();
+    for (uint32_t i = 0; i < handler_count; ++i) {
+        SmartPtr<BufferProxy> in_data = std::move (data);
+        SmartPtr<BufferProxy> output = cl_pool->get_buffer (cl_pool);
+        output->copy_attaches (in_data);
+        data = std::move (output);
+    }
+    done_queue.push (SmartPtr<VideoBuffer> (std::move (data)));
+
+    SmartPtr<VideoBuffer> done_buf = done_queue.pop (0);
+    notify_buffer_done (done_buf);
+}
+
+#if ENABLE_PROFILING
+#define RMW_COUNT() RefCount::thread_rmw_count ()
+#else
+#define RMW_COUNT() 0
+#endif
+
+static SmartPtr<BufferPool>
+create_pool (uint32_t format, uint32_t width, uint32_t height, uint32_t count)
+{
+    VideoBufferInfo info;
+    SmartPtr<BufferPool> pool = new HostBufferPool;
+
+    info.init (format, width, height);
+    if (!pool->set_video_info (info) || !pool->reserve (count))
+        return NULL;
+    return pool;
+}
+
+void print_help (const char *bin_name)
+{
+    printf ("Usage: %s [-f frames] [-c handlers] [-r results]\n"
+            "\t -f frames    frame count, default is %d\n"
+            "\t -c handlers  cl handler count, default is %d\n"
+            "\t -r results   3a result count per frame, default is %d\n"
+            "\t -h           help\n"
+            , bin_name
+            , DEFAULT_FRAME_COUNT
+            , DEFAULT_HANDLER_COUNT
+            , DEFAULT_RESULT_COUNT);
+}
+
+int main (int argc, char *argv[])
+{
+    uint32_t frame_count = DEFAULT_FRAME_COUNT;
+    uint32_t handler_count = DEFAULT_HANDLER_COUNT;
+    uint32_t result_count = DEFAULT_RESULT_COUNT;
+    uint32_t objects = 0;
+    uint64_t allocs = 0;
+    uint64_t copy_rmw = 0, move_rmw = 0;
+    VideoBufQueue input_queue, done_queue;
+    struct timeval start, end;
+    int opt;
+
+    while ((opt = getopt (argc, argv, "f:c:r:h")) != -1) {
+        switch (opt) {
+        case 'f':
+            frame_count = atoi (optarg);
+            break;
+        case 'c':
+            handler_count = atoi (optarg);
+            break;
+        case 'r':
+            result_count = atoi (optarg);
+            break;
+        case 'h':
+            print_help (argv[0]);
+            return 0;
+        default:
+            print_help (argv[0]);
+            return -1;
+        }
+    }
+    CHECK_EXP (frame_count > 0, "frame count must be positive");
+
+    SmartPtr<BufferPool> capture_pool = create_pool (V4L2_PIX_FMT_NV12, 64, 64, 4);
+    SmartPtr<BufferPool> stats_pool = create_pool (V4L2_PIX_FMT_NV12, 64, 16, 4);
+    SmartPtr<BufferPool> cl_pool = create_pool (V4L2_PIX_FMT_NV12, 64, 64, handler_count + 2);
+    CHECK_EXP (capture_pool.ptr () && stats_pool.ptr () && cl_pool.ptr (), "create buffer pools failed");
+
+    // warm up, let std::list nodes in pools settle
+    run_frame (capture_pool, stats_pool, cl_pool, handler_count, result_count, objects);
+
+    objects = 0;
+    allocs = g_alloc_count.load ();
+    gettimeofday (&start, NULL);
+    for (uint32_t i = 0; i < frame_count; ++i)
+        run_frame (capture_pool, stats_pool, cl_pool, handler_count, result_count, objects);
+    gettimeofday (&end, NULL);
+    allocs = g_alloc_count.load () - allocs;
+
+    printf ("frames:%d, cl handlers:%d, 3a results:%d\n", frame_count, handler_count, result_count);
+    printf ("allocations per frame: %.2f, ref counts: %s, smart objects per frame: %.2f\n",
+            (double)allocs / frame_count, XCAM_SEPARATE_REF_COUNT ? "separate" : "intrusive",
+            (double)objects / frame_count);
+    printf ("time per frame: %.3f us\n",
+            ((end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec)) / frame_count);
+
+    copy_rmw = RMW_COUNT ();
+    for (uint32_t i = 0; i < frame_count; ++i)
+        handoff_frame_copy (capture_pool, cl_pool, input_queue, done_queue, handler_count);
+    copy_rmw = RMW_COUNT () - copy_rmw;
+
+    move_rmw = RMW_COUNT ();
+    for (uint32_t i = 0; i < frame_count; ++i)
+        handoff_frame_move (capture_pool, cl_pool, input_queue, done_queue, handler_count);
+    move_rmw = RMW_COUNT () - move_rmw;
+
+#if ENABLE_PROFILING
+    printf ("atomic ref count ops per frame hand-off: copy %.2f, move %.2f\n",
+            (double)copy_rmw / frame_count, (double)move_rmw / frame_count);
+#else
+    XCAM_UNUSED (copy_rmw);
+    XCAM_UNUSED (move_rmw);
+    printf ("atomic ref count ops not counted, configure with --enable-profiling\n");
+#endif
+
+    capture_pool->stop ();
+    stats_pool->stop ();
+    cl_pool->stop ();
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * test-video-buffer-view.cpp - test video buffer view
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "xcam_utils.h"
+#include "video_buffer_view.h"
+#include <linux/videodev2.h>
+#include "test_common.h"
+
+#define TEST_WIDTH     640
+#define TEST_HEIGHT    480
+
+using namespace XCam;
+
+// host memory buffer counting outstanding maps
+class CountedBuffer
+    : public VideoBuffer
+{
+public:
+    explicit CountedBuffer (const VideoBufferInfo &info)
+        : VideoBuffer (info)
+        , _map_count (0)
+    {
+        _data = (uint8_t *) xcam_malloc0 (info.size);
+    }
+    ~CountedBuffer () {
+        xcam_free (_data);
+    }
+
+    virtual uint8_t *map () {
+        ++_map_count;
+        return _data;
+    }
+    virtual bool unmap () {
+        CHECK_DECLARE (ERROR, _map_count > 0, return false, "unmap without map");
+        --_map_count;
+        return true;
+    }
+    virtual int get_fd () {
+        return -1;
+    }
+
+    int32_t get_map_count () const {
+        return _map_count;
+    }
+
+private:
+    uint8_t     *_data;
+    int32_t      _map_count;
+};
+
+static bool
+is_view_valid (const SmartPtr<VideoBuffer> &parent, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    SmartPtr<VideoBufferView> view = new VideoBufferView (parent, VideoBufferRect (x, y, w, h));
+    return view->is_valid ();
+}
+
+static int
+test_plane_offsets (const SmartPtr<VideoBuffer> &parent)
+{
+    const VideoBufferInfo &parent_info = parent->get_video_info ();
+    SmartPtr<VideoBufferView> view = new VideoBufferView (parent, VideoBufferRect (64, 32, 128, 96));
+
+    CHECK_EXP (view->is_valid (), "aligned view invalid");
+
+    const VideoBufferInfo &info = view->get_video_info ();
+    CHECK_EXP (info.width == 128 && info.height == 96, "view size %dx%d wrong", info.width, info.height);
+    CHECK_EXP (
+        info.strides[0] == parent_info.strides[0] && info.strides[1] == parent_info.strides[1],
+        "view strides differ from parent");
+    CHECK_EXP (
+        info.offsets[0] == parent_info.offsets[0] + 32 * parent_info.strides[0] + 64,
+        "luma offset %d wrong", info.offsets[0]);
+    // NV12 chroma plane, half height, interleaved uv of 2 bytes per half-width sample
+    CHECK_EXP (
+        info.offsets[1] == parent_info.offsets[1] + 16 * parent_info.strides[1] + 64,
+        "chroma offset %d wrong", info.offsets[1]);
+    return 0;
+}
+
+static int
+test_misaligned_rects (const SmartPtr<VideoBuffer> &parent)
+{
+    CHECK_EXP (is_view_valid (parent, 0, 0, TEST_WIDTH, TEST_HEIGHT), "full view invalid");
+    CHECK_EXP (!is_view_valid (parent, 1, 0, 64, 64), "odd pos_x accepted");
+    CHECK_EXP (!is_view_valid (parent, 0, 1, 64, 64), "odd pos_y accepted");
+    CHECK_EXP (!is_view_valid (parent, 0, 0, 63, 64), "odd width accepted");
+    CHECK_EXP (!is_view_valid (parent, 0, 0, 64, 63), "odd height accepted");
+    CHECK_EXP (!is_view_valid (parent, 0, 0, 0, 64), "empty rect accepted");
+    CHECK_EXP (!is_view_valid (parent, TEST_WIDTH - 62, 0, 64, 64), "rect out of parent accepted");
+    return 0;
+}
+
+static int
+test_map_balance (const SmartPtr<CountedBuffer> &parent)
+{
+    std::list<SmartPtr<VideoBufferView>> tiles;
+    SmartPtr<VideoBuffer> parent_buf = parent;
+
+    CHECK_EXP (VideoBufferView::split_tiles (parent_buf, 3, 2, tiles), "split tiles failed");
+    CHECK_EXP (tiles.size () == 6, "got %d tiles", (int)tiles.size ());
+
+    for (std::list<SmartPtr<VideoBufferView>>::iterator i = tiles.begin (); i != tiles.end (); ++i)
+        CHECK_EXP ((*i)->map (), "tile map failed");
+    CHECK_EXP (parent->get_map_count () == 6, "parent map count %d after maps", parent->get_map_count ());
+
+    for (std::list<SmartPtr<VideoBufferView>>::iterator i = tiles.begin (); i != tiles.end (); ++i)
+        CHECK_EXP ((*i)->unmap (), "tile unmap failed");
+    CHECK_EXP (parent->get_map_count () == 0, "parent map count %d after unmaps", parent->get_map_count ());
+    return 0;
+}
+
+int main ()
+{
+    VideoBufferInfo info;
+    SmartPtr<CountedBuffer> parent;
+
+    info.init (V4L2_PIX_FMT_NV12, TEST_WIDTH, TEST_HEIGHT);
+    parent = new CountedBuffer (info);
+
+    if (test_plane_offsets (parent) != 0 ||
+            test_misaligned_rects (parent) != 0 ||
+            test_map_balance (parent) != 0)
+        return -1;
+
+    printf ("video buffer view tests passed\n");
+    return 0;
+}
@@ -41,6 +41,7 @@
 #include "x3a_analyzer_loader.h"
 #include "smart_analyzer_loader.h"
 #include "smart_analysis_handler.h"
+#include "virtual_v4l2_device.h"
 
 #include <signal.h>
 
@@ -217,7 +218,9 @@ enum {
     PROP_PIPE_PROFLE,
     PROP_CPF,
     PROP_3A_LIB,
-    PROP_INPUT_FMT
+    PROP_INPUT_FMT,
+    PROP_CAPTURE_FPS,
+    PROP_METRICS
 };
 
 static void gst_xcam_src_xcam_3a_interface_init (GstXCam3AInterface *iface);
@@ -303,7 +306,7 @@ gst_xcam_src_class_init (GstXCamSrcClass * klass)
 
     g_object_class_install_property (
         gobject_class, PROP_DEVICE,
-        g_param_spec_string ("device", "device", "Device location",
+        g_param_spec_string ("device", "device", "Device location, or raw frames file/directory to replay",
                              NULL, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
     g_object_class_install_property (
@@ -369,6 +372,17 @@ gst_xcam_src_class_init (GstXCamSrcClass * klass)
         g_param_spec_string ("input-format", "input format", "Input pixel format",
                              NULL, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+    g_object_class_install_property (
+        gobject_class, PROP_CAPTURE_FPS,
+        g_param_spec_double ("capture-fps", "capture fps", "Frames captured per second",
+                             0.0, G_MAXDOUBLE, 0.0, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property (
+        gobject_class, PROP_METRICS,
+        g_param_spec_boxed ("metrics", "metrics",
+                            "Pipeline counters, queue depths, pool occupancy and handler times",
+                            GST_TYPE_STRUCTURE, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
     gst_element_class_set_details_simple (element_class,
                                           "Libxcam Source",
                                           "Source/Base",
@@ -440,6 +454,45 @@ gst_xcam_src_finalize (GObject * object)
     G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static GstStructure *
+gst_xcam_src_create_metrics (const PipelineMetrics &metrics)
+{
+    char field[XCAM_METRICS_NAME_SIZE + 16];
+    GstStructure *structure = gst_structure_new (
+        "xcam-metrics",
+        "capture-fps", G_TYPE_DOUBLE, metrics.capture_fps,
+        "captured-frames", G_TYPE_UINT64, metrics.captured_frames,
+        "dequeue-failures", G_TYPE_UINT64, metrics.dequeue_failures,
+        "stats-in", G_TYPE_UINT64, metrics.stats_in,
+        "stats-dropped", G_TYPE_UINT64, metrics.stats_dropped,
+        "stats-skipped", G_TYPE_UINT64, metrics.stats_skipped,
+        "stats-analyzed", G_TYPE_UINT64, metrics.stats_analyzed,
+        "analyze-mean-us", G_TYPE_INT64, metrics.analyze_mean_time,
+        "analyze-max-us", G_TYPE_INT64, metrics.analyze_max_time,
+        "stamp-overflows", G_TYPE_UINT64, metrics.stamp_overflows,
+        NULL);
+
+    for (uint32_t i = 0; i < metrics.queues.size (); ++i) {
+        snprintf (field, sizeof (field), "queue.%s", metrics.queues[i].name);
+        gst_structure_set (structure, field, G_TYPE_UINT, metrics.queues[i].depth, NULL);
+        snprintf (field, sizeof (field), "queue.%s.dropped", metrics.queues[i].name);
+        gst_structure_set (structure, field, G_TYPE_UINT64, metrics.queues[i].dropped, NULL);
+    }
+    for (uint32_t i = 0; i < metrics.pools.size (); ++i) {
+        snprintf (field, sizeof (field), "pool.%s.in-flight", metrics.pools[i].name);
+        gst_structure_set (structure, field, G_TYPE_UINT, metrics.pools[i].in_flight, NULL);
+        snprintf (field, sizeof (field), "pool.%s.allocated", metrics.pools[i].name);
+        gst_structure_set (structure, field, G_TYPE_UINT, metrics.pools[i].allocated, NULL);
+    }
+    for (uint32_t i = 0; i < metrics.handlers.size (); ++i) {
+        snprintf (field, sizeof (field), "handler.%s.mean-us", metrics.handlers[i].name);
+        gst_structure_set (structure, field, G_TYPE_INT64, metrics.handlers[i].mean_time, NULL);
+        snprintf (field, sizeof (field), "handler.%s.max-us", metrics.handlers[i].name);
+        gst_structure_set (structure, field, G_TYPE_INT64, metrics.handlers[i].max_time, NULL);
+    }
+    return structure;
+}
+
 static void
 gst_xcam_src_get_property (
     GObject *object,
@@ -493,6 +546,18 @@ gst_xcam_src_get_property (
         g_value_set_string (value, xcam_fourcc_to_string (src->in_format));
         break;
     }
+    case PROP_CAPTURE_FPS: {
+        PipelineMetrics metrics;
+        src->device_manager->get_metrics (metrics);
+        g_value_set_double (value, metrics.capture_fps);
+        break;
+    }
+    case PROP_METRICS: {
+        PipelineMetrics metrics;
+        src->device_manager->get_metrics (metrics);
+        g_value_take_boxed (value, gst_xcam_src_create_metrics (metrics));
+        break;
+    }
 
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -654,6 +719,7 @@ gst_xcam_src_start (GstBaseSrc *src)
     SmartPtr<V4l2Device> capture_device;
     SmartPtr<V4l2SubDevice> event_device;
     SmartPtr<IspController> isp_controller;
+    bool is_virtual = false;
 
     // Check device
     if (xcamsrc->device == NULL) {
@@ -672,7 +738,15 @@ gst_xcam_src_start (GstBaseSrc *src)
             xcamsrc->in_format = V4L2_PIX_FMT_NV12;
     }
 
-    capture_device = new AtomispDevice (xcamsrc->device);
+    is_virtual = VirtualV4l2Device::is_virtual_source (xcamsrc->device);
+    if (is_virtual) {
+        SmartPtr<VirtualV4l2Device> virtual_device = new VirtualV4l2Device (xcamsrc->device);
+        // no isp events, 3a stats from cl processor or replayed frames
+        if (xcamsrc->image_processor_type != CL_IMAGE_PROCESSOR)
+            virtual_device->set_stats_callback (device_manager.ptr ());
+        capture_device = virtual_device;
+    } else
+        capture_device = new AtomispDevice (xcamsrc->device);
     capture_device->set_sensor_id (xcamsrc->sensor_id);
     capture_device->set_capture_mode (xcamsrc->capture_mode);
     capture_device->set_mem_type (xcamsrc->mem_type);
@@ -680,21 +754,28 @@ gst_xcam_src_start (GstBaseSrc *src)
     capture_device->open ();
     device_manager->set_capture_device (capture_device);
 
-    event_device = new V4l2SubDevice (DEFAULT_EVENT_DEVICE);
-    event_device->open ();
-    event_device->subscribe_event (V4L2_EVENT_ATOMISP_3A_STATS_READY);
-    //event_device->subscribe_event (V4L2_EVENT_FRAME_SYNC);
-    device_manager->set_event_device (event_device);
+    if (!is_virtual) {
+        event_device = new V4l2SubDevice (DEFAULT_EVENT_DEVICE);
+        event_device->open ();
+        event_device->subscribe_event (V4L2_EVENT_ATOMISP_3A_STATS_READY);
+        //event_device->subscribe_event (V4L2_EVENT_FRAME_SYNC);
+        device_manager->set_event_device (event_device);
+    }
 
-    isp_controller = new IspController (capture_device);
-    device_manager->set_isp_controller (isp_controller);
+    // no isp behind virtual sources, isp processor then only passes frames through
+    if (!is_virtual) {
+        isp_controller = new IspController (capture_device);
+        device_manager->set_isp_controller (isp_controller);
+    }
 
     switch (xcamsrc->image_processor_type) {
 #if HAVE_LIBCL
     case CL_IMAGE_PROCESSOR:
-        isp_processor = new IspExposureImageProcessor (isp_controller);
-        XCAM_ASSERT (isp_processor.ptr ());
-        device_manager->add_image_processor (isp_processor);
+        if (!is_virtual) {
+            isp_processor = new IspExposureImageProcessor (isp_controller);
+            XCAM_ASSERT (isp_processor.ptr ());
+            device_manager->add_image_processor (isp_processor);
+        }
         cl_processor = new CL3aImageProcessor ();
         cl_processor->set_stats_callback (device_manager);
         cl_processor->set_profile ((CL3aImageProcessor::PipelineProfile)xcamsrc->cl_pipe_profile);
@@ -710,6 +791,10 @@ gst_xcam_src_start (GstBaseSrc *src)
     switch (xcamsrc->analyzer_type) {
 #if HAVE_IA_AIQ
     case AIQ_ANALYZER:
+        if (is_virtual) {
+            XCAM_LOG_ERROR ("aiq analyzer needs isp, not supported with virtual source(%s)", xcamsrc->device);
+            return FALSE;
+        }
         XCAM_LOG_INFO ("cpf: %s", xcamsrc->path_to_cpf);
         analyzer = new X3aAnalyzerAiq (isp_controller, xcamsrc->path_to_cpf);
         break;
@@ -746,6 +831,10 @@ gst_xcam_src_start (GstBaseSrc *src)
         break;
     }
     case HYBRID_ANALYZER: {
+        if (is_virtual) {
+            XCAM_LOG_ERROR ("hybrid analyzer needs isp, not supported with virtual source(%s)", xcamsrc->device);
+            return FALSE;
+        }
         XCAM_LOG_INFO ("hybrid 3a library: %s", xcamsrc->path_to_3alib);
         SmartPtr<X3aAnalyzerLoader> loader = new X3aAnalyzerLoader (xcamsrc->path_to_3alib);
         analyzer = loader->load_hybrid_analyzer (loader, isp_controller, xcamsrc->path_to_cpf);
@@ -786,7 +875,8 @@ gst_xcam_src_stop (GstBaseSrc *src)
 
     device_manager->stop();
     device_manager->get_capture_device()->close ();
-    device_manager->get_event_device()->close ();
+    if (device_manager->get_event_device().ptr ())
+        device_manager->get_event_device()->close ();
     device_manager->pause_dequeue ();
     return TRUE;
 }
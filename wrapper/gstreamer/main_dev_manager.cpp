@@ -43,7 +43,9 @@ void
 MainDeviceManager::handle_buffer (const SmartPtr<VideoBuffer> &buf)
 {
     XCAM_ASSERT (buf.ptr ());
-    _ready_buffers.push (buf);
+    if (!_ready_buffers.push (buf)) {
+        XCAM_LOG_WARNING ("ready buffer queue full, drop buffer");
+    }
 }
 
 SmartPtr<VideoBuffer>
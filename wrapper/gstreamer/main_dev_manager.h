@@ -38,6 +38,7 @@
 
 #include <xcam_mutex.h>
 #include <video_buffer.h>
+#include <ring_queue.h>
 #include <v4l2_buffer_proxy.h>
 #include <v4l2_device.h>
 #include <device_manager.h>
@@ -84,7 +85,7 @@ protected:
     virtual void handle_buffer (const XCam::SmartPtr<XCam::VideoBuffer> &buf);
 
 private:
-    XCam::SafeList<XCam::VideoBuffer>         _ready_buffers;
+    XCam::MpmcRingQueue<XCam::VideoBuffer>    _ready_buffers;
 #if HAVE_LIBCL
     XCam::SmartPtr<XCam::CL3aImageProcessor>  _cl_image_processor;
 #endif
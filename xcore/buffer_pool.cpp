@@ -20,9 +20,23 @@
 
 #include "xcam_utils.h"
 #include "buffer_pool.h"
+#include "xcam_trace.h"
+#include <vector>
 
 namespace XCam {
 
+BufferPoolStats::BufferPoolStats ()
+    : allocated (0)
+    , in_flight (0)
+    , peak_in_flight (0)
+    , waits (0)
+    , wait_time (0)
+    , timeouts (0)
+    , grows (0)
+    , shrinks (0)
+{
+}
+
 BufferProxy::BufferProxy (const VideoBufferInfo &info, const SmartPtr<BufferData> &data)
     : VideoBuffer (info)
     , _data (data)
@@ -38,7 +52,7 @@ BufferProxy::BufferProxy (const SmartPtr<BufferData> &data)
 
 BufferProxy::~BufferProxy ()
 {
-    clear_attached_buffers ();
+    clear_metas ();
 
     if (_pool.ptr ()) {
         _pool->release (_data);
@@ -69,51 +83,140 @@ BufferProxy::get_fd ()
 }
 
 bool
-BufferProxy::attach_buffer (const SmartPtr<VideoBuffer>& buf)
+BufferProxy::sync_for_cpu ()
 {
-    _attached_bufs.push_back (buf);
-    return true;
+    XCAM_ASSERT (_data.ptr ());
+    return _data->sync_for_cpu ();
 }
 
 bool
-BufferProxy::detach_buffer (const SmartPtr<VideoBuffer>& buf)
-{
-    for (VideoBufferList::iterator iter = _attached_bufs.begin ();
-            iter != _attached_bufs.end (); ++iter) {
-        SmartPtr<VideoBuffer>& current = *iter;
-        if (current.ptr () == buf.ptr ()) {
-            _attached_bufs.erase (iter);
-            return true;
-        }
-    }
-
-    //not found
-    return false;
+BufferProxy::sync_for_device ()
+{
+    XCAM_ASSERT (_data.ptr ());
+    return _data->sync_for_device ();
 }
 
 bool
-BufferProxy::copy_attaches (const SmartPtr<BufferProxy>& buf)
+BufferProxy::copy_attaches (BorrowedPtr<BufferProxy> buf)
 {
-    _attached_bufs.insert (
-        _attached_bufs.end (), buf->_attached_bufs.begin (), buf->_attached_bufs.end ());
+    set_stream_id (buf->get_stream_id ());
+    copy_stamps (*buf.ptr ());
+    copy_metas (*buf.ptr ());
     return true;
 }
 
-void
-BufferProxy::clear_attached_buffers ()
+/*
+ * per-thread cache of free data for one pool,
+ * referenced by the pool registry and by the owner thread.
+ * lock order: BufferPool::_mutex -> mutex -> SafeList lock
+ */
+class BufferMagazine
+    : public RefObj
 {
-    _attached_bufs.clear ();
+public:
+    explicit BufferMagazine (BufferPool *owner, uint32_t slot_count)
+        : pool (owner)
+        , count (0)
+        , size (slot_count)
+        , thread_exited (false)
+    {
+        slots = new SmartPtr<BufferData>[size];
+    }
+    ~BufferMagazine () {
+        delete [] slots;
+    }
+
+    Mutex                      mutex;
+    std::atomic<BufferPool *>  pool; // NULL once pool destructed
+    SmartPtr<BufferData>      *slots;
+    uint32_t                   count;
+    uint32_t                   size;
+    std::atomic<bool>          thread_exited;
+
+private:
+    XCAM_DEAD_COPY (BufferMagazine);
+};
+
+// magazines of current thread, flushed back to their pools on thread exit
+class ThreadMagazines {
+public:
+    ThreadMagazines () {}
+    ~ThreadMagazines ();
+
+    BufferMagazine *find (BufferPool *pool);
+    void add (const SmartPtr<BufferMagazine> &magazine) {
+        _magazines.push_back (magazine);
+    }
+
+private:
+    XCAM_DEAD_COPY (ThreadMagazines);
+
+private:
+    std::vector<SmartPtr<BufferMagazine> > _magazines;
+};
+
+static thread_local ThreadMagazines thread_magazines;
+
+ThreadMagazines::~ThreadMagazines ()
+{
+    for (uint32_t i = 0; i < _magazines.size (); ++i) {
+        SmartPtr<BufferMagazine> &magazine = _magazines[i];
+        SmartLock lock (magazine->mutex);
+        BufferPool *pool = magazine->pool;
+        if (pool)
+            pool->_buf_list.push_batch (magazine->slots, magazine->count);
+        magazine->count = 0;
+        magazine->thread_exited = true;
+    }
+}
+
+BufferMagazine *
+ThreadMagazines::find (BufferPool *pool)
+{
+    for (uint32_t i = 0; i < _magazines.size (); ) {
+        BufferPool *owner = _magazines[i]->pool;
+        if (owner == pool)
+            return _magazines[i].ptr ();
+        // pool already destructed
+        if (!owner) {
+            _magazines[i] = _magazines.back ();
+            _magazines.pop_back ();
+            continue;
+        }
+        ++i;
+    }
+    return NULL;
 }
 
 BufferPool::BufferPool ()
     : _allocated_num (0)
     , _max_count (0)
     , _started (false)
+    , _hard_cap (0)
+    , _idle_time (XCAM_BUFFER_POOL_DEFAULT_IDLE_TIME)
+    , _last_busy_time (0)
+    , _callback (NULL)
+    , _in_flight (0)
+    , _peak_in_flight (0)
+    , _waiters (0)
+    , _cache_size (0)
 {
 }
 
 BufferPool::~BufferPool ()
 {
+    SmartLock lock (_mutex);
+
+    // threads may still hold magazines, detach them and free cached data
+    for (MagazineList::iterator i = _magazines.begin (); i != _magazines.end (); ++i) {
+        SmartPtr<BufferMagazine> &magazine = *i;
+        SmartLock magazine_lock (magazine->mutex);
+        magazine->pool = NULL;
+        for (uint32_t slot = 0; slot < magazine->count; ++slot)
+            magazine->slots[slot].release ();
+        magazine->count = 0;
+    }
+    _magazines.clear ();
 }
 
 bool
@@ -158,11 +261,170 @@ BufferPool::reserve (uint32_t max_count)
     }
     _max_count = i;
     _allocated_num = _max_count;
+    _last_busy_time = xcam_get_monotonic_time ();
     _started = true;
 
     return true;
 }
 
+void
+BufferPool::set_elastic (uint32_t hard_cap, int64_t idle_time)
+{
+    SmartLock lock (_mutex);
+
+    if (hard_cap && hard_cap < _max_count) {
+        XCAM_LOG_WARNING (
+            "BufferPool hard cap(%d) less than reserved count(%d), pool won't grow",
+            hard_cap, _max_count);
+    }
+    _hard_cap = hard_cap;
+    _idle_time = idle_time;
+}
+
+void
+BufferPool::set_callback (BufferPoolCallback *callback)
+{
+    SmartLock lock (_mutex);
+    _callback = callback;
+}
+
+void
+BufferPool::set_thread_cache (uint32_t size)
+{
+    SmartLock lock (_mutex);
+
+    if (!_magazines.empty ()) {
+        XCAM_LOG_WARNING ("BufferPool thread cache already in use, size not changed");
+        return;
+    }
+    _cache_size = size;
+}
+
+void
+BufferPool::get_stats (BufferPoolStats &stats)
+{
+    SmartLock lock (_mutex);
+    stats = _stats;
+    stats.allocated = _allocated_num;
+    stats.in_flight = _in_flight;
+    stats.peak_in_flight = _peak_in_flight;
+}
+
+BufferMagazine *
+BufferPool::get_thread_magazine ()
+{
+    BufferMagazine *magazine = thread_magazines.find (this);
+    if (magazine)
+        return magazine;
+
+    SmartPtr<BufferMagazine> new_magazine = make_smart<BufferMagazine> (this, _cache_size);
+    {
+        SmartLock lock (_mutex);
+        for (MagazineList::iterator i = _magazines.begin (); i != _magazines.end (); ) {
+            if ((*i)->thread_exited)
+                i = _magazines.erase (i);
+            else
+                ++i;
+        }
+        _magazines.push_back (new_magazine);
+    }
+    thread_magazines.add (new_magazine);
+    return new_magazine.ptr ();
+}
+
+void
+BufferPool::drain_thread_magazines ()
+{
+    SmartLock lock (_mutex);
+
+    for (MagazineList::iterator i = _magazines.begin (); i != _magazines.end (); ++i) {
+        SmartPtr<BufferMagazine> &magazine = *i;
+        SmartLock magazine_lock (magazine->mutex);
+        _buf_list.push_batch (magazine->slots, magazine->count);
+        magazine->count = 0;
+    }
+}
+
+SmartPtr<BufferData>
+BufferPool::pop_data ()
+{
+    SmartPtr<BufferData> data;
+    BufferMagazine *magazine = NULL;
+
+    if (!_cache_size) {
+        _buf_list.pop_batch (&data, 1);
+        return data;
+    }
+
+    magazine = get_thread_magazine ();
+    SmartLock lock (magazine->mutex);
+    if (!magazine->count)
+        magazine->count = _buf_list.pop_batch (magazine->slots, (magazine->size + 1) / 2);
+    if (magazine->count)
+        data = std::move (magazine->slots[--magazine->count]);
+    return data;
+}
+
+SmartPtr<BufferData>
+BufferPool::grow_data ()
+{
+    SmartPtr<BufferData> data;
+    SmartLock lock (_mutex);
+
+    if (!_started || _allocated_num >= _hard_cap)
+        return NULL;
+
+    _last_busy_time = xcam_get_monotonic_time ();
+    data = allocate_data (_buffer_info);
+    XCAM_FAIL_RETURN (
+        WARNING,
+        data.ptr (),
+        NULL,
+        "BufferPool grow failed with %d data allocated", _allocated_num.load ());
+
+    ++_allocated_num;
+    ++_stats.grows;
+    XCAM_LOG_DEBUG ("BufferPool grows to %d data", _allocated_num.load ());
+    return data;
+}
+
+SmartPtr<BufferData>
+BufferPool::wait_data (int32_t timeout)
+{
+    SmartPtr<BufferData> data;
+    BufferPoolCallback *callback = NULL;
+    BufferPoolStats stats;
+    int64_t start_time = 0;
+
+    {
+        SmartLock lock (_mutex);
+        ++_stats.waits;
+        _last_busy_time = xcam_get_monotonic_time ();
+        callback = _callback;
+        stats = _stats;
+        stats.allocated = _allocated_num;
+        stats.in_flight = _in_flight;
+        stats.peak_in_flight = _peak_in_flight;
+    }
+    XCAM_LOG_DEBUG ("BufferPool exhausted, %d buffers in flight", stats.in_flight);
+    if (callback)
+        callback->buffer_pool_exhausted (this, stats);
+
+    start_time = xcam_get_monotonic_time ();
+    if (timeout != 0) {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_POOL, "buffer_pool_wait");
+        data = _buf_list.pop (timeout);
+    }
+
+    SmartLock lock (_mutex);
+    _stats.wait_time += xcam_get_monotonic_time () - start_time;
+    if (!data.ptr ()) {
+        ++_stats.timeouts;
+        XCAM_LOG_DEBUG ("BufferPool failed to get buffer");
+    }
+    return data;
+}
+
 bool
 BufferPool::add_data_unsafe (SmartPtr<BufferData> data)
 {
@@ -177,16 +439,14 @@ BufferPool::add_data_unsafe (SmartPtr<BufferData> data)
 }
 
 SmartPtr<BufferProxy>
-BufferPool::get_buffer (const SmartPtr<BufferPool> &self)
+BufferPool::get_buffer (const SmartPtr<BufferPool> &self, int32_t timeout)
 {
     SmartPtr<BufferProxy> ret_buf;
     SmartPtr<BufferData> data;
+    uint32_t in_flight = 0, peak = 0;
 
-    {
-        SmartLock lock (_mutex);
-        if (!_started)
-            return NULL;
-    }
+    if (!_started)
+        return NULL;
 
     XCAM_ASSERT (self.ptr () == this);
     XCAM_FAIL_RETURN(
@@ -195,11 +455,28 @@ BufferPool::get_buffer (const SmartPtr<BufferPool> &self)
         NULL,
         "BufferPool get_buffer failed since parameter<self> not this");
 
-    data = _buf_list.pop ();
+    data = pop_data ();
     if (!data.ptr ()) {
-        XCAM_LOG_DEBUG ("BufferPool failed to get buffer");
-        return NULL;
+        // releases skip magazines while someone is short of data
+        ++_waiters;
+        if (_cache_size) {
+            drain_thread_magazines ();
+            _buf_list.pop_batch (&data, 1);
+        }
+        if (!data.ptr ())
+            data = grow_data ();
+        if (!data.ptr ())
+            data = wait_data (timeout);
+        --_waiters;
+
+        if (!data.ptr ())
+            return NULL;
     }
+
+    in_flight = ++_in_flight;
+    peak = _peak_in_flight;
+    while (in_flight > peak && !_peak_in_flight.compare_exchange_weak (peak, in_flight));
+
     ret_buf = create_buffer_from_data (data);
     ret_buf->set_buf_pool (self);
 
@@ -209,20 +486,61 @@ BufferPool::get_buffer (const SmartPtr<BufferPool> &self)
 void
 BufferPool::stop ()
 {
-    {
-        SmartLock lock (_mutex);
-        _started = false;
-    }
+    _started = false;
     _buf_list.pause_pop ();
 }
 
+bool
+BufferPool::try_shrink ()
+{
+    int64_t now = 0;
+    SmartLock lock (_mutex);
+
+    if (_allocated_num <= _max_count)
+        return false;
+
+    now = xcam_get_monotonic_time ();
+    if (now - _last_busy_time <= _idle_time)
+        return false;
+
+    --_allocated_num;
+    ++_stats.shrinks;
+    _last_busy_time = now;
+    XCAM_LOG_DEBUG ("BufferPool shrinks to %d data", _allocated_num.load ());
+    return true;
+}
+
 void
 BufferPool::release (SmartPtr<BufferData> &data)
 {
-    {
-        SmartLock lock (_mutex);
-        if (!_started)
+    BufferMagazine *magazine = NULL;
+
+    XCAM_ASSERT (_in_flight);
+    --_in_flight;
+    if (!_started)
+        return;
+
+    // idle long enough, drop this data to shrink back to reserved count
+    if (_hard_cap && _allocated_num > _max_count && try_shrink ())
+        return;
+
+    if (_cache_size && !_waiters)
+        magazine = get_thread_magazine ();
+
+    if (magazine) {
+        SmartLock lock (magazine->mutex);
+        // checked under magazine lock, a waiter drains this magazine afterwards otherwise
+        if (!_waiters) {
+            if (magazine->count == magazine->size) {
+                uint32_t flush_count = (magazine->size + 1) / 2;
+                _buf_list.push_batch (magazine->slots, flush_count);
+                for (uint32_t i = flush_count; i < magazine->count; ++i)
+                    magazine->slots[i - flush_count] = std::move (magazine->slots[i]);
+                magazine->count -= flush_count;
+            }
+            magazine->slots[magazine->count++] = std::move (data);
             return;
+        }
     }
     _buf_list.push (data);
 }
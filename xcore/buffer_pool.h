@@ -25,10 +25,41 @@
 #include "smartptr.h"
 #include "safe_list.h"
 #include "video_buffer.h"
+#include <atomic>
+#include <list>
+
+#define XCAM_BUFFER_POOL_DEFAULT_IDLE_TIME (2 * 1000000) // 2 seconds
 
 namespace XCam {
 
 class BufferPool;
+class BufferMagazine;
+class ThreadMagazines;
+
+struct BufferPoolStats {
+    uint32_t   allocated;     // buffer data allocated by pool
+    uint32_t   in_flight;     // buffers held by users
+    uint32_t   peak_in_flight;
+    uint64_t   waits;         // get_buffer calls waited on empty pool
+    int64_t    wait_time;     // total wait time in microseconds
+    uint64_t   timeouts;      // get_buffer calls returned without buffer
+    uint64_t   grows;
+    uint64_t   shrinks;
+
+    BufferPoolStats ();
+};
+
+class BufferPoolCallback {
+public:
+    BufferPoolCallback () {}
+    virtual ~BufferPoolCallback () {}
+
+    // pool is empty and can't grow anymore, get_buffer starts waiting
+    virtual void buffer_pool_exhausted (BufferPool *pool, const BufferPoolStats &stats) = 0;
+
+private:
+    XCAM_DEAD_COPY (BufferPoolCallback);
+};
 
 class BufferData {
 public:
@@ -40,6 +71,17 @@ public:
     virtual int get_fd () {
         return -1;
     }
+    /*
+     * data keeping a persistent mapping needs sync for coherency,
+     * sync_for_cpu before cpu reads what device wrote,
+     * sync_for_device before device uses what cpu wrote.
+     */
+    virtual bool sync_for_cpu () {
+        return true;
+    }
+    virtual bool sync_for_device () {
+        return true;
+    }
 
 private:
     XCAM_DEAD_COPY (BufferData);
@@ -64,11 +106,11 @@ public:
     virtual uint8_t *map ();
     virtual bool unmap ();
     virtual int get_fd();
+    virtual bool sync_for_cpu ();
+    virtual bool sync_for_device ();
 
-    bool attach_buffer (const SmartPtr<VideoBuffer>& buf);
-    bool detach_buffer (const SmartPtr<VideoBuffer>& buf);
-    bool copy_attaches (const SmartPtr<BufferProxy>& buf);
-    void clear_attached_buffers ();
+    // take stream id, stamps and metas of @buf this one is derived from
+    bool copy_attaches (BorrowedPtr<BufferProxy> buf);
 
 protected:
     SmartPtr<BufferData> &get_buffer_data () {
@@ -78,9 +120,6 @@ protected:
 private:
     XCAM_DEAD_COPY (BufferProxy);
 
-protected:
-    VideoBufferList            _attached_bufs;
-
 private:
     SmartPtr<BufferData>       _data;
     SmartPtr<BufferPool>       _pool;
@@ -89,6 +128,7 @@ private:
 
 class BufferPool {
     friend class BufferProxy;
+    friend class ThreadMagazines;
 
 public:
     explicit BufferPool ();
@@ -96,7 +136,28 @@ public:
 
     bool set_video_info (const VideoBufferInfo &info);
     bool reserve (uint32_t max_count = 4);
-    SmartPtr<BufferProxy> get_buffer (const SmartPtr<BufferPool> &self);
+
+    /*
+     * elastic pool, allocate more data on demand up to @hard_cap,
+     * free data one by one down to reserved count after @idle_time (us) without shortage.
+     * hard_cap 0 keeps pool size fixed to reserved count.
+     */
+    void set_elastic (uint32_t hard_cap, int64_t idle_time = XCAM_BUFFER_POOL_DEFAULT_IDLE_TIME);
+    void set_callback (BufferPoolCallback *callback);
+
+    /*
+     * per-thread magazine of @size data in front of shared free list,
+     * get_buffer/release recycle data in calling thread without shared lock,
+     * magazines refill and flush half of @size at a time. 0 disables it.
+     */
+    void set_thread_cache (uint32_t size);
+
+    /*
+     * timeout, -1,  wait until buffer returned or pool stopped
+     *         >=0,  wait for @timeout microseconds
+     */
+    SmartPtr<BufferProxy> get_buffer (const SmartPtr<BufferPool> &self, int32_t timeout = -1);
+    void get_stats (BufferPoolStats &stats);
 
     void stop ();
 
@@ -112,16 +173,34 @@ protected:
     bool add_data_unsafe (SmartPtr<BufferData> data);
 
 private:
+    typedef std::list<SmartPtr<BufferMagazine> > MagazineList;
+
     void release (SmartPtr<BufferData> &data);
+    SmartPtr<BufferData> pop_data ();
+    SmartPtr<BufferData> grow_data ();
+    SmartPtr<BufferData> wait_data (int32_t timeout);
+    bool try_shrink ();
+    BufferMagazine *get_thread_magazine ();
+    void drain_thread_magazines ();
     XCAM_DEAD_COPY (BufferPool);
 
 private:
     Mutex                    _mutex;
     VideoBufferInfo          _buffer_info;
     SafeList<BufferData>     _buf_list;
-    uint32_t                 _allocated_num;
+    std::atomic<uint32_t>    _allocated_num;
     uint32_t                 _max_count;
-    bool                     _started;
+    std::atomic<bool>        _started;
+    uint32_t                 _hard_cap;
+    int64_t                  _idle_time;
+    int64_t                  _last_busy_time;
+    BufferPoolCallback      *_callback;
+    BufferPoolStats          _stats;
+    std::atomic<uint32_t>    _in_flight;
+    std::atomic<uint32_t>    _peak_in_flight;
+    std::atomic<uint32_t>    _waiters;
+    uint32_t                 _cache_size;
+    MagazineList             _magazines;
 };
 
 };
@@ -40,7 +40,8 @@
 #include "cl_biyuv_handler.h"
 #include "cl_image_scaler.h"
 
-#define XCAM_CL_3A_IMAGE_MAX_POOL_SIZE 6
+#define XCAM_CL_3A_IMAGE_POOL_SIZE 6
+#define XCAM_CL_3A_IMAGE_MAX_POOL_SIZE 12
 #define XCAM_CL_3A_IMAGE_SCALER_FACTOR 0.5
 
 namespace XCam {
@@ -346,7 +347,7 @@ CL3aImageProcessor::create_handlers ()
 #endif
     _bayer_pipe->enable_denoise (XCAM_DENOISE_TYPE_BNR & _snr_mode);
     _bayer_pipe->enable_gamma (_enable_gamma);
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE * 2);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE * 2, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE * 2);
     add_handler (image_handler);
     if(_capture_stage == BasicbayerStage)
         return XCAM_RETURN_NO_ERROR;
@@ -432,7 +433,7 @@ CL3aImageProcessor::create_handlers ()
         _demosaic.ptr (),
         XCAM_RETURN_ERROR_CL,
         "CL3aImageProcessor create demosaic handler failed");
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
     add_handler (image_handler);
 #endif
 
@@ -446,7 +447,7 @@ CL3aImageProcessor::create_handlers ()
         "CL3aImageProcessor create hdr handler failed");
     if(_hdr_mode == CL_HDR_TYPE_LAB)
         _hdr->set_mode (_hdr_mode);
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
     add_handler (image_handler);
 
     /* bilateral noise reduction */
@@ -458,7 +459,7 @@ CL3aImageProcessor::create_handlers ()
         XCAM_RETURN_ERROR_CL,
         "CL3aImageProcessor create denoise handler failed");
     _binr->set_kernels_enable (XCAM_DENOISE_TYPE_BILATERAL & _snr_mode);
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
     add_handler (image_handler);
 
 #if 0
@@ -492,7 +493,7 @@ CL3aImageProcessor::create_handlers ()
         XCAM_RETURN_ERROR_CL,
         "CL3aImageProcessor create snr handler failed");
     _snr->set_kernels_enable (XCAM_DENOISE_TYPE_SIMPLE & _snr_mode);
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
     add_handler (image_handler);
 #endif
 
@@ -505,7 +506,7 @@ CL3aImageProcessor::create_handlers ()
         XCAM_RETURN_ERROR_CL,
         "CL3aImageProcessor create tonemapping handler failed");
     _tonemapping->set_kernels_enable (_enable_tonemapping);
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
     add_handler (image_handler);
 
 #if 1
@@ -517,7 +518,7 @@ CL3aImageProcessor::create_handlers ()
         XCAM_RETURN_ERROR_CL,
         "CL3aImageProcessor create macc handler failed");
     _yuv_pipe->set_tnr_enable (_tnr_mode & CL_TNR_TYPE_RGB, _tnr_mode & CL_TNR_TYPE_YUV);
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
     add_handler (image_handler);
 #else
     /* macc */
@@ -566,7 +567,7 @@ CL3aImageProcessor::create_handlers ()
         "CL3aImageProcessor create ee handler failed");
     _ee->set_kernels_enable (XCAM_DENOISE_TYPE_EE & _snr_mode);
     image_handler->set_pool_type (CLImageHandler::DrmBoPoolType);
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
     add_handler (image_handler);
 
 
@@ -580,7 +581,7 @@ CL3aImageProcessor::create_handlers ()
         "CL3aImageProcessor create biyuv handler failed");
     _biyuv->set_kernels_enable (XCAM_DENOISE_TYPE_BIYUV & _snr_mode);
     image_handler->set_pool_type (CLImageHandler::DrmBoPoolType);
-    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+    image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
     add_handler (image_handler);
 
     /* image scaler */
@@ -606,7 +607,7 @@ CL3aImageProcessor::create_handlers ()
             XCAM_RETURN_ERROR_CL,
             "CL3aImageProcessor create csc handler failed");
         image_handler->set_pool_type (CLImageHandler::DrmBoPoolType);
-        image_handler->set_pool_size (XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
+        image_handler->set_pool_size (XCAM_CL_3A_IMAGE_POOL_SIZE, XCAM_CL_3A_IMAGE_MAX_POOL_SIZE);
         add_handler (image_handler);
     }
 
@@ -103,7 +103,7 @@ CL3AStatsCalculatorKernel::post_execute ()
     event.release ();
 
     stats->set_timestamp (_output_buffer->get_timestamp ());
-    _output_buffer->attach_buffer (stats);
+    _output_buffer->set_meta (VIDEO_BUFFER_META_3A_STATS, stats);
 
     _stats_buf_index = ((_stats_buf_index + 1) % XCAM_CL_3A_STATS_BUFFER_COUNT);
 
@@ -373,7 +373,7 @@ CLBayerPipeImageKernel::post_execute ()
     }
 
     stats_3a->set_timestamp (_output_buffer->get_timestamp ());
-    _output_buffer->attach_buffer (stats_3a);
+    _output_buffer->set_meta (VIDEO_BUFFER_META_3A_STATS, stats_3a);
 
     _stats_cl_buffer.release ();
     _output_buffer.release ();
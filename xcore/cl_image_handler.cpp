@@ -22,6 +22,7 @@
 #include "drm_display.h"
 #include "cl_device.h"
 #include "cl_image_bo_buffer.h"
+#include "xcam_trace.h"
 
 namespace XCam {
 
@@ -138,21 +139,31 @@ CLImageKernel::post_execute ()
 
 CLImageHandler::CLImageHandler (const char *name)
     : _name (NULL)
+    , _wait_checkpoint (NULL)
     , _buf_pool_type (CLImageHandler::CLBoPoolType)
     , _buf_pool_size (XCAM_CL_IMAGE_HANDLER_DEFAULT_BUF_NUM)
+    , _buf_pool_max_size (0)
     , _result_timestamp (XCam::InvalidTimestamp)
+    , _exec_count (0)
+    , _exec_time (0)
+    , _exec_max_time (0)
 {
     XCAM_ASSERT (name);
     if (name)
         _name = strdup (name);
 
-    XCAM_OBJ_PROFILING_INIT;
+    // frame stage before execute is "<name>_wait", execute itself is "<name>"
+    char checkpoint[XCAM_STAMP_NAME_SIZE];
+    snprintf (checkpoint, sizeof (checkpoint), "%s_wait", XCAM_STR (name));
+    _wait_checkpoint = strdup (checkpoint);
 }
 
 CLImageHandler::~CLImageHandler ()
 {
     if (_name)
         xcam_free (_name);
+    if (_wait_checkpoint)
+        xcam_free (_wait_checkpoint);
 }
 
 bool
@@ -185,13 +196,22 @@ CLImageHandler::is_kernels_enabled () const
     return false;
 }
 
+SmartPtr<BufferPool>
+CLImageHandler::get_buffer_pool (uint32_t stream_id)
+{
+    SmartLock lock (_pool_mutex);
+    if (stream_id < _buf_pools.size ())
+        return _buf_pools[stream_id];
+    return NULL;
+}
+
 XCamReturn
-CLImageHandler::create_buffer_pool (const VideoBufferInfo &video_info)
+CLImageHandler::create_buffer_pool (const VideoBufferInfo &video_info, uint32_t stream_id)
 {
     SmartPtr<BufferPool> buffer_pool;
     SmartPtr<DrmDisplay> display;
 
-    if (_buf_pool.ptr ())
+    if (get_buffer_pool (stream_id).ptr ())
         return XCAM_RETURN_ERROR_PARAM;
 
     display = DrmDisplay::instance ();
@@ -217,6 +237,7 @@ CLImageHandler::create_buffer_pool (const VideoBufferInfo &video_info)
 
     XCAM_ASSERT (buffer_pool.ptr ());
     buffer_pool->set_video_info (video_info);
+    buffer_pool->set_thread_cache (XCAM_CL_IMAGE_HANDLER_THREAD_CACHE);
 
     XCAM_FAIL_RETURN(
         WARNING,
@@ -224,7 +245,13 @@ CLImageHandler::create_buffer_pool (const VideoBufferInfo &video_info)
         XCAM_RETURN_ERROR_CL,
         "CLImageHandler(%s) failed to init drm buffer pool", XCAM_STR (_name));
 
-    _buf_pool = buffer_pool;
+    if (_buf_pool_max_size > _buf_pool_size)
+        buffer_pool->set_elastic (_buf_pool_max_size);
+
+    SmartLock lock (_pool_mutex);
+    if (stream_id >= _buf_pools.size ())
+        _buf_pools.resize (stream_id + 1);
+    _buf_pools[stream_id] = buffer_pool;
     return XCAM_RETURN_NO_ERROR;
 }
 
@@ -241,8 +268,10 @@ CLImageHandler::prepare_output_buf (SmartPtr<DrmBoBuffer> &input, SmartPtr<DrmBo
 {
     SmartPtr<BufferProxy> new_buf;
     XCamReturn ret = XCAM_RETURN_NO_ERROR;
+    uint32_t stream_id = input->get_stream_id ();
+    SmartPtr<BufferPool> buf_pool = get_buffer_pool (stream_id);
 
-    if (!_buf_pool.ptr ()) {
+    if (!buf_pool.ptr ()) {
         VideoBufferInfo output_video_info;
 
         ret = prepare_buffer_pool_video_info (input->get_video_info (), output_video_info);
@@ -252,20 +281,21 @@ CLImageHandler::prepare_output_buf (SmartPtr<DrmBoBuffer> &input, SmartPtr<DrmBo
             ret,
             "CLImageHandler(%s) prepare output video info failed", XCAM_STR (_name));
 
-        ret = create_buffer_pool (output_video_info);
+        ret = create_buffer_pool (output_video_info, stream_id);
         XCAM_FAIL_RETURN(
             WARNING,
             ret == XCAM_RETURN_NO_ERROR,
             ret,
-            "CLImageHandler(%s) ensure drm buffer pool failed", XCAM_STR (_name));
+            "CLImageHandler(%s) ensure drm buffer pool of stream(%d) failed", XCAM_STR (_name), stream_id);
+        buf_pool = get_buffer_pool (stream_id);
     }
 
-    new_buf = _buf_pool->get_buffer (_buf_pool);
+    new_buf = buf_pool->get_buffer (buf_pool, XCAM_CL_IMAGE_HANDLER_BUF_TIMEOUT);
     XCAM_FAIL_RETURN(
         WARNING,
         new_buf.ptr(),
-        XCAM_RETURN_ERROR_UNKNOWN,
-        "CLImageHandler(%s) failed to get drm buffer from pool", XCAM_STR (_name));
+        XCAM_RETURN_ERROR_TIMEOUT,
+        "CLImageHandler(%s) failed to get drm buffer from pool of stream(%d)", XCAM_STR (_name), stream_id);
 
     new_buf->set_timestamp (input->get_timestamp ());
     new_buf->copy_attaches (input);
@@ -283,8 +313,11 @@ CLImageHandler::emit_stop ()
         (*i_kernel)->pre_stop ();
     }
 
-    if (_buf_pool.ptr ())
-        _buf_pool->stop ();
+    SmartLock lock (_pool_mutex);
+    for (uint32_t i = 0; i < _buf_pools.size (); ++i) {
+        if (_buf_pools[i].ptr ())
+            _buf_pools[i]->stop ();
+    }
 }
 
 XCamReturn
@@ -303,7 +336,9 @@ CLImageHandler::execute (SmartPtr<DrmBoBuffer> &input, SmartPtr<DrmBoBuffer> &ou
         return XCAM_RETURN_NO_ERROR;
     }
 
-    XCAM_OBJ_PROFILING_START;
+    XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_HANDLER, _name);
+    input->add_stamp (_wait_checkpoint);
+    int64_t start_time = xcam_get_monotonic_time ();
 
     XCAM_FAIL_RETURN (
         WARNING,
@@ -326,6 +361,9 @@ CLImageHandler::execute (SmartPtr<DrmBoBuffer> &input, SmartPtr<DrmBoBuffer> &ou
         if (!kernel->is_enabled ())
             continue;
 
+        // kernel is enqueued here, device time shows in handler span only with profiling finish
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_KERNEL, kernel->get_kernel_name ());
+
         XCAM_FAIL_RETURN (
             WARNING,
             (ret = kernel->pre_execute (input, output)) == XCAM_RETURN_NO_ERROR,
@@ -352,11 +390,45 @@ CLImageHandler::execute (SmartPtr<DrmBoBuffer> &input, SmartPtr<DrmBoBuffer> &ou
     CLDevice::instance()->get_context ()->finish ();
 #endif
 
-    XCAM_OBJ_PROFILING_END (XCAM_STR (_name), 30);
+    output->add_stamp (XCAM_STR (_name));
+
+    int64_t exec_time = xcam_get_monotonic_time () - start_time;
+    int64_t max_time = _exec_max_time.load ();
+    while (exec_time > max_time && !_exec_max_time.compare_exchange_weak (max_time, exec_time));
+    _exec_time += exec_time;
+    ++_exec_count;
 
     return XCAM_RETURN_NO_ERROR;
 }
 
+void
+CLImageHandler::get_metrics (PipelineMetrics &metrics)
+{
+    HandlerMetrics handler;
+    uint64_t count = _exec_count.load ();
+
+    strncpy (handler.name, XCAM_STR (_name), sizeof (handler.name) - 1);
+    handler.name[sizeof (handler.name) - 1] = '\0';
+    handler.executions = count;
+    handler.mean_time = count ? _exec_time.load () / (int64_t)count : 0;
+    handler.max_time = _exec_max_time.load ();
+    metrics.handlers.push_back (handler);
+
+    SmartLock lock (_pool_mutex);
+    for (uint32_t i = 0; i < _buf_pools.size (); ++i) {
+        char name[XCAM_METRICS_NAME_SIZE];
+
+        if (!_buf_pools[i].ptr ())
+            continue;
+        if (i == 0)
+            strncpy (name, XCAM_STR (_name), sizeof (name) - 1);
+        else
+            snprintf (name, sizeof (name), "%s.%d", XCAM_STR (_name), i);
+        name[sizeof (name) - 1] = '\0';
+        metrics.add_pool (name, *_buf_pools[i].ptr ());
+    }
+}
+
 void
 CLImageHandler::set_3a_result (SmartPtr<X3aResult> &result)
 {
@@ -26,10 +26,17 @@
 #include "drm_bo_buffer.h"
 #include "cl_memory.h"
 #include "x3a_result.h"
+#include "pipeline_metrics.h"
+#include <atomic>
+#include <vector>
 
 namespace XCam {
 
 #define XCAM_DEFAULT_IMAGE_DIM 2
+// buffers cached per thread in handler pools
+#define XCAM_CL_IMAGE_HANDLER_THREAD_CACHE 2
+// output buffers held downstream too long, frame dropped instead of stalling
+#define XCAM_CL_IMAGE_HANDLER_BUF_TIMEOUT 100000  // us
 
 struct CLWorkSize
 {
@@ -108,18 +115,24 @@ public:
     void set_pool_type (BufferPoolType type) {
         _buf_pool_type = type;
     }
-    void set_pool_size (uint32_t size) {
+    // @max_size larger than @size makes output pool elastic
+    void set_pool_size (uint32_t size, uint32_t max_size = 0) {
         XCAM_ASSERT (size);
         _buf_pool_size = size;
+        _buf_pool_max_size = max_size;
     }
 
     bool add_kernel (SmartPtr<CLImageKernel> &kernel);
     bool set_kernels_enable (bool enable);
     bool is_kernels_enabled () const;
 
+    // XCAM_RETURN_ERROR_TIMEOUT if no output buffer in time, frame can be dropped
     XCamReturn execute (SmartPtr<DrmBoBuffer> &input, SmartPtr<DrmBoBuffer> &output);
     virtual void emit_stop ();
 
+    // execution time of this handler and occupancy of its output pool
+    void get_metrics (PipelineMetrics &metrics);
+
 protected:
     virtual XCamReturn prepare_buffer_pool_video_info (
         const VideoBufferInfo &input,
@@ -127,24 +140,28 @@ protected:
 
     // if derive prepare_output_buf, then prepare_buffer_pool_video_info is not involked
     virtual XCamReturn prepare_output_buf (SmartPtr<DrmBoBuffer> &input, SmartPtr<DrmBoBuffer> &output);
-    XCamReturn create_buffer_pool (const VideoBufferInfo &video_info);
-    SmartPtr<BufferPool> &get_buffer_pool () {
-        return _buf_pool;
-    }
+    // output pools are per stream, frames of different cameras may differ in size
+    XCamReturn create_buffer_pool (const VideoBufferInfo &video_info, uint32_t stream_id = 0);
+    SmartPtr<BufferPool> get_buffer_pool (uint32_t stream_id = 0);
 
 private:
     XCAM_DEAD_COPY (CLImageHandler);
 
 private:
     char                      *_name;
+    char                      *_wait_checkpoint;
     KernelList                 _kernels;
-    SmartPtr<BufferPool>       _buf_pool;
+    std::vector<SmartPtr<BufferPool> >  _buf_pools;  // indexed by stream id
     BufferPoolType             _buf_pool_type;
     uint32_t                   _buf_pool_size;
+    uint32_t                   _buf_pool_max_size;
     X3aResultList              _3a_results;
     int64_t                    _result_timestamp;
 
-    XCAM_OBJ_PROFILING_DEFINES;
+    Mutex                      _pool_mutex;     // _buf_pools are created on handler thread
+    std::atomic<uint64_t>      _exec_count;
+    std::atomic<int64_t>       _exec_time;
+    std::atomic<int64_t>       _exec_max_time;
 };
 
 };
@@ -23,16 +23,17 @@
 #include "cl_image_handler.h"
 #include "drm_display.h"
 #include "cl_demo_handler.h"
-#include "xcam_thread.h"
+#include "xcam_executor.h"
+#include "xcam_trace.h"
 
 namespace XCam {
 
 class CLHandlerThread
-    : public Thread
+    : public TaskThread
 {
 public:
     CLHandlerThread (CLImageProcessor *processor)
-        : Thread ("CLHandlerThread")
+        : TaskThread ("CLHandlerThread")
         , _processor (processor)
     {}
     ~CLHandlerThread () {}
@@ -63,7 +64,6 @@ CLImageProcessor::CLImageProcessor (const char* name)
     XCAM_ASSERT (_handler_thread.ptr ());
 
     XCAM_LOG_DEBUG ("CLImageProcessor constructed");
-    XCAM_OBJ_PROFILING_INIT;
 }
 
 CLImageProcessor::~CLImageProcessor ()
@@ -79,6 +79,26 @@ CLImageProcessor::add_handler (SmartPtr<CLImageHandler> &handler)
     return true;
 }
 
+bool
+CLImageProcessor::set_handler_thread_attributes (const ThreadAttributes &attrs)
+{
+    return _handler_thread->set_attributes (attrs);
+}
+
+void
+CLImageProcessor::get_metrics (PipelineMetrics &metrics)
+{
+    ImageProcessor::get_metrics (metrics);
+    metrics.add_queue (get_name (), "process", _process_buffer_queue.size ());
+    metrics.add_queue (get_name (), "done", _done_buffer_queue.size ());
+
+    STREAM_LOCK;
+    for (ImageHandlerList::iterator i_handler = _handlers.begin ();
+            i_handler != _handlers.end (); ++i_handler) {
+        (*i_handler)->get_metrics (metrics);
+    }
+}
+
 SmartPtr<CLContext>
 CLImageProcessor::get_cl_context ()
 {
@@ -121,7 +141,7 @@ CLImageProcessor::process_buffer (SmartPtr<VideoBuffer> &input, SmartPtr<VideoBu
         "CL image processor can't handle this buffer, maybe type error");
 
     while (!_done_buffer_queue.is_empty ()) {
-        SmartPtr<DrmBoBuffer> done_buf = _done_buffer_queue.pop (50000); //50ms
+        SmartPtr<VideoBuffer> done_buf = _done_buffer_queue.pop (50000); //50ms
         if (!done_buf.ptr ())
             break;
         //notify buffer done
@@ -141,32 +161,45 @@ CLImageProcessor::process_buffer (SmartPtr<VideoBuffer> &input, SmartPtr<VideoBu
         XCAM_RETURN_ERROR_CL,
         "CL image processor create handlers failed");
 
-    SmartPtr<PriorityBuffer> p_buf = new PriorityBuffer;
+    SmartPtr<PriorityBuffer> p_buf = make_smart<PriorityBuffer> ();
     p_buf->set_seq_num (_seq_num++);
-    p_buf->data = drm_bo_in;
+    p_buf->stream_id = drm_bo_in->get_stream_id ();
+    p_buf->data = std::move (drm_bo_in);
     p_buf->handler = *(_handlers.begin ());
 
     XCAM_FAIL_RETURN (
         WARNING,
-        _process_buffer_queue.push_priority_buf (p_buf),
+        push_cl_buffer (p_buf),
         XCAM_RETURN_ERROR_UNKNOWN,
         "CLImageProcessor push priority buffer failed");
 
     return XCAM_RETURN_BYPASS;
 }
 
+bool
+CLImageProcessor::push_cl_buffer (const SmartPtr<PriorityBuffer> &p_buf)
+{
+    if (!_process_buffer_queue.push_priority_buf (p_buf))
+        return false;
+
+    _handler_thread->wakeup ();
+    return true;
+}
+
 XCamReturn
 CLImageProcessor::process_cl_buffer_queue ()
 {
     XCamReturn ret = XCAM_RETURN_NO_ERROR;
-    SmartPtr<PriorityBuffer> p_buf = _process_buffer_queue.pop (-1);
+    // one buffer queued per wakeup, highest priority one is taken
+    SmartPtr<PriorityBuffer> p_buf = _process_buffer_queue.pop (0);
     if (!p_buf.ptr ()) {
-        XCAM_LOG_DEBUG ("cl buffer queue stopped");
-        return XCAM_RETURN_ERROR_MEM;
+        XCAM_LOG_DEBUG ("cl buffer queue empty or stopped");
+        return XCAM_RETURN_BYPASS;
     }
 
-    SmartPtr<DrmBoBuffer> data = p_buf->data;
-    SmartPtr<CLImageHandler> handler = p_buf->handler;
+    // p_buf gets new data and handler below, take them over
+    SmartPtr<DrmBoBuffer> data = std::move (p_buf->data);
+    SmartPtr<CLImageHandler> handler = std::move (p_buf->handler);
     SmartPtr <DrmBoBuffer> out_data;
 
     XCAM_ASSERT (data.ptr () && handler.ptr ());
@@ -176,6 +209,12 @@ CLImageProcessor::process_cl_buffer_queue ()
     {
         STREAM_LOCK;
         ret = handler->execute (data, out_data);
+        if (ret == XCAM_RETURN_ERROR_TIMEOUT) {
+            // no output buffer in time, drop this frame and keep handler thread running
+            XCAM_LOG_WARNING ("CLImageProcessor(%s) handler timeout, drop buffer", XCAM_STR (get_name ()));
+            notify_process_buffer_failed (data);
+            return XCAM_RETURN_BYPASS;
+        }
         XCAM_FAIL_RETURN (
             WARNING,
             ret == XCAM_RETURN_NO_ERROR,
@@ -201,29 +240,59 @@ CLImageProcessor::process_cl_buffer_queue ()
     // buffer processed by all handlers, done
     if (!p_buf->handler.ptr ()) {
         if (out_data.ptr ())
-            out_data->clear_attached_buffers ();
+            out_data->clear_metas ();
 
-        XCAM_OBJ_PROFILING_START;
-        CLDevice::instance()->get_context ()->finish ();
-        XCAM_OBJ_PROFILING_END (get_name (), 30);
+        {
+            XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_PROCESSOR, "cl_finish");
+            CLDevice::instance()->get_context ()->finish ();
+        }
 
         // buffer done, push back
-        _done_buffer_queue.push (out_data);
+        out_data->add_stamp (XCAM_STAMP_DONE_PUSH);
+        if (!_done_buffer_queue.push (std::move (out_data))) {
+            // full ring keeps the buffer, report it instead of losing the frame silently
+            XCAM_LOG_WARNING ("CLImageProcessor(%s) done queue full, drop buffer", XCAM_STR (get_name ()));
+            notify_process_buffer_failed (out_data);
+            return XCAM_RETURN_BYPASS;
+        }
         return XCAM_RETURN_NO_ERROR;
     }
 
-    p_buf->data = out_data;
+    p_buf->data = std::move (out_data);
     p_buf->down_rank ();
 
     XCAM_FAIL_RETURN (
         WARNING,
-        _process_buffer_queue.push_priority_buf (p_buf),
+        push_cl_buffer (p_buf),
         XCAM_RETURN_ERROR_UNKNOWN,
         "CLImageProcessor push priority buffer failed");
 
     return ret;
 }
 
+XCamReturn
+CLImageProcessor::prepare ()
+{
+    XCamReturn ret = XCAM_RETURN_NO_ERROR;
+
+    STREAM_LOCK;
+    if (_handlers.empty ())
+        ret = create_handlers ();
+
+    XCAM_FAIL_RETURN (
+        WARNING,
+        !_handlers.empty () && ret == XCAM_RETURN_NO_ERROR,
+        XCAM_RETURN_ERROR_CL,
+        "CL image processor(%s) prepare handlers failed", XCAM_STR (get_name ()));
+
+    if (_handlers.size () > XCAM_STAMP_MAX_HANDLERS) {
+        XCAM_LOG_WARNING (
+            "CL image processor(%s) has %d handlers, stamps of handlers after %d are dropped",
+            XCAM_STR (get_name ()), (int)_handlers.size (), XCAM_STAMP_MAX_HANDLERS);
+    }
+    return XCAM_RETURN_NO_ERROR;
+}
+
 XCamReturn
 CLImageProcessor::emit_start ()
 {
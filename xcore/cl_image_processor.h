@@ -44,6 +44,20 @@ public:
 
     bool add_handler (SmartPtr<CLImageHandler> &handler);
 
+    // derive from ImageProcessor, for CL handler thread
+    virtual bool set_handler_thread_attributes (const ThreadAttributes &attrs);
+    virtual void get_metrics (PipelineMetrics &metrics);
+    // builds CL handlers and kernels ahead of first buffer
+    virtual XCamReturn prepare ();
+
+    // order of buffers waiting for handlers, see PriorityPolicy
+    void set_priority_policy (PriorityPolicy policy) {
+        _process_buffer_queue.set_policy (policy);
+    }
+    void set_latency_budget (uint32_t stream_id, int64_t budget) {
+        _process_buffer_queue.set_latency_budget (stream_id, budget);
+    }
+
 protected:
 
     //derive from ImageProcessor
@@ -59,6 +73,7 @@ protected:
 private:
     virtual XCamReturn create_handlers ();
 
+    bool push_cl_buffer (const SmartPtr<PriorityBuffer> &p_buf);
     XCamReturn process_cl_buffer_queue ();
     XCAM_DEAD_COPY (CLImageProcessor);
 
@@ -74,9 +89,8 @@ private:
     ImageHandlerList               _handlers;
     SmartPtr<CLHandlerThread>      _handler_thread;
     PriorityBufferQueue            _process_buffer_queue;
-    SafeList<DrmBoBuffer>          _done_buffer_queue;
+    MpmcRingQueue<DrmBoBuffer>     _done_buffer_queue;
     uint32_t                       _seq_num;
-    XCAM_OBJ_PROFILING_DEFINES;
 };
 
 };
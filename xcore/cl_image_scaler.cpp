@@ -190,6 +190,7 @@ CLImageScaler::prepare_output_buf (SmartPtr<DrmBoBuffer> &input, SmartPtr<DrmBoB
         "CLImageScalerKernel prepare scaled video buf failed");
 
     _scaler_buf->set_timestamp (input->get_timestamp ());
+    _scaler_buf->set_stream_id (input->get_stream_id ());
 
     return ret;
 }
@@ -216,8 +217,12 @@ CLImageScaler::prepare_scaler_buf (const VideoBufferInfo &video_info, SmartPtr<D
         _scaler_buf_pool->reserve (6);
     }
 
-    buffer = _scaler_buf_pool->get_buffer (_scaler_buf_pool);
-    XCAM_ASSERT (buffer.ptr ());
+    buffer = _scaler_buf_pool->get_buffer (_scaler_buf_pool, XCAM_CL_IMAGE_HANDLER_BUF_TIMEOUT);
+    XCAM_FAIL_RETURN (
+        WARNING,
+        buffer.ptr (),
+        XCAM_RETURN_ERROR_TIMEOUT,
+        "CLImageScaler failed to get scaled buffer from pool");
 
     output = buffer.dynamic_cast_ptr<DrmBoBuffer> ();
     XCAM_ASSERT (output.ptr ());
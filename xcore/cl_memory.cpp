@@ -448,6 +448,26 @@ CLVaImage::CLVaImage (
     init_va_image (context, bo, image_info, offset);
 }
 
+CLVaImage::CLVaImage (
+    SmartPtr<CLContext> &context,
+    const SmartPtr<VideoBufferView> &view,
+    const CLImageDesc &image_info,
+    uint32_t plane)
+    : CLImage (context)
+{
+    XCAM_ASSERT (view.ptr () && view->is_valid ());
+    XCAM_ASSERT (plane < view->get_video_info ().components);
+
+    _bo = view->get_parent ().dynamic_cast_ptr<DrmBoBuffer> ();
+    if (!_bo.ptr ()) {
+        XCAM_LOG_WARNING ("CLVaImage create va image failed, view parent is not drm buffer");
+        return;
+    }
+    XCAM_ASSERT (image_info.row_pitch == view->get_video_info ().strides[plane]);
+
+    init_va_image (context, _bo, image_info, view->get_video_info ().offsets[plane]);
+}
+
 bool
 CLVaImage::merge_multi_plane (
     const VideoBufferInfo &video_info,
@@ -25,6 +25,7 @@
 #include "cl_context.h"
 #include "cl_event.h"
 #include "drm_bo_buffer.h"
+#include "video_buffer_view.h"
 
 namespace XCam {
 
@@ -41,7 +42,9 @@ struct CLImageDesc {
     bool operator == (const CLImageDesc& desc) const;
 };
 
-class CLMemory {
+class CLMemory
+    : public RefObj
+{
 public:
     explicit CLMemory (SmartPtr<CLContext> &context);
     virtual ~CLMemory ();
@@ -172,6 +175,12 @@ public:
         SmartPtr<DrmBoBuffer> &bo,
         const CLImageDesc &image_info,
         uint32_t offset = 0);
+    // region of @view on its DrmBoBuffer parent, @image_info describes @plane of the view
+    explicit CLVaImage (
+        SmartPtr<CLContext> &context,
+        const SmartPtr<VideoBufferView> &view,
+        const CLImageDesc &image_info,
+        uint32_t plane = 0);
     ~CLVaImage () {}
 
 private:
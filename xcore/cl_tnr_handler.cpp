@@ -453,6 +453,7 @@ CLTnrImageKernel::calculate_image_histogram (SmartPtr<DrmBoBuffer> &input, CLTnr
     if (NULL == image_buffer) {
         return false;
     }
+    input->sync_for_cpu ();
 
     switch (type) {
     case CL_TNR_HIST_HOR_PROJECTION :
@@ -20,15 +20,18 @@
 
 #include "device_manager.h"
 #include "poll_thread.h"
-#include "xcam_thread.h"
+#include "xcam_executor.h"
 #include "x3a_image_process_center.h"
 #include "x3a_analyzer_manager.h"
 #include "isp_image_processor.h"
 #include "isp_controller.h"
+#include "virtual_v4l2_device.h"
 #if HAVE_IA_AIQ
 #include "x3a_analyzer_aiq.h"
 #endif
 #include "scaled_buffer_pool.h"
+#include "startup_graph.h"
+#include <inttypes.h>
 
 #define XCAM_FAILED_STOP(exp, msg, ...)                 \
     if ((exp) != XCAM_RETURN_NO_ERROR) {                \
@@ -39,31 +42,6 @@
 
 namespace XCam {
 
-class MessageThread
-    : public Thread
-{
-public:
-    explicit MessageThread (DeviceManager *dev_manager)
-        : Thread ("MessageThread")
-        , _manager (dev_manager)
-    {}
-
-protected:
-    virtual bool loop ();
-
-    DeviceManager *_manager;
-};
-
-bool
-MessageThread::loop()
-{
-    XCamReturn ret = _manager->message_loop();
-    if (ret == XCAM_RETURN_NO_ERROR || ret == XCAM_RETURN_ERROR_TIMEOUT)
-        return true;
-
-    return false;
-}
-
 XCamMessage::XCamMessage (XCamMessageType type, int64_t timestamp, const char *message)
     : timestamp (timestamp)
     , msg_id (type)
@@ -82,8 +60,14 @@ XCamMessage::~XCamMessage ()
 DeviceManager::DeviceManager()
     : _has_3a (true)
     , _is_running (false)
+    , _poll_mode (POLL_MODE_THREADS)
+    , _stamp_overflows (0)
 {
     _3a_process_center = new X3aImageProcessCenter;
+    _event_bus = new EventBus;
+    _event_bus->subscribe (this, XCAM_EVENT_MASK_ALL, EVENT_DELIVERY_BATCHED);
+    for (int i = 0; i < DEVICE_THREAD_TYPE_COUNT; ++i)
+        _thread_attrs_set[i] = false;
     XCAM_LOG_DEBUG ("~DeviceManager construction");
 }
 
@@ -149,6 +133,16 @@ DeviceManager::set_smart_analyzer (SmartPtr<SmartAnalyzer> analyzer)
     return true;
 }
 
+bool
+DeviceManager::set_stats_recorder (SmartPtr<X3aStatsRecorder> recorder)
+{
+    if (is_running())
+        return false;
+
+    _stats_recorder = recorder;
+    return true;
+}
+
 bool
 DeviceManager::add_image_processor (SmartPtr<ImageProcessor> processor)
 {
@@ -159,94 +153,109 @@ DeviceManager::add_image_processor (SmartPtr<ImageProcessor> processor)
     return _3a_process_center->insert_processor (processor);
 }
 
+bool
+DeviceManager::set_thread_attributes (DeviceThreadType type, const ThreadAttributes &attrs)
+{
+    if (is_running())
+        return false;
+
+    XCAM_ASSERT (type >= 0 && type < DEVICE_THREAD_TYPE_COUNT);
+    _thread_attrs[type] = attrs;
+    _thread_attrs_set[type] = true;
+    return true;
+}
+
+bool
+DeviceManager::set_poll_mode (PollMode mode)
+{
+    if (is_running())
+        return false;
+
+    _poll_mode = mode;
+    return true;
+}
+
 XCamReturn
 DeviceManager::start ()
 {
     XCamReturn ret = XCAM_RETURN_NO_ERROR;
+    StartupGraph graph;
+    uint32_t devices = 0, poll_deps = 0;
+    int device = -1, event_device = -1, analyzer = -1, step = -1;
 
-    // start device
     XCAM_ASSERT (_device->is_opened());
     if (!_device.ptr() || !_device->is_opened()) {
         XCAM_FAILED_STOP (ret = XCAM_RETURN_ERROR_FILE, "capture device not ready");
     }
-    XCAM_FAILED_STOP (ret = _device->start(), "capture device start failed");
-
-    //start subdevice
-    //XCAM_ASSERT (_subdevice->is_opened());
-    if (_subdevice.ptr()) {
-        if (!_subdevice->is_opened())
-            XCAM_FAILED_STOP (ret = XCAM_RETURN_ERROR_FILE, "event device not ready");
-        XCAM_FAILED_STOP (ret = _subdevice->start(), "start event device failed");
+    if (_subdevice.ptr() && !_subdevice->is_opened()) {
+        XCAM_FAILED_STOP (ret = XCAM_RETURN_ERROR_FILE, "event device not ready");
     }
 
-    //suppose _device and _subdevice already started
-    if (!_isp_controller.ptr ())
-        _isp_controller = new IspController (_device);
-    XCAM_ASSERT (_isp_controller.ptr());
-
-    if (_has_3a) {
-        // Initialize and start analyzer
-        uint32_t width = 0, height = 0;
-        uint32_t fps_n = 0, fps_d = 0;
-        double framerate = 30.0;
-
-        if (!_3a_analyzer.ptr()) {
-            _3a_analyzer = X3aAnalyzerManager::instance()->create_analyzer();
-            if (!_3a_analyzer.ptr()) {
-                XCAM_FAILED_STOP (ret = XCAM_RETURN_ERROR_PARAM, "create analyzer failed");
-            }
-        }
-        if (_3a_analyzer->prepare_handlers () != XCAM_RETURN_NO_ERROR) {
-            XCAM_FAILED_STOP (ret = XCAM_RETURN_ERROR_PARAM, "prepare analyzer handler failed");
-        }
-        _3a_analyzer->set_results_callback (this);
-
-        _device->get_size (width, height);
-        _device->get_framerate (fps_n, fps_d);
-        if (fps_d)
-            framerate = (double)fps_n / (double)fps_d;
-        XCAM_FAILED_STOP (
-            ret = _3a_analyzer->init (width, height, framerate),
-            "initialize analyzer failed");
-
-        XCAM_FAILED_STOP (ret = _3a_analyzer->start (), "start analyzer failed");
-
-        if (_smart_analyzer.ptr()) {
-            if (_smart_analyzer->prepare_handlers () != XCAM_RETURN_NO_ERROR) {
-                XCAM_LOG_INFO ("prepare smart analyzer handler failed");
-            }
-            //_smart_analyzer->set_results_callback (this);
-            if (_smart_analyzer->init (width, height, framerate) != XCAM_RETURN_NO_ERROR) {
-                XCAM_LOG_INFO ("initialize smart analyzer failed");
-            }
-            if (_smart_analyzer->start () != XCAM_RETURN_NO_ERROR) {
-                XCAM_LOG_INFO ("start smart analyzer failed");
-            }
-        }
-
-        // Initialize and start image processors
-        if (!_3a_process_center->has_processors()) {
-            // default processor
-            SmartPtr<ImageProcessor> default_processor = new IspImageProcessor (_isp_controller);
-            XCAM_ASSERT (default_processor.ptr ());
-            _3a_process_center->insert_processor (default_processor);
-        }
+    // events of processors and poll thread posted from now on
+    XCAM_FAILED_STOP (ret = _event_bus->start (), "event bus start failed");
 
-        _3a_process_center->set_image_callback(this);
-        XCAM_FAILED_STOP (ret = _3a_process_center->start (), "3A process center start failed");
+    // no isp behind virtual devices, default isp processor then only passes frames through
+    if (!_isp_controller.ptr () && !_device.dynamic_cast_ptr<VirtualV4l2Device> ().ptr ())
+        _isp_controller = new IspController (_device);
 
+    {
+        SmartLock lock (_metrics_mutex);
+        _poll_thread = new PollThread;
     }
-
-    //Initialize and start poll thread
-    _poll_thread = new PollThread;
     _poll_thread->set_capture_device (_device);
     if (_subdevice.ptr ())
         _poll_thread->set_event_device (_subdevice);
-    _poll_thread->set_isp_controller (_isp_controller);
+    if (_isp_controller.ptr ())
+        _poll_thread->set_isp_controller (_isp_controller);
     _poll_thread->set_poll_callback (this);
     _poll_thread->set_stats_callback (this);
+    _poll_thread->set_poll_mode (_poll_mode);
+    if (_thread_attrs_set[DEVICE_THREAD_CAPTURE_POLL])
+        _poll_thread->set_capture_thread_attributes (_thread_attrs[DEVICE_THREAD_CAPTURE_POLL]);
+    if (_thread_attrs_set[DEVICE_THREAD_EVENT_POLL])
+        _poll_thread->set_event_thread_attributes (_thread_attrs[DEVICE_THREAD_EVENT_POLL]);
+
+    /*
+     * device start, analyzer library loading and CL kernel builds run concurrently,
+     * analyzer init needs sensor data of started devices,
+     * poll thread starts after everything else is ready.
+     */
+    device = graph.add_step ("device", this, &DeviceManager::start_capture_device);
+    event_device = graph.add_step ("event_device", this, &DeviceManager::start_event_device);
+    devices = XCAM_STARTUP_DEP (device) | XCAM_STARTUP_DEP (event_device);
+    step = graph.add_step ("stats_pool", this, &DeviceManager::prepare_stats_pool, devices);
+    poll_deps = devices | XCAM_STARTUP_DEP (step);
+
+    if (_has_3a) {
+        step = graph.add_step ("analyzer_load", this, &DeviceManager::load_analyzer);
+        analyzer = graph.add_step ("analyzer", this, &DeviceManager::start_analyzer, devices | XCAM_STARTUP_DEP (step));
+        poll_deps |= XCAM_STARTUP_DEP (analyzer);
+
+        if (_smart_analyzer.ptr ()) {
+            step = graph.add_step ("smart_analyzer", this, &DeviceManager::start_smart_analyzer);
+            poll_deps |= XCAM_STARTUP_DEP (step);
+        }
+
+        step = graph.add_step ("processors_prepare", this, &DeviceManager::prepare_processors);
+        step = graph.add_step ("processors", this, &DeviceManager::start_processors, XCAM_STARTUP_DEP (step));
+        // analyzer may seed warm start results before processors run
+        step = graph.add_step ("warm_start", this, &DeviceManager::push_warm_state, XCAM_STARTUP_DEP (analyzer) | XCAM_STARTUP_DEP (step));
+        poll_deps |= XCAM_STARTUP_DEP (step);
+    }
+    graph.add_step ("poll", this, &DeviceManager::start_poll, poll_deps);
 
-    XCAM_FAILED_STOP (ret = _poll_thread->start(), "start poll failed");
+    ret = graph.run ();
+    {
+        SmartLock lock (_metrics_mutex);
+        graph.get_stats (_startup_stats);
+    }
+    for (uint32_t i = 0; i < _startup_stats.size (); ++i) {
+        XCAM_LOG_INFO (
+            "startup step(%s) at %" PRId64 "us took %" PRId64 "us, ret:%d",
+            _startup_stats[i].name, _startup_stats[i].start,
+            _startup_stats[i].duration, (int)_startup_stats[i].ret);
+    }
+    XCAM_FAILED_STOP (ret, "device manager startup failed");
 
     _is_running = true;
 
@@ -254,6 +263,136 @@ DeviceManager::start ()
     return XCAM_RETURN_NO_ERROR;
 }
 
+XCamReturn
+DeviceManager::start_capture_device ()
+{
+    return _device->start ();
+}
+
+XCamReturn
+DeviceManager::start_event_device ()
+{
+    if (!_subdevice.ptr ())
+        return XCAM_RETURN_NO_ERROR;
+    return _subdevice->start ();
+}
+
+XCamReturn
+DeviceManager::prepare_stats_pool ()
+{
+    return _poll_thread->prepare ();
+}
+
+XCamReturn
+DeviceManager::load_analyzer ()
+{
+    if (!_3a_analyzer.ptr()) {
+        _3a_analyzer = X3aAnalyzerManager::instance()->create_analyzer();
+        XCAM_FAIL_RETURN (WARNING, _3a_analyzer.ptr(), XCAM_RETURN_ERROR_PARAM, "create analyzer failed");
+    }
+    XCAM_FAIL_RETURN (
+        WARNING,
+        _3a_analyzer->prepare_handlers () == XCAM_RETURN_NO_ERROR,
+        XCAM_RETURN_ERROR_PARAM,
+        "prepare analyzer handler failed");
+    _3a_analyzer->set_results_callback (this);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+DeviceManager::start_analyzer ()
+{
+    XCamReturn ret = XCAM_RETURN_NO_ERROR;
+    double framerate = get_framerate ();
+    uint32_t width = 0, height = 0;
+
+    _device->get_size (width, height);
+    ret = _3a_analyzer->init (width, height, framerate);
+    XCAM_FAIL_RETURN (WARNING, ret == XCAM_RETURN_NO_ERROR, ret, "initialize analyzer failed");
+
+    if (_thread_attrs_set[DEVICE_THREAD_ANALYZER])
+        _3a_analyzer->set_thread_attributes (_thread_attrs[DEVICE_THREAD_ANALYZER]);
+    ret = _3a_analyzer->start ();
+    XCAM_FAIL_RETURN (WARNING, ret == XCAM_RETURN_NO_ERROR, ret, "start analyzer failed");
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+DeviceManager::push_warm_state ()
+{
+    _3a_analyzer->push_warm_state ();
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+DeviceManager::start_smart_analyzer ()
+{
+    uint32_t width = 0, height = 0;
+
+    _device->get_size (width, height);
+    // smart analysis is optional, failures don't stop the device
+    if (_smart_analyzer->prepare_handlers () != XCAM_RETURN_NO_ERROR) {
+        XCAM_LOG_INFO ("prepare smart analyzer handler failed");
+    }
+    //_smart_analyzer->set_results_callback (this);
+    if (_smart_analyzer->init (width, height, get_framerate ()) != XCAM_RETURN_NO_ERROR) {
+        XCAM_LOG_INFO ("initialize smart analyzer failed");
+    }
+    if (_thread_attrs_set[DEVICE_THREAD_ANALYZER])
+        _smart_analyzer->set_thread_attributes (_thread_attrs[DEVICE_THREAD_ANALYZER]);
+    if (_smart_analyzer->start () != XCAM_RETURN_NO_ERROR) {
+        XCAM_LOG_INFO ("start smart analyzer failed");
+    }
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+DeviceManager::prepare_processors ()
+{
+    if (!_3a_process_center->has_processors()) {
+        // default processor
+        SmartPtr<ImageProcessor> default_processor = new IspImageProcessor (_isp_controller);
+        XCAM_ASSERT (default_processor.ptr ());
+        _3a_process_center->insert_processor (default_processor);
+    }
+    return _3a_process_center->prepare ();
+}
+
+XCamReturn
+DeviceManager::start_processors ()
+{
+    _3a_process_center->set_image_callback(this);
+    if (_thread_attrs_set[DEVICE_THREAD_IMAGE_HANDLER] &&
+            !_3a_process_center->set_handler_thread_attributes (_thread_attrs[DEVICE_THREAD_IMAGE_HANDLER])) {
+        XCAM_LOG_WARNING ("set image handler thread attributes failed");
+    }
+    return _3a_process_center->start ();
+}
+
+XCamReturn
+DeviceManager::start_poll ()
+{
+    return _poll_thread->start ();
+}
+
+double
+DeviceManager::get_framerate ()
+{
+    uint32_t fps_n = 0, fps_d = 0;
+
+    _device->get_framerate (fps_n, fps_d);
+    if (fps_d)
+        return (double)fps_n / (double)fps_d;
+    return 30.0;
+}
+
+void
+DeviceManager::get_startup_stats (StartupStatsList &stats)
+{
+    SmartLock lock (_metrics_mutex);
+    stats = _startup_stats;
+}
+
 XCamReturn
 DeviceManager::stop ()
 {
@@ -274,11 +413,17 @@ DeviceManager::stop ()
     if (_3a_process_center.ptr())
         _3a_process_center->stop ();
 
-    _subdevice->stop ();
+    if (_subdevice.ptr ())
+        _subdevice->stop ();
     _device->stop ();
 
+    _event_bus->stop ();
+
     _isp_controller.release ();
-    _poll_thread.release ();
+    {
+        SmartLock lock (_metrics_mutex);
+        _poll_thread.release ();
+    }
 
     XCAM_LOG_DEBUG ("Device manager stopped");
     return XCAM_RETURN_NO_ERROR;
@@ -291,6 +436,9 @@ DeviceManager::x3a_stats_ready (const SmartPtr<X3aStats> &stats)
     X3aResultList results;
     XCAM_ASSERT (_3a_analyzer.ptr());
 
+    if (_stats_recorder.ptr ())
+        _stats_recorder->record (stats);
+
     ret = _3a_analyzer->push_3a_stats (stats);
     XCAM_FAIL_RETURN (ERROR,
                       ret == XCAM_RETURN_NO_ERROR,
@@ -331,8 +479,8 @@ XCamReturn
 DeviceManager::poll_buffer_ready (SmartPtr<V4l2BufferProxy> &buf)
 {
     if (_has_3a) {
-        SmartPtr<VideoBuffer> video_buf = buf;
-        if (_3a_process_center->put_buffer (video_buf) == false)
+        // poll thread drops buf after this call, hand it over without extra reference
+        if (_3a_process_center->put_buffer (SmartPtr<VideoBuffer> (std::move (buf))) == false)
             return XCAM_RETURN_ERROR_UNKNOWN;
     }
     return XCAM_RETURN_NO_ERROR;
@@ -341,7 +489,8 @@ DeviceManager::poll_buffer_ready (SmartPtr<V4l2BufferProxy> &buf)
 XCamReturn
 DeviceManager::poll_buffer_failed (int64_t timestamp, const char *msg)
 {
-    post_message (XCAM_MESSAGE_BUF_ERROR, timestamp, msg);
+    XCAM_LOG_WARNING ("poll buffer failed: %s", XCAM_STR (msg));
+    _event_bus->post (XCAM_MESSAGE_BUF_ERROR, timestamp);
     return XCAM_RETURN_NO_ERROR;
 }
 
@@ -366,9 +515,93 @@ void
 DeviceManager::process_buffer_done (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf)
 {
     ImageProcessCallback::process_buffer_done (processor, buf);
+    buf->add_stamp (XCAM_STAMP_HANDLE_BUFFER);
+    record_frame_latency (buf);
     handle_buffer (buf);
 }
 
+DeviceManager::FrameStage *
+DeviceManager::get_frame_stage (const char *name)
+{
+    for (uint32_t i = 0; i < _frame_stages.size (); ++i) {
+        if (!strncmp (_frame_stages[i].name, name, XCAM_STAMP_NAME_SIZE - 1))
+            return &_frame_stages[i];
+    }
+
+    FrameStage stage;
+    strncpy (stage.name, name, XCAM_STAMP_NAME_SIZE - 1);
+    stage.name[XCAM_STAMP_NAME_SIZE - 1] = '\0';
+    _frame_stages.push_back (stage);
+    return &_frame_stages.back ();
+}
+
+void
+DeviceManager::record_frame_latency (const SmartPtr<VideoBuffer> &buf)
+{
+    uint32_t count = 0;
+    const VideoBufferStamp *stamps = buf->get_stamps (count);
+
+    if (count < 2)
+        return;
+
+    SmartLock lock (_latency_mutex);
+    for (uint32_t i = 1; i < count; ++i) {
+        get_frame_stage (XCAM_STR (stamps[i].checkpoint))->histogram.add (
+            stamps[i].time - stamps[i - 1].time);
+    }
+    // last stamp isn't the end of pipeline, total would be short
+    if (buf->get_stamp_overflow ()) {
+        ++_stamp_overflows;
+        return;
+    }
+    get_frame_stage (XCAM_FRAME_STAGE_TOTAL)->histogram.add (
+        stamps[count - 1].time - stamps[0].time);
+}
+
+void
+DeviceManager::get_latency_stats (FrameLatencyStatsList &stats)
+{
+    SmartLock lock (_latency_mutex);
+
+    stats.resize (_frame_stages.size ());
+    for (uint32_t i = 0; i < _frame_stages.size (); ++i) {
+        const LatencyHistogram &histogram = _frame_stages[i].histogram;
+        strncpy (stats[i].stage, _frame_stages[i].name, XCAM_STAMP_NAME_SIZE);
+        stats[i].count = histogram.get_count ();
+        stats[i].p50 = histogram.get_percentile (50.0);
+        stats[i].p99 = histogram.get_percentile (99.0);
+        stats[i].max = histogram.get_max ();
+        stats[i].mean = histogram.get_mean ();
+    }
+}
+
+void
+DeviceManager::get_metrics (PipelineMetrics &metrics)
+{
+    SmartLock lock (_metrics_mutex);
+    if (!_poll_thread.ptr ())
+        return;
+
+    _poll_thread->get_metrics (metrics);
+    if (_has_3a && _3a_analyzer.ptr ())
+        _3a_analyzer->get_metrics (metrics);
+    metrics.add_queue ("device_manager", "event", _event_bus->get_pending (), _event_bus->get_lost ());
+    {
+        SmartLock latency_lock (_latency_mutex);
+        metrics.stamp_overflows = _stamp_overflows;
+    }
+    if (_has_3a)
+        _3a_process_center->get_metrics (metrics);
+}
+
+void
+DeviceManager::reset_latency_stats ()
+{
+    SmartLock lock (_latency_mutex);
+    _frame_stages.clear ();
+    _stamp_overflows = 0;
+}
+
 void
 DeviceManager::process_buffer_failed (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf)
 {
@@ -382,21 +615,36 @@ DeviceManager::process_image_result_done (ImageProcessor *processor, const Smart
 }
 
 void
-DeviceManager::post_message (XCamMessageType type, int64_t timestamp, const char *msg)
+DeviceManager::process_buffer_dropped (
+    ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf, uint64_t dropped)
 {
-    SmartPtr<XCamMessage> new_msg = new XCamMessage (type, timestamp, msg);
-    _msg_queue.push (new_msg);
+    int64_t stream_id = buf->get_stream_id ();
+
+    ImageProcessCallback::process_buffer_dropped (processor, buf, dropped);
+    // drops of a stream coalesce into one pending record, count carries the number
+    _event_bus->post (XCAM_MESSAGE_BUF_DROPPED, buf->get_timestamp (), &stream_id, 1);
 }
 
-XCamReturn
-DeviceManager::message_loop ()
+void
+DeviceManager::handle_events (const XCamEvent *events, uint32_t count)
 {
-    const static int32_t msg_time_out = -1; //wait until wakeup
-    SmartPtr<XCamMessage> msg = _msg_queue.pop (msg_time_out);
-    if (!msg.ptr ())
-        return XCAM_RETURN_ERROR_THREAD;
-    handle_message (msg);
-    return XCAM_RETURN_NO_ERROR;
+    char text[64];
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const XCamEvent &event = events[i];
+
+        text[0] = '\0';
+        if (event.code == XCAM_MESSAGE_BUF_DROPPED)
+            snprintf (
+                text, sizeof (text), "%u frames of stream %" PRId64 " dropped",
+                event.count, event.payload[0]);
+        else if (event.count > 1)
+            snprintf (text, sizeof (text), "repeated %u times", event.count);
+
+        SmartPtr<XCamMessage> msg =
+            make_smart<XCamMessage> ((XCamMessageType)event.code, event.timestamp, text[0] ? text : NULL);
+        handle_message (msg);
+    }
 }
 
 };
@@ -32,19 +32,30 @@
 #include "x3a_statistics_queue.h"
 #include "poll_thread.h"
 #include "stats_callback_interface.h"
+#include "latency_histogram.h"
+#include "pipeline_metrics.h"
+#include "event_bus.h"
+#include "startup_graph.h"
+#include "x3a_stats_recorder.h"
+#include <vector>
+
+#define XCAM_FRAME_STAGE_TOTAL     "total"
 
 namespace XCam {
 
-enum XCamMessageType {
-    XCAM_MESSAGE_BUF_OK = 0,
-    XCAM_MESSAGE_BUF_ERROR,
-    XCAM_MESSAGE_STATS_OK,
-    XCAM_MESSAGE_STATS_ERROR,
-    XCAM_MESSAGE_3A_RESULTS_OK,
-    XCAM_MESSAGE_3A_RESULTS_ERROR,
+// internal threads which can be configured with ThreadAttributes
+enum DeviceThreadType {
+    DEVICE_THREAD_CAPTURE_POLL = 0,
+    DEVICE_THREAD_EVENT_POLL,
+    DEVICE_THREAD_ANALYZER,
+    DEVICE_THREAD_IMAGE_HANDLER,
+    DEVICE_THREAD_TYPE_COUNT,
 };
 
-struct XCamMessage {
+// built from XCamEvent for handle_message
+struct XCamMessage
+    : public RefObj
+{
     int64_t          timestamp;
     XCamMessageType  msg_id;
     char            *msg;
@@ -58,16 +69,29 @@ struct XCamMessage {
     XCAM_DEAD_COPY (XCamMessage);
 };
 
-class MessageThread;
+/*
+ * latency of frames in one pipeline stage, in microseconds.
+ * a stage ends at the buffer checkpoint of the same name and starts at the checkpoint before,
+ * XCAM_FRAME_STAGE_TOTAL is from first checkpoint to handle_buffer.
+ */
+struct FrameLatencyStats {
+    char       stage[XCAM_STAMP_NAME_SIZE];
+    uint64_t   count;
+    int64_t    p50;
+    int64_t    p99;
+    int64_t    max;
+    int64_t    mean;
+};
+
+typedef std::vector<FrameLatencyStats> FrameLatencyStatsList;
 
 class DeviceManager
     : public PollCallback
     , public StatsCallback
     , public AnalyzerCallback
     , public ImageProcessCallback
+    , public EventSubscriber
 {
-    friend class MessageThread;
-
 public:
     DeviceManager();
     virtual ~DeviceManager();
@@ -78,6 +102,24 @@ public:
     bool set_3a_analyzer (SmartPtr<X3aAnalyzer> analyzer);
     bool set_smart_analyzer (SmartPtr<SmartAnalyzer> analyzer);
     bool add_image_processor (SmartPtr<ImageProcessor> processor);
+    // opened recorder gets every 3a stats before analysis, for offline replay
+    bool set_stats_recorder (SmartPtr<X3aStatsRecorder> recorder);
+    // CPU set, scheduling and stack of internal thread @type, applied on start
+    bool set_thread_attributes (DeviceThreadType type, const ThreadAttributes &attrs);
+    // POLL_MODE_EPOLL polls both devices in the capture poll thread
+    bool set_poll_mode (PollMode mode);
+
+    // per-stage latency of frames given to handle_buffer, stages in pipeline order
+    void get_latency_stats (FrameLatencyStatsList &stats);
+    void reset_latency_stats ();
+    // snapshot of capture, 3a, queue, pool and handler counters, empty when stopped
+    void get_metrics (PipelineMetrics &metrics);
+    // per-step timing of last start, steps in the order added
+    void get_startup_stats (StartupStatsList &stats);
+    // subscribe before start, device manager itself is a batched subscriber of all events
+    SmartPtr<EventBus> &get_event_bus () {
+        return _event_bus;
+    }
 
     SmartPtr<V4l2Device>& get_capture_device () {
         return _device;
@@ -100,6 +142,7 @@ public:
     XCamReturn stop ();
 
 protected:
+    // called on event bus thread through handle_events
     virtual void handle_message (const SmartPtr<XCamMessage> &msg) = 0;
     virtual void handle_buffer (const SmartPtr<VideoBuffer> &buf) = 0;
 
@@ -119,10 +162,26 @@ protected:
     virtual void process_buffer_done (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf);
     virtual void process_buffer_failed (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf);
     virtual void process_image_result_done (ImageProcessor *processor, const SmartPtr<X3aResult> &result);
+    virtual void process_buffer_dropped (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf, uint64_t dropped);
+
+    //virtual functions derived from EventSubscriber, adapts events to handle_message
+    virtual void handle_events (const XCamEvent *events, uint32_t count);
 
 private:
-    void post_message (XCamMessageType type, int64_t timestamp, const char *msg);
-    XCamReturn message_loop ();
+    // startup steps, see start
+    XCamReturn start_capture_device ();
+    XCamReturn start_event_device ();
+    XCamReturn prepare_stats_pool ();
+    XCamReturn load_analyzer ();
+    XCamReturn start_analyzer ();
+    XCamReturn start_smart_analyzer ();
+    XCamReturn prepare_processors ();
+    XCamReturn start_processors ();
+    XCamReturn push_warm_state ();
+    XCamReturn start_poll ();
+    double get_framerate ();
+
+    void record_frame_latency (const SmartPtr<VideoBuffer> &buf);
 
     XCAM_DEAD_COPY (DeviceManager);
 
@@ -136,15 +195,34 @@ protected:
     bool                             _has_3a;
     SmartPtr<X3aAnalyzer>            _3a_analyzer;
     SmartPtr<X3aImageProcessCenter>  _3a_process_center;
+    SmartPtr<X3aStatsRecorder>       _stats_recorder;
 
-    /* msg queue */
-    SafeList<XCamMessage>            _msg_queue;
-    SmartPtr<MessageThread>          _msg_thread;
+    /* events */
+    SmartPtr<EventBus>               _event_bus;
 
     bool                             _is_running;
 
     /* smart analysis */
     SmartPtr<SmartAnalyzer>         _smart_analyzer;
+
+    ThreadAttributes                 _thread_attrs[DEVICE_THREAD_TYPE_COUNT];
+    bool                             _thread_attrs_set[DEVICE_THREAD_TYPE_COUNT];
+    PollMode                         _poll_mode;
+
+private:
+    struct FrameStage {
+        char               name[XCAM_STAMP_NAME_SIZE];
+        LatencyHistogram   histogram;
+    };
+
+    FrameStage *get_frame_stage (const char *name);
+
+private:
+    Mutex                            _latency_mutex;
+    Mutex                            _metrics_mutex;  // _poll_thread created and released
+    std::vector<FrameStage>          _frame_stages;
+    uint64_t                         _stamp_overflows;
+    StartupStatsList                 _startup_stats;
 };
 
 };
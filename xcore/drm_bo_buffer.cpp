@@ -20,6 +20,7 @@
 
 #include "drm_bo_buffer.h"
 #include "x3a_stats_pool.h"
+#include <i915_drm.h>
 
 #define OCL_TILING_NONE    0
 
@@ -30,6 +31,7 @@ DrmBoData::DrmBoData (SmartPtr<DrmDisplay> &display, drm_intel_bo *bo)
     , _bo (bo)
     , _buf (NULL)
     , _prime_fd (-1)
+    , _map_count (0)
 {
     XCAM_ASSERT (display.ptr ());
     XCAM_ASSERT (bo);
@@ -37,58 +39,116 @@ DrmBoData::DrmBoData (SmartPtr<DrmDisplay> &display, drm_intel_bo *bo)
 
 DrmBoData::~DrmBoData ()
 {
-    unmap ();
+    release_mapping ();
     if (_bo)
         drm_intel_bo_unreference (_bo);
 }
 
-uint8_t *
-DrmBoData::map ()
+bool
+DrmBoData::is_tiled ()
 {
-    if (_buf) {
-        return _buf;
-    }
-
     uint32_t tiling_mode, swizzle_mode;
 
     drm_intel_bo_get_tiling (_bo, &tiling_mode, &swizzle_mode);
+    return tiling_mode != OCL_TILING_NONE;
+}
 
-    if (tiling_mode != OCL_TILING_NONE) {
-        if (drm_intel_gem_bo_map_gtt (_bo) != 0)
-            return NULL;
-    }
-    else {
-        if (drm_intel_bo_map (_bo, 1) != 0)
-            return NULL;
+uint8_t *
+DrmBoData::map ()
+{
+    SmartLock lock (_map_mutex);
+
+    if (!_buf) {
+        // mapping also moves bo to cpu domain, no sync needed for first map
+        if (is_tiled ()) {
+            if (drm_intel_gem_bo_map_gtt (_bo) != 0)
+                return NULL;
+        } else {
+            if (drm_intel_bo_map (_bo, 1) != 0)
+                return NULL;
+        }
+        _buf = (uint8_t *)_bo->virt;
     }
 
-    _buf = (uint8_t *)_bo->virt;
+    ++_map_count;
     return  _buf;
 }
 
 bool
 DrmBoData::unmap ()
 {
-    if (!_buf || !_bo)
-        return true;
+    SmartLock lock (_map_mutex);
 
-    uint32_t tiling_mode, swizzle_mode;
+    XCAM_FAIL_RETURN (
+        WARNING, _map_count > 0, false,
+        "DrmBoData unmap without map");
+    --_map_count;
+    return true;
+}
 
-    drm_intel_bo_get_tiling (_bo, &tiling_mode, &swizzle_mode);
+bool
+DrmBoData::sync_for_cpu ()
+{
+    SmartLock lock (_map_mutex);
 
-    if (tiling_mode != OCL_TILING_NONE) {
-        if (drm_intel_gem_bo_unmap_gtt (_bo) !=0)
-            return false;
-    }
-    else {
-        if (drm_intel_bo_unmap (_bo) !=0)
-            return false;
+    if (!_buf)
+        return true;
+
+    // set domain waits for rendering and, without LLC (BYT/CHT), invalidates cpu cache
+    if (is_tiled ()) {
+        drm_intel_gem_bo_start_gtt_access (_bo, 1);
+    } else {
+        struct drm_i915_gem_set_domain set_domain;
+
+        xcam_mem_clear (set_domain);
+        set_domain.handle = _bo->handle;
+        set_domain.read_domains = I915_GEM_DOMAIN_CPU;
+        set_domain.write_domain = I915_GEM_DOMAIN_CPU;
+        XCAM_FAIL_RETURN (
+            WARNING,
+            drmIoctl (_display->get_drm_handle (), DRM_IOCTL_I915_GEM_SET_DOMAIN, &set_domain) == 0,
+            false,
+            "DrmBoData set cpu domain failed: %s", strerror (errno));
     }
+    return true;
+}
 
-    _buf = NULL;
+bool
+DrmBoData::sync_for_device ()
+{
+    struct drm_i915_gem_sw_finish sw_finish;
+    SmartLock lock (_map_mutex);
+
+    if (!_buf)
+        return true;
+
+    // flushes cpu cache of cpu domain bo, write-combined gtt writes otherwise
+    xcam_mem_clear (sw_finish);
+    sw_finish.handle = _bo->handle;
+    XCAM_FAIL_RETURN (
+        WARNING,
+        drmIoctl (_display->get_drm_handle (), DRM_IOCTL_I915_GEM_SW_FINISH, &sw_finish) == 0,
+        false,
+        "DrmBoData sw finish failed: %s", strerror (errno));
     return true;
 }
 
+void
+DrmBoData::release_mapping ()
+{
+    if (!_buf || !_bo)
+        return;
+
+    if (is_tiled ()) {
+        if (drm_intel_gem_bo_unmap_gtt (_bo) != 0)
+            XCAM_LOG_WARNING ("DrmBoData unmap gtt failed");
+    } else {
+        if (drm_intel_bo_unmap (_bo) != 0)
+            XCAM_LOG_WARNING ("DrmBoData unmap failed");
+    }
+    _buf = NULL;
+}
+
 int
 DrmBoData::get_fd ()
 {
@@ -125,14 +185,7 @@ DrmBoBuffer::get_bo ()
 SmartPtr<X3aStats>
 DrmBoBuffer::find_3a_stats ()
 {
-    for (VideoBufferList::iterator iter = _attached_bufs.begin ();
-            iter != _attached_bufs.end (); ++iter) {
-        SmartPtr<X3aStats> stats = (*iter).dynamic_cast_ptr<X3aStats> ();
-        if (stats.ptr ())
-            return stats;
-    }
-
-    return NULL;
+    return get_meta<X3aStats> (VIDEO_BUFFER_META_3A_STATS);
 }
 
 DrmBoBufferPool::DrmBoBufferPool (SmartPtr<DrmDisplay> &display)
@@ -43,21 +43,31 @@ public:
         return _bo;
     }
 
-    //derived from BufferData
+    /*
+     * derived from BufferData
+     * mapping is set up by first map and kept until data destroyed,
+     * unmap only drops map count, use sync_for_cpu/sync_for_device for coherency
+     */
     virtual uint8_t *map ();
     virtual bool unmap ();
     virtual int get_fd ();
+    virtual bool sync_for_cpu ();
+    virtual bool sync_for_device ();
 
 protected:
     explicit DrmBoData (SmartPtr<DrmDisplay> &display, drm_intel_bo *bo);
 
 private:
+    bool is_tiled ();
+    void release_mapping ();
     XCAM_DEAD_COPY (DrmBoData);
 private:
     SmartPtr<DrmDisplay>       _display;
     drm_intel_bo              *_bo;
     uint8_t                   *_buf;
     int                       _prime_fd;
+    Mutex                      _map_mutex;
+    uint32_t                   _map_count;
 };
 
 class DrmBoBuffer
@@ -449,6 +449,8 @@ DrmDisplay::convert_to_drm_bo_buf (SmartPtr<DrmDisplay> &self, SmartPtr<VideoBuf
     new_bo_buf = new DrmBoBuffer (buf_in->get_video_info (), bo_data);
     new_bo_buf->set_parent (buf_in);
     new_bo_buf->set_timestamp (buf_in->get_timestamp ());
+    new_bo_buf->set_stream_id (buf_in->get_stream_id ());
+    new_bo_buf->copy_stamps (*buf_in.ptr ());
     return new_bo_buf;
 }
 
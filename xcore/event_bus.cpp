@@ -0,0 +1,232 @@
+/*
+ * event_bus.cpp - typed event bus with preallocated event records
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "event_bus.h"
+#include "xcam_executor.h"
+#include "xcam_trace.h"
+
+namespace XCam {
+
+class EventBusThread
+    : public TaskThread
+{
+public:
+    explicit EventBusThread (EventBus *bus)
+        : TaskThread ("EventBusThread")
+        , _bus (bus)
+    {}
+
+protected:
+    virtual bool loop ();
+
+private:
+    EventBus *_bus;
+};
+
+bool
+EventBusThread::loop ()
+{
+    XCamReturn ret = _bus->dispatch_loop ();
+    if (ret == XCAM_RETURN_NO_ERROR || ret == XCAM_RETURN_BYPASS)
+        return true;
+    return false;
+}
+
+EventBus::EventBus (uint32_t size)
+    : _subscription_count (0)
+    , _batched_mask (0)
+    , _started (false)
+    , _size (size ? size : XCAM_EVENT_BUS_DEFAULT_SIZE)
+    , _head (0)
+    , _count (0)
+    , _lost (0)
+{
+    _ring = new XCamEvent[_size];
+    _batch = new XCamEvent[_size];
+    _filtered = new XCamEvent[_size];
+    _thread = new EventBusThread (this);
+}
+
+EventBus::~EventBus ()
+{
+    stop ();
+    delete [] _ring;
+    delete [] _batch;
+    delete [] _filtered;
+}
+
+bool
+EventBus::subscribe (EventSubscriber *subscriber, uint32_t code_mask, EventDelivery delivery)
+{
+    XCAM_ASSERT (subscriber);
+    XCAM_FAIL_RETURN (
+        WARNING,
+        !_started.load (),
+        false,
+        "event bus subscribe failed, bus already started");
+    XCAM_FAIL_RETURN (
+        WARNING,
+        _subscription_count < XCAM_EVENT_BUS_MAX_SUBSCRIBERS,
+        false,
+        "event bus subscribe failed, at most %d subscribers", XCAM_EVENT_BUS_MAX_SUBSCRIBERS);
+
+    Subscription &subscription = _subscriptions[_subscription_count++];
+    subscription.subscriber = subscriber;
+    subscription.code_mask = code_mask;
+    subscription.delivery = delivery;
+    if (delivery == EVENT_DELIVERY_BATCHED)
+        _batched_mask |= code_mask;
+    return true;
+}
+
+XCamReturn
+EventBus::start ()
+{
+    {
+        SmartLock lock (_mutex);
+        _head = 0;
+        _count = 0;
+    }
+    if (_batched_mask && !_thread->start ()) {
+        XCAM_LOG_WARNING ("event bus thread start failed");
+        return XCAM_RETURN_ERROR_THREAD;
+    }
+    _started.store (true);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+EventBus::stop ()
+{
+    _started.store (false);
+    _thread->stop ();
+
+    SmartLock lock (_mutex);
+    _count = 0;
+    return XCAM_RETURN_NO_ERROR;
+}
+
+void
+EventBus::post (uint32_t code, int64_t timestamp, const int64_t *payload, uint32_t payload_count)
+{
+    XCamEvent event;
+    bool queued = false;
+
+    XCAM_ASSERT (code < 32 && payload_count <= XCAM_EVENT_PAYLOAD_SIZE);
+    if (!_started.load ())
+        return;
+
+    event.code = code;
+    event.count = 1;
+    event.timestamp = timestamp;
+    event.last_timestamp = timestamp;
+    for (uint32_t i = 0; i < XCAM_EVENT_PAYLOAD_SIZE; ++i)
+        event.payload[i] = (payload && i < payload_count) ? payload[i] : 0;
+
+    dispatch (&event, 1, EVENT_DELIVERY_INLINE);
+
+    if (!(_batched_mask & XCAM_EVENT_MASK (code)))
+        return;
+
+    {
+        SmartLock lock (_mutex);
+        // coalesce with a pending record of same code and payload
+        for (uint32_t i = 0; i < _count; ++i) {
+            XCamEvent &pending = _ring[(_head + i) % _size];
+            if (pending.code == code &&
+                    !memcmp (pending.payload, event.payload, sizeof (event.payload))) {
+                ++pending.count;
+                pending.last_timestamp = timestamp;
+                return;
+            }
+        }
+        if (_count < _size) {
+            _ring[(_head + _count) % _size] = event;
+            ++_count;
+            queued = true;
+        }
+    }
+
+    if (queued)
+        _thread->wakeup ();
+    else
+        ++_lost;
+}
+
+uint32_t
+EventBus::get_pending ()
+{
+    SmartLock lock (_mutex);
+    return _count;
+}
+
+XCamReturn
+EventBus::dispatch_loop ()
+{
+    uint32_t count = 0;
+
+    {
+        SmartLock lock (_mutex);
+        for (; count < _count; ++count)
+            _batch[count] = _ring[(_head + count) % _size];
+        _head = (_head + count) % _size;
+        _count = 0;
+    }
+
+    // events of several wakeups taken at once
+    if (!count)
+        return XCAM_RETURN_BYPASS;
+
+    XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_QUEUE, "event_bus_dispatch");
+    dispatch (_batch, count, EVENT_DELIVERY_BATCHED);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+void
+EventBus::dispatch (const XCamEvent *events, uint32_t count, EventDelivery delivery)
+{
+    for (uint32_t i = 0; i < _subscription_count; ++i) {
+        const Subscription &subscription = _subscriptions[i];
+        uint32_t filtered = 0;
+
+        if (subscription.delivery != delivery)
+            continue;
+
+        if (subscription.code_mask == XCAM_EVENT_MASK_ALL) {
+            subscription.subscriber->handle_events (events, count);
+            continue;
+        }
+
+        if (delivery == EVENT_DELIVERY_INLINE) {
+            if (subscription.code_mask & XCAM_EVENT_MASK (events[0].code))
+                subscription.subscriber->handle_events (events, count);
+            continue;
+        }
+
+        for (uint32_t j = 0; j < count; ++j) {
+            if (subscription.code_mask & XCAM_EVENT_MASK (events[j].code))
+                _filtered[filtered++] = events[j];
+        }
+        if (filtered)
+            subscription.subscriber->handle_events (_filtered, filtered);
+    }
+}
+
+};
@@ -0,0 +1,145 @@
+/*
+ * event_bus.h - typed event bus with preallocated event records
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_EVENT_BUS_H
+#define XCAM_EVENT_BUS_H
+
+#include "xcam_utils.h"
+#include "xcam_mutex.h"
+#include "smartptr.h"
+#include <atomic>
+
+#define XCAM_EVENT_BUS_DEFAULT_SIZE      64
+#define XCAM_EVENT_BUS_MAX_SUBSCRIBERS   8
+#define XCAM_EVENT_PAYLOAD_SIZE          4
+
+#define XCAM_EVENT_MASK(code)  (1u << (code))
+#define XCAM_EVENT_MASK_ALL    0xFFFFFFFFu
+
+namespace XCam {
+
+// event codes, at most 32 so subscribers can filter by XCAM_EVENT_MASK
+enum XCamMessageType {
+    XCAM_MESSAGE_BUF_OK = 0,
+    XCAM_MESSAGE_BUF_ERROR,
+    XCAM_MESSAGE_STATS_OK,
+    XCAM_MESSAGE_STATS_ERROR,
+    XCAM_MESSAGE_3A_RESULTS_OK,
+    XCAM_MESSAGE_3A_RESULTS_ERROR,
+    XCAM_MESSAGE_BUF_DROPPED,      // payload[0] stream id, count frames dropped since last dispatch
+};
+
+/*
+ * XCamEvent, one record of the bus.
+ * repeated events, same code and payload, posted before dispatch
+ * are coalesced into one record, @count occurrences from @timestamp to @last_timestamp.
+ */
+struct XCamEvent {
+    uint32_t   code;
+    uint32_t   count;
+    int64_t    timestamp;
+    int64_t    last_timestamp;
+    int64_t    payload[XCAM_EVENT_PAYLOAD_SIZE];
+};
+
+enum EventDelivery {
+    EVENT_DELIVERY_INLINE = 0,   // called in posting thread, events never coalesced
+    EVENT_DELIVERY_BATCHED,      // called on bus thread with all coalesced events pending
+};
+
+class EventSubscriber {
+public:
+    explicit EventSubscriber () {}
+    virtual ~EventSubscriber () {}
+
+    // @events valid during the call only
+    virtual void handle_events (const XCamEvent *events, uint32_t count) = 0;
+
+private:
+    XCAM_DEAD_COPY (EventSubscriber);
+};
+
+class EventBusThread;
+
+/*
+ * EventBus, post () copies the event into a preallocated ring,
+ * no allocation on post or dispatch. One bus thread wakeup dispatches
+ * all pending events as a batch to batched subscribers.
+ * When the ring is full new events are counted as lost.
+ */
+class EventBus {
+    friend class EventBusThread;
+
+public:
+    explicit EventBus (uint32_t size = XCAM_EVENT_BUS_DEFAULT_SIZE);
+    ~EventBus ();
+
+    // before start, @code_mask of XCAM_EVENT_MASK bits
+    bool subscribe (EventSubscriber *subscriber, uint32_t code_mask, EventDelivery delivery);
+
+    XCamReturn start ();
+    // pending events are discarded
+    XCamReturn stop ();
+
+    // @payload_count int64 values, up to XCAM_EVENT_PAYLOAD_SIZE
+    void post (
+        uint32_t code, int64_t timestamp,
+        const int64_t *payload = NULL, uint32_t payload_count = 0);
+
+    uint32_t get_pending ();
+    uint64_t get_lost () const {
+        return _lost.load ();
+    }
+
+private:
+    XCamReturn dispatch_loop ();
+    void dispatch (const XCamEvent *events, uint32_t count, EventDelivery delivery);
+
+    XCAM_DEAD_COPY (EventBus);
+
+private:
+    struct Subscription {
+        EventSubscriber   *subscriber;
+        uint32_t           code_mask;
+        EventDelivery      delivery;
+    };
+
+    Subscription                  _subscriptions[XCAM_EVENT_BUS_MAX_SUBSCRIBERS];
+    uint32_t                      _subscription_count;
+    uint32_t                      _batched_mask;
+    std::atomic<bool>             _started;
+
+    // ring guarded by _mutex, held only to copy records in and out
+    Mutex                         _mutex;
+    XCamEvent                    *_ring;
+    uint32_t                      _size;
+    uint32_t                      _head;
+    uint32_t                      _count;
+    std::atomic<uint64_t>         _lost;
+
+    // only touched by bus thread
+    XCamEvent                    *_batch;
+    XCamEvent                    *_filtered;
+    SmartPtr<EventBusThread>      _thread;
+};
+
+};
+
+#endif //XCAM_EVENT_BUS_H
@@ -0,0 +1,435 @@
+/*
+ * frame_recorder.cpp - asynchronous frame recorder
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "frame_recorder.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <inttypes.h>
+
+namespace XCam {
+
+class RecordFrame
+    : public RefObj
+{
+public:
+    explicit RecordFrame (const SmartPtr<VideoBuffer> &buf)
+        : _buf (buf)
+        , _copy (NULL)
+    {
+        const VideoBufferInfo &info = buf->get_video_info ();
+
+        xcam_mem_clear (header);
+        header.timestamp = buf->get_timestamp ();
+        header.info.format = info.format;
+        header.info.color_bits = info.color_bits;
+        header.info.width = info.width;
+        header.info.height = info.height;
+        header.info.aligned_width = info.aligned_width;
+        header.info.aligned_height = info.aligned_height;
+        header.info.size = info.size;
+        header.info.components = info.components;
+        for (uint32_t i = 0; i < XCAM_VIDEO_MAX_COMPONENTS; ++i) {
+            header.info.strides[i] = info.strides[i];
+            header.info.offsets[i] = info.offsets[i];
+        }
+        init_header ();
+    }
+
+    explicit RecordFrame (const XCamVideoBuffer *buf)
+        : _copy (NULL)
+    {
+        xcam_mem_clear (header);
+        header.timestamp = buf->timestamp;
+        header.info = buf->info;
+        init_header ();
+        _copy = (uint8_t *) xcam_malloc (header.data_size);
+        if (_copy)
+            memcpy (_copy, buf->data, header.data_size);
+    }
+
+    ~RecordFrame () {
+        if (_copy)
+            xcam_free (_copy);
+    }
+
+    // drop the buffer reference, frame keeps own copy
+    bool copy_buffer () {
+        uint8_t *data = NULL;
+
+        XCAM_ASSERT (_buf.ptr () && !_copy);
+        _copy = (uint8_t *) xcam_malloc (header.data_size);
+        data = _buf->map ();
+        if (!_copy || !data) {
+            _buf->unmap ();
+            return false;
+        }
+        _buf->sync_for_cpu ();
+        memcpy (_copy, data, header.data_size);
+        _buf->unmap ();
+        _buf.release ();
+        return true;
+    }
+
+    const uint8_t *map () {
+        uint8_t *data = NULL;
+
+        if (!_buf.ptr ())
+            return _copy;
+        data = _buf->map ();
+        if (data)
+            _buf->sync_for_cpu ();
+        return data;
+    }
+
+    void unmap () {
+        if (_buf.ptr ())
+            _buf->unmap ();
+    }
+
+    RecordFrameHeader    header;
+
+private:
+    void init_header () {
+        header.magic = XCAM_RECORD_FRAME_MAGIC;
+        header.header_size = sizeof (RecordFrameHeader);
+        header.data_size = header.info.size;
+    }
+
+    XCAM_DEAD_COPY (RecordFrame);
+
+private:
+    SmartPtr<VideoBuffer>  _buf;
+    uint8_t               *_copy;
+};
+
+FrameRecorder::FrameRecorder (const char *path)
+    : _path (NULL)
+    , _fd (-1)
+    , _direct_io (true)
+    , _copy_buffers (false)
+    , _frame_header (true)
+    , _queue_size (XCAM_RECORD_DEFAULT_QUEUE_SIZE)
+    , _batch_size (XCAM_RECORD_DEFAULT_BATCH_SIZE)
+    , _started (false)
+    , _batch (NULL)
+    , _batch_used (0)
+    , _file_offset (0)
+    , _data_size (0)
+    , _write_failed (false)
+    , _recorded (0)
+    , _bytes (0)
+{
+    XCAM_ASSERT (path);
+    _path = strdup (path);
+}
+
+FrameRecorder::~FrameRecorder ()
+{
+    stop ();
+    if (_path)
+        xcam_free (_path);
+}
+
+bool
+FrameRecorder::set_queue_size (uint32_t size)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !_started && !_writer.ptr () && size, false,
+        "recorder(%s) set queue size(%d) failed, only before first start", _path, size);
+    _queue_size = size;
+    return true;
+}
+
+bool
+FrameRecorder::set_batch_size (uint32_t size)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !_started && size, false,
+        "recorder(%s) set batch size(%d) failed", _path, size);
+    _batch_size = XCAM_ALIGN_UP (size, XCAM_RECORD_ALIGNMENT);
+    return true;
+}
+
+bool
+FrameRecorder::set_direct_io (bool enable)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !_started, false,
+        "recorder(%s) set direct io failed since started", _path);
+    _direct_io = enable;
+    return true;
+}
+
+bool
+FrameRecorder::set_copy_buffers (bool copy)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !_started, false,
+        "recorder(%s) set copy buffers failed since started", _path);
+    _copy_buffers = copy;
+    return true;
+}
+
+bool
+FrameRecorder::set_frame_header (bool enable)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !_started, false,
+        "recorder(%s) set frame header failed since started", _path);
+    _frame_header = enable;
+    return true;
+}
+
+XCamReturn
+FrameRecorder::start ()
+{
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+    if (_started)
+        return XCAM_RETURN_NO_ERROR;
+
+    _fd = -1;
+    if (_direct_io) {
+        _fd = ::open (_path, flags | O_DIRECT, 0644);
+        if (_fd == -1)
+            XCAM_LOG_WARNING ("recorder(%s) open with O_DIRECT failed(%s), fall back to buffered io", _path, strerror (errno));
+    }
+    if (_fd == -1)
+        _fd = ::open (_path, flags, 0644);
+    XCAM_FAIL_RETURN (
+        ERROR, _fd != -1, XCAM_RETURN_ERROR_FILE,
+        "recorder open file(%s) failed: %s", _path, strerror (errno));
+
+    if (posix_memalign ((void **)&_batch, XCAM_RECORD_ALIGNMENT, _batch_size) != 0) {
+        XCAM_LOG_ERROR ("recorder(%s) allocate batch of %d bytes failed", _path, _batch_size);
+        ::close (_fd);
+        _fd = -1;
+        _batch = NULL;
+        return XCAM_RETURN_ERROR_MEM;
+    }
+    _batch_used = 0;
+    _file_offset = 0;
+    _data_size = 0;
+    _write_failed = false;
+    _recorded = 0;
+    _bytes = 0;
+
+    // writer lives until destruction, record () may still hold it after stop ()
+    if (!_writer.ptr ())
+        _writer = new RecordWriter<RecordFrame> ("recorder", _path, _queue_size, this);
+    _started = true;
+    if (!_writer->start ()) {
+        XCAM_LOG_ERROR ("recorder(%s) start thread failed", _path);
+        stop ();
+        return XCAM_RETURN_ERROR_THREAD;
+    }
+
+    XCAM_LOG_INFO ("recorder(%s) started, queue:%d, batch:%d bytes", _path, _queue_size, _batch_size);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+FrameRecorder::stop ()
+{
+    if (!_started)
+        return XCAM_RETURN_NO_ERROR;
+
+    _started = false;
+    _writer->stop ();
+    flush (true);
+
+    ::close (_fd);
+    _fd = -1;
+    free (_batch);
+    _batch = NULL;
+
+    XCAM_LOG_INFO (
+        "recorder(%s) stopped, recorded %" PRIu64 " frames(%" PRIu64 " bytes), dropped %" PRIu64 " frames",
+        _path, _recorded.load (), _bytes.load (), _writer->get_dropped ());
+    return XCAM_RETURN_NO_ERROR;
+}
+
+bool
+FrameRecorder::record (const SmartPtr<VideoBuffer> &buf)
+{
+    SmartPtr<RecordFrame> frame;
+
+    XCAM_ASSERT (buf.ptr ());
+    if (!_started)
+        return false;
+
+    // no copy for a frame dropped anyway
+    if (_writer->is_full ()) {
+        _writer->count_dropped ();
+        return false;
+    }
+
+    frame = new RecordFrame (buf);
+    if (_copy_buffers && !frame->copy_buffer ()) {
+        XCAM_LOG_WARNING ("recorder(%s) copy buffer failed", _path);
+        _writer->count_dropped ();
+        return false;
+    }
+    return _writer->push (std::move (frame));
+}
+
+bool
+FrameRecorder::record (const XCamVideoBuffer *buf)
+{
+    SmartPtr<RecordFrame> frame;
+
+    XCAM_ASSERT (buf);
+    if (!_started)
+        return false;
+
+    if (_writer->is_full ()) {
+        _writer->count_dropped ();
+        return false;
+    }
+
+    frame = new RecordFrame (buf);
+    if (!frame->map ()) {
+        XCAM_LOG_WARNING ("recorder(%s) copy buffer failed", _path);
+        _writer->count_dropped ();
+        return false;
+    }
+    return _writer->push (std::move (frame));
+}
+
+void
+FrameRecorder::get_stats (FrameRecorderStats &stats)
+{
+    stats.recorded = _recorded.load ();
+    stats.dropped = _writer.ptr () ? _writer->get_dropped () : 0;
+    stats.bytes = _bytes.load ();
+}
+
+// idle, push out whole blocks gathered so far
+void
+FrameRecorder::writer_idle ()
+{
+    if (_started)
+        flush (false);
+}
+
+bool
+FrameRecorder::write_record (const SmartPtr<RecordFrame> &frame)
+{
+    const uint8_t *data = NULL;
+    uint64_t size = 0;
+    bool ret = false;
+
+    if (_write_failed) {
+        _writer->count_dropped ();
+        return false;
+    }
+
+    data = frame->map ();
+    if (data) {
+        ret = true;
+        if (_frame_header) {
+            ret = append ((const uint8_t *)&frame->header, sizeof (frame->header));
+            size += sizeof (frame->header);
+        }
+        ret = ret && append (data, frame->header.data_size);
+        size += frame->header.data_size;
+    }
+    frame->unmap ();
+
+    if (!ret) {
+        _writer->count_dropped ();
+        return false;
+    }
+    ++_recorded;
+    _bytes += size;
+    return true;
+}
+
+bool
+FrameRecorder::append (const uint8_t *data, uint32_t size)
+{
+    while (size) {
+        uint32_t count = XCAM_MIN (size, _batch_size - _batch_used);
+        memcpy (_batch + _batch_used, data, count);
+        _batch_used += count;
+        _data_size += count;
+        data += count;
+        size -= count;
+
+        if (_batch_used == _batch_size && !write_batch (_batch_size))
+            return false;
+    }
+    return true;
+}
+
+// @size must be multiple of XCAM_RECORD_ALIGNMENT, bytes after it move to batch front
+bool
+FrameRecorder::write_batch (uint32_t size)
+{
+    uint32_t written = 0;
+
+    XCAM_ASSERT (size % XCAM_RECORD_ALIGNMENT == 0 && size <= _batch_used + XCAM_RECORD_ALIGNMENT);
+    while (written < size) {
+        ssize_t ret = pwrite (_fd, _batch + written, size - written, _file_offset + written);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0) {
+            XCAM_LOG_ERROR ("recorder(%s) write failed: %s", _path, strerror (errno));
+            _write_failed = true;
+            return false;
+        }
+        written += ret;
+    }
+
+    _file_offset += size;
+    if (_batch_used > size)
+        memmove (_batch, _batch + size, _batch_used - size);
+    _batch_used = _batch_used > size ? _batch_used - size : 0;
+    return true;
+}
+
+/*
+ * not final, writes whole aligned blocks only;
+ * final, pads last block then truncates file to real data size
+ */
+bool
+FrameRecorder::flush (bool final)
+{
+    uint32_t size = XCAM_ALIGN_DOWN (_batch_used, XCAM_RECORD_ALIGNMENT);
+
+    if (_write_failed)
+        return false;
+
+    if (final && _batch_used > size) {
+        size = XCAM_ALIGN_UP (_batch_used, XCAM_RECORD_ALIGNMENT);
+        memset (_batch + _batch_used, 0, size - _batch_used);
+    }
+    if (size && !write_batch (size))
+        return false;
+
+    if (final && ftruncate (_fd, _data_size) != 0) {
+        XCAM_LOG_ERROR ("recorder(%s) truncate failed: %s", _path, strerror (errno));
+        return false;
+    }
+    return true;
+}
+
+};
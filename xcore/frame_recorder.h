@@ -0,0 +1,130 @@
+/*
+ * frame_recorder.h - asynchronous frame recorder
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_FRAME_RECORDER_H
+#define XCAM_FRAME_RECORDER_H
+
+#include "xcam_utils.h"
+#include "video_buffer.h"
+#include "record_writer.h"
+#include <base/xcam_3a_stats.h>
+#include <linux/videodev2.h>
+#include <atomic>
+
+#define XCAM_RECORD_FRAME_MAGIC          v4l2_fourcc ('X', 'C', 'F', 'R')
+#define XCAM_RECORD_DEFAULT_QUEUE_SIZE   8
+#define XCAM_RECORD_DEFAULT_BATCH_SIZE   (4 * 1024 * 1024)
+#define XCAM_RECORD_ALIGNMENT            4096
+
+namespace XCam {
+
+/*
+ * recording with frame header is a sequence of frames,
+ * each RecordFrameHeader followed by data_size bytes laid out as info
+ */
+struct RecordFrameHeader {
+    uint32_t              magic;        // XCAM_RECORD_FRAME_MAGIC
+    uint32_t              header_size;  // sizeof (RecordFrameHeader)
+    int64_t               timestamp;
+    XCamVideoBufferInfo   info;
+    uint32_t              data_size;
+    uint32_t              reserved;
+};
+
+struct FrameRecorderStats {
+    uint64_t   recorded;
+    uint64_t   dropped;     // queue full or write failed
+    uint64_t   bytes;
+};
+
+class RecordFrame;
+
+/*
+ * FrameRecorder, record () queues frames without blocking,
+ * a dedicated thread packs them into aligned batches written at once,
+ * with O_DIRECT when the file system supports it.
+ * Frames are dropped and counted when the disk can't keep up.
+ */
+class FrameRecorder
+    : public RecordSink<RecordFrame>
+{
+public:
+    explicit FrameRecorder (const char *path);
+    ~FrameRecorder ();
+
+    // before first start
+    bool set_queue_size (uint32_t size);
+    // before start
+    bool set_batch_size (uint32_t size);
+    bool set_direct_io (bool enable);
+    // copy frames on record () instead of holding buffers until written
+    bool set_copy_buffers (bool copy);
+    // false writes raw frames only
+    bool set_frame_header (bool enable);
+
+    XCamReturn start ();
+    // writes frames still queued, then closes file,
+    // safe against record () from other threads
+    XCamReturn stop ();
+
+    // false if frame dropped
+    bool record (const SmartPtr<VideoBuffer> &buf);
+    // always copied
+    bool record (const XCamVideoBuffer *buf);
+
+    void get_stats (FrameRecorderStats &stats);
+
+private:
+    //virtual functions derived from RecordSink
+    virtual bool write_record (const SmartPtr<RecordFrame> &frame);
+    virtual void writer_idle ();
+
+    bool append (const uint8_t *data, uint32_t size);
+    bool write_batch (uint32_t size);
+    bool flush (bool final);
+
+    XCAM_DEAD_COPY (FrameRecorder);
+
+private:
+    char                         *_path;
+    int                           _fd;
+    bool                          _direct_io;
+    bool                          _copy_buffers;
+    bool                          _frame_header;
+    uint32_t                      _queue_size;
+    uint32_t                      _batch_size;
+    std::atomic<bool>             _started;
+
+    SmartPtr<RecordWriter<RecordFrame> >  _writer;
+
+    // only touched by writing thread
+    uint8_t                      *_batch;
+    uint32_t                      _batch_used;
+    uint64_t                      _file_offset;
+    uint64_t                      _data_size;
+    bool                          _write_failed;
+
+    std::atomic<uint64_t>         _recorded;
+    std::atomic<uint64_t>         _bytes;
+};
+
+};
+
+#endif //XCAM_FRAME_RECORDER_H
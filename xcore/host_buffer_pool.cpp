@@ -0,0 +1,212 @@
+/*
+ * host_buffer_pool.cpp - host memory buffer pool
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "host_buffer_pool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+
+namespace XCam {
+
+static int
+xcam_memfd_create (const char *name, uint32_t flags)
+{
+#ifdef __NR_memfd_create
+    return syscall (__NR_memfd_create, name, flags);
+#else
+    XCAM_UNUSED (name);
+    XCAM_UNUSED (flags);
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+ * map @size bytes of @fd (anonymous if fd < 0) on @align boundary,
+ * mmap already returns page aligned address, for larger alignment
+ * reserve extra address space and trim both ends.
+ */
+static uint8_t *
+xcam_host_mmap (int fd, uint32_t size, uint32_t align)
+{
+    int flags = (fd < 0 ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED);
+    uint8_t *reserved = NULL;
+    uint8_t *buf = NULL;
+    uintptr_t aligned = 0;
+
+    if (align <= HOST_BUFFER_ALIGN_PAGE) {
+        buf = (uint8_t *) mmap (NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+        return (buf == MAP_FAILED ? NULL : buf);
+    }
+
+    reserved = (uint8_t *) mmap (
+        NULL, size + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED)
+        return NULL;
+
+    aligned = XCAM_ALIGN_UP ((uintptr_t)reserved, (uintptr_t)align);
+    if (aligned > (uintptr_t)reserved)
+        munmap (reserved, aligned - (uintptr_t)reserved);
+    if ((uintptr_t)reserved + align > aligned)
+        munmap ((uint8_t *)aligned + size, (uintptr_t)reserved + align - aligned);
+
+    buf = (uint8_t *) mmap ((void *)aligned, size, PROT_READ | PROT_WRITE, flags | MAP_FIXED, fd, 0);
+    if (buf == MAP_FAILED) {
+        munmap ((void *)aligned, size);
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    madvise (buf, size, MADV_HUGEPAGE);
+#endif
+    return buf;
+}
+
+HostBufferData::HostBufferData (int fd, uint8_t *buf, uint32_t size)
+    : _fd (fd)
+    , _buf (buf)
+    , _size (size)
+{
+    XCAM_ASSERT (buf);
+}
+
+HostBufferData::~HostBufferData ()
+{
+    if (_buf)
+        munmap (_buf, _size);
+    if (_fd >= 0)
+        close (_fd);
+}
+
+uint8_t *
+HostBufferData::map ()
+{
+    return _buf;
+}
+
+bool
+HostBufferData::unmap ()
+{
+    return true;
+}
+
+int
+HostBufferData::get_fd ()
+{
+    return _fd;
+}
+
+HostBufferPool::HostBufferPool (HostBufferAlign alignment)
+    : _alignment (alignment)
+    , _seq (0)
+{
+}
+
+bool
+HostBufferPool::fixate_video_info (VideoBufferInfo &info)
+{
+    VideoBufferInfo new_info;
+    uint32_t aligned_width =
+        info.aligned_width ? info.aligned_width : XCAM_ALIGN_UP (info.width, 4);
+    uint32_t max_width = aligned_width + XCAM_HOST_BUFFER_STRIDE_ALIGN;
+
+    if (info.strides[0] % XCAM_HOST_BUFFER_STRIDE_ALIGN == 0)
+        return true;
+
+    // widen aligned_width by the same step as VideoBufferInfo::init until row stride is aligned
+    for (; aligned_width < max_width; aligned_width += 4) {
+        if (!new_info.init (info.format, info.width, info.height, aligned_width, info.aligned_height))
+            return true;
+        if (new_info.strides[0] % XCAM_HOST_BUFFER_STRIDE_ALIGN == 0)
+            break;
+    }
+    if (aligned_width >= max_width) {
+        XCAM_LOG_WARNING (
+            "HostBufferPool can't align stride(%d) of format:%s",
+            info.strides[0], xcam_fourcc_to_string (info.format));
+        return true;
+    }
+
+    if (info.size > new_info.size)
+        new_info.size = info.size;
+    info = new_info;
+    return true;
+}
+
+SmartPtr<BufferData>
+HostBufferPool::allocate_data (const VideoBufferInfo &buffer_info)
+{
+    char name[32];
+    uint32_t size = XCAM_ALIGN_UP (buffer_info.size, (uint32_t)HOST_BUFFER_ALIGN_PAGE);
+    uint8_t *buf = NULL;
+    int fd = -1;
+
+    snprintf (name, sizeof (name), "xcam_host_buf_%d", _seq++);
+
+    if (_alignment == HOST_BUFFER_ALIGN_HUGE_PAGE) {
+        size = XCAM_ALIGN_UP (buffer_info.size, (uint32_t)HOST_BUFFER_ALIGN_HUGE_PAGE);
+        fd = xcam_memfd_create (name, MFD_CLOEXEC | MFD_HUGETLB);
+        if (fd >= 0 && (ftruncate (fd, size) < 0 ||
+                        !(buf = xcam_host_mmap (fd, size, HOST_BUFFER_ALIGN_PAGE)))) {
+            close (fd);
+            fd = -1;
+        }
+        if (fd < 0) {
+            XCAM_LOG_DEBUG ("HostBufferPool hugetlb pages not available, use normal pages");
+        }
+    }
+
+    if (!buf) {
+        fd = xcam_memfd_create (name, MFD_CLOEXEC);
+        if (fd < 0 && errno == ENOSYS) {
+            XCAM_LOG_WARNING ("HostBufferPool memfd not supported, buffers can't be shared by fd");
+        } else {
+            XCAM_FAIL_RETURN (
+                ERROR, fd >= 0, NULL,
+                "HostBufferPool memfd_create failed, %s", strerror (errno));
+
+            if (ftruncate (fd, size) < 0) {
+                XCAM_LOG_ERROR ("HostBufferPool resize memfd to %d failed, %s", size, strerror (errno));
+                close (fd);
+                return NULL;
+            }
+        }
+
+        buf = xcam_host_mmap (fd, size, _alignment);
+        if (!buf) {
+            XCAM_LOG_ERROR ("HostBufferPool map buffer(size:%d) failed, %s", size, strerror (errno));
+            if (fd >= 0)
+                close (fd);
+            return NULL;
+        }
+    }
+
+    return new HostBufferData (fd, buf, size);
+}
+
+};
@@ -0,0 +1,97 @@
+/*
+ * host_buffer_pool.h - host memory buffer pool
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_HOST_BUFFER_POOL_H
+#define XCAM_HOST_BUFFER_POOL_H
+
+#include "xcam_utils.h"
+#include "buffer_pool.h"
+
+// row strides of host buffers are aligned to cache line
+#define XCAM_HOST_BUFFER_STRIDE_ALIGN 64
+
+namespace XCam {
+
+enum HostBufferAlign {
+    HOST_BUFFER_ALIGN_CACHE_LINE = 64,
+    HOST_BUFFER_ALIGN_PAGE       = 4096,
+    HOST_BUFFER_ALIGN_HUGE_PAGE  = 2 * 1024 * 1024,
+};
+
+class HostBufferData
+    : public BufferData
+{
+    friend class HostBufferPool;
+
+public:
+    ~HostBufferData ();
+
+    uint32_t get_size () const {
+        return _size;
+    }
+
+    //derived from BufferData
+    virtual uint8_t *map ();
+    virtual bool unmap ();
+    virtual int get_fd ();
+
+protected:
+    explicit HostBufferData (int fd, uint8_t *buf, uint32_t size);
+
+private:
+    XCAM_DEAD_COPY (HostBufferData);
+
+private:
+    int          _fd;
+    uint8_t     *_buf;
+    uint32_t     _size;
+};
+
+/*
+ * HostBufferPool, frames in host memory without any DRM/CL device.
+ * Each frame is a memfd mapping, get_fd () can be passed to other processes;
+ * HOST_BUFFER_ALIGN_HUGE_PAGE tries hugetlb pages first, then falls back
+ * to normal pages on a 2M aligned address.
+ */
+class HostBufferPool
+    : public BufferPool
+{
+public:
+    explicit HostBufferPool (HostBufferAlign alignment = HOST_BUFFER_ALIGN_CACHE_LINE);
+
+    HostBufferAlign get_alignment () const {
+        return _alignment;
+    }
+
+protected:
+    virtual bool fixate_video_info (VideoBufferInfo &info);
+    virtual SmartPtr<BufferData> allocate_data (const VideoBufferInfo &buffer_info);
+
+private:
+    XCAM_DEAD_COPY (HostBufferPool);
+
+private:
+    HostBufferAlign    _alignment;
+    uint32_t           _seq;
+};
+
+};
+
+#endif //XCAM_HOST_BUFFER_POOL_H
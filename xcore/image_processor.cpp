@@ -19,7 +19,12 @@
  */
 
 #include "image_processor.h"
-#include "xcam_thread.h"
+#include "xcam_executor.h"
+#include "xcam_trace.h"
+#include <inttypes.h>
+
+// producer blocked by BACKPRESSURE_BLOCK re-checks queue space at least this often
+#define XCAM_PROCESSOR_SPACE_WAIT_TIME  10000
 
 namespace XCam {
 
@@ -63,12 +68,28 @@ ImageProcessCallback::process_image_result_done (ImageProcessor *processor, cons
         XCAM_TIMESTAMP_ARGS (ts));
 }
 
+void
+ImageProcessCallback::process_buffer_dropped (
+    ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf, uint64_t dropped)
+{
+    XCAM_ASSERT (buf.ptr() && processor);
+
+    int64_t ts = buf->get_timestamp();
+    XCAM_UNUSED (ts);
+    XCAM_UNUSED (dropped);
+    XCAM_LOG_DEBUG (
+        "processor(%s) dropped buffer(" XCAM_TIMESTAMP_FORMAT "), %" PRIu64 " dropped in total",
+        XCAM_STR(processor->get_name()),
+        XCAM_TIMESTAMP_ARGS (ts),
+        dropped);
+}
+
 class ImageProcessorThread
-    : public Thread
+    : public TaskThread
 {
 public:
     ImageProcessorThread (ImageProcessor *processor)
-        : Thread ("image_processor")
+        : TaskThread ("image_processor")
         , _processor (processor)
     {}
     ~ImageProcessorThread () {}
@@ -82,31 +103,40 @@ private:
 bool ImageProcessorThread::loop ()
 {
     XCamReturn ret = _processor->buffer_process_loop ();
-    if (ret == XCAM_RETURN_NO_ERROR || ret == XCAM_RETURN_ERROR_TIMEOUT)
+    if (ret == XCAM_RETURN_NO_ERROR || ret == XCAM_RETURN_ERROR_TIMEOUT || ret == XCAM_RETURN_BYPASS)
         return true;
     return false;
 }
 
 class X3aResultsProcessThread
-    : public Thread
+    : public TaskThread
 {
     typedef SafeList<X3aResult> ResultQueue;
 public:
     X3aResultsProcessThread (ImageProcessor *processor)
-        : Thread ("x3a_results_process_thread")
+        : TaskThread ("x3a_results_process_thread")
         , _processor (processor)
     {}
     ~X3aResultsProcessThread () {}
 
     XCamReturn push_result (SmartPtr<X3aResult> &result) {
         _queue.push (result);
+        wakeup ();
         return XCAM_RETURN_NO_ERROR;
     }
 
+    void triger_start () {
+        _queue.resume_pop ();
+    }
+
     void triger_stop () {
         _queue.pause_pop ();
     }
 
+    uint32_t get_queue_depth () {
+        return _queue.size ();
+    }
+
     virtual bool loop ();
 
 private:
@@ -119,9 +149,10 @@ bool X3aResultsProcessThread::loop ()
     X3aResultList result_list;
     SmartPtr<X3aResult> result;
 
-    result = _queue.pop (-1);
+    // results pushed together were taken by previous loop
+    result = _queue.pop (0);
     if (!result.ptr ())
-        return false;
+        return true;
 
     result_list.push_back (result);
     while ((result = _queue.pop (0)).ptr ()) {
@@ -138,12 +169,18 @@ bool X3aResultsProcessThread::loop ()
 ImageProcessor::ImageProcessor (const char* name)
     : _name (NULL)
     , _callback (NULL)
+    , _queue_capacity (XCAM_PROCESSOR_DEFAULT_QUEUE_SIZE)
+    , _backpressure (BACKPRESSURE_DROP_OLDEST)
+    , _accepting (false)
+    , _dropped (0)
+    , _space_waiters (0)
 {
     if (name)
         _name = strdup (name);
 
     _processor_thread = new ImageProcessorThread (this);
     _results_thread = new X3aResultsProcessThread (this);
+    _video_buf_queue = new VideoBufQueue (_queue_capacity);
 }
 
 ImageProcessor::~ImageProcessor ()
@@ -155,25 +192,53 @@ ImageProcessor::~ImageProcessor ()
 bool
 ImageProcessor::set_callback (ImageProcessCallback *callback)
 {
-    XCAM_ASSERT (!_callback);
+    // set again by X3aImageProcessCenter::start on restart
+    XCAM_ASSERT (!_callback || _callback == callback);
     _callback = callback;
     return true;
 }
 
+bool
+ImageProcessor::set_input_queue (uint32_t capacity, BackpressurePolicy policy)
+{
+    XCAM_FAIL_RETURN (
+        WARNING,
+        !_accepting.load (),
+        false,
+        "processor(%s) set input queue failed, already started", XCAM_STR (_name));
+    XCAM_FAIL_RETURN (
+        WARNING,
+        capacity > 0,
+        false,
+        "processor(%s) set input queue failed, capacity can't be 0", XCAM_STR (_name));
+
+    // ring queue rounds up to power of 2, capacity is enforced by is_input_full
+    if (xcam_ring_queue_round_up (capacity) != _video_buf_queue->capacity ())
+        _video_buf_queue = new VideoBufQueue (capacity);
+    _queue_capacity = capacity;
+    _backpressure = policy;
+    return true;
+}
+
 XCamReturn
 ImageProcessor::start()
 {
     XCamReturn ret = XCAM_RETURN_NO_ERROR;
-    if (!_results_thread->start ()) {
+    _video_buf_queue->resume_pop ();
+    _results_thread->triger_start ();
+    if (!_results_thread->start ())
         return XCAM_RETURN_ERROR_THREAD;
-    }
     if (!_processor_thread->start ()) {
+        _results_thread->stop ();
         return XCAM_RETURN_ERROR_THREAD;
     }
+    // threads running first, so no buffer queued ahead of them
+    _accepting.store (true);
     ret = emit_start ();
     if (ret != XCAM_RETURN_NO_ERROR) {
         XCAM_LOG_WARNING ("ImageProcessor(%s) emit start failed", XCAM_STR (_name));
-        _video_buf_queue.pause_pop ();
+        _accepting.store (false);
+        _video_buf_queue->pause_pop ();
         _results_thread->triger_stop ();
         _processor_thread->stop ();
         _results_thread->stop ();
@@ -186,13 +251,20 @@ ImageProcessor::start()
 XCamReturn
 ImageProcessor::stop()
 {
-    _video_buf_queue.pause_pop ();
+    _accepting.store (false);
+    {
+        SmartLock lock (_space_mutex);
+        _space_cond.broadcast ();
+    }
+    _video_buf_queue->pause_pop ();
     _results_thread->triger_stop ();
 
     emit_stop ();
 
     _processor_thread->stop ();
     _results_thread->stop ();
+    // buffers left queued go back to their pools, v4l2 ones to the driver
+    _video_buf_queue->clear ();
     XCAM_LOG_DEBUG ("ImageProcessor(%s) stopped", XCAM_STR (_name));
     return XCAM_RETURN_NO_ERROR;
 }
@@ -200,11 +272,93 @@ ImageProcessor::stop()
 XCamReturn
 ImageProcessor::push_buffer (SmartPtr<VideoBuffer> &buf)
 {
-    if (_video_buf_queue.push (buf))
-        return XCAM_RETURN_NO_ERROR;
+    return push_buffer (SmartPtr<VideoBuffer> (buf));
+}
 
-    XCAM_LOG_DEBUG ("processor push buffer failed");
-    return XCAM_RETURN_ERROR_UNKNOWN;
+XCamReturn
+ImageProcessor::push_buffer (SmartPtr<VideoBuffer> &&buf)
+{
+    SmartPtr<VideoBuffer> old_buf;
+
+    XCAM_ASSERT (buf.ptr ());
+    buf->add_stamp (XCAM_STAMP_PROCESS_PUSH);
+
+    while (_accepting.load ()) {
+        if (_backpressure == BACKPRESSURE_KEEP_LATEST) {
+            while ((old_buf = _video_buf_queue->pop (0)).ptr ())
+                drop_buffer (old_buf);
+        }
+
+        // push keeps @buf when ring is full
+        if (!is_input_full () && _video_buf_queue->push (std::move (buf))) {
+            _processor_thread->wakeup ();
+            return XCAM_RETURN_NO_ERROR;
+        }
+
+        switch (_backpressure) {
+        case BACKPRESSURE_DROP_NEWEST:
+            drop_buffer (buf);
+            return XCAM_RETURN_BYPASS;
+        case BACKPRESSURE_DROP_OLDEST:
+            // consumer may take it first, then retry push
+            old_buf = _video_buf_queue->pop (0);
+            if (old_buf.ptr ())
+                drop_buffer (old_buf);
+            break;
+        case BACKPRESSURE_KEEP_LATEST:
+            break;
+        case BACKPRESSURE_BLOCK:
+            if (!wait_input_space ())
+                return XCAM_RETURN_BYPASS;
+            break;
+        }
+    }
+
+    XCAM_LOG_DEBUG ("processor(%s) push buffer bypassed, processor stopped", XCAM_STR (_name));
+    return XCAM_RETURN_BYPASS;
+}
+
+bool
+ImageProcessor::is_input_full ()
+{
+    return _video_buf_queue->size () >= _queue_capacity;
+}
+
+bool
+ImageProcessor::wait_input_space ()
+{
+    XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_QUEUE, "processor_backpressure");
+    SmartLock lock (_space_mutex);
+
+    // consumer only signals when it sees waiters, timed wait covers a missed signal
+    _space_waiters.fetch_add (1);
+    while (_accepting.load () && is_input_full ())
+        _space_cond.timedwait (_space_mutex, XCAM_PROCESSOR_SPACE_WAIT_TIME);
+    _space_waiters.fetch_sub (1);
+
+    return _accepting.load ();
+}
+
+void
+ImageProcessor::drop_buffer (SmartPtr<VideoBuffer> &buf)
+{
+    uint64_t dropped = _dropped.fetch_add (1) + 1;
+
+    if (_callback) {
+        _callback->process_buffer_dropped (this, buf, dropped);
+    } else {
+        XCAM_LOG_DEBUG ("processor(%s) dropped buffer, %" PRIu64 " dropped in total", XCAM_STR (_name), dropped);
+    }
+
+    // last reference, V4l2BufferProxy re-queues to driver here
+    buf.release ();
+}
+
+void
+ImageProcessor::get_metrics (PipelineMetrics &metrics)
+{
+    metrics.add_queue (_name, "input", _video_buf_queue->size (), _dropped.load ());
+    metrics.add_queue (_name, "results", _results_thread->get_queue_depth ());
 }
 
 XCamReturn
@@ -324,12 +478,21 @@ ImageProcessor::buffer_process_loop ()
 {
     XCamReturn ret = XCAM_RETURN_NO_ERROR;
     SmartPtr<VideoBuffer> new_buf;
-    SmartPtr<VideoBuffer> buf = _video_buf_queue.pop();
+    SmartPtr<VideoBuffer> buf = _video_buf_queue->pop (0);
 
+    // queue paused or buffer already taken
     if (!buf.ptr())
-        return XCAM_RETURN_ERROR_MEM;
+        return XCAM_RETURN_BYPASS;
 
-    ret = this->process_buffer (buf, new_buf);
+    if (_space_waiters.load ()) {
+        SmartLock lock (_space_mutex);
+        _space_cond.broadcast ();
+    }
+
+    {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_PROCESSOR, get_name ());
+        ret = this->process_buffer (buf, new_buf);
+    }
     if (ret < XCAM_RETURN_NO_ERROR) {
         XCAM_LOG_DEBUG ("processing buffer failed");
         notify_process_buffer_failed (buf);
@@ -342,6 +505,18 @@ ImageProcessor::buffer_process_loop ()
     return XCAM_RETURN_NO_ERROR;
 }
 
+bool
+ImageProcessor::set_handler_thread_attributes (const ThreadAttributes &attrs)
+{
+    return _processor_thread->set_attributes (attrs);
+}
+
+XCamReturn
+ImageProcessor::prepare ()
+{
+    return XCAM_RETURN_NO_ERROR;
+}
+
 XCamReturn
 ImageProcessor::emit_start ()
 {
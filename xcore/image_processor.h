@@ -26,11 +26,26 @@
 #include "x3a_result.h"
 #include "smartptr.h"
 #include "safe_list.h"
+#include "ring_queue.h"
+#include "xcam_thread.h"
+#include "pipeline_metrics.h"
+#include "xcam_mutex.h"
+#include <atomic>
+
+#define XCAM_PROCESSOR_DEFAULT_QUEUE_SIZE  XCAM_RING_QUEUE_DEFAULT_SIZE
 
 namespace XCam {
 
 class ImageProcessor;
 
+// what push_buffer does when the input queue holds its capacity
+enum BackpressurePolicy {
+    BACKPRESSURE_DROP_OLDEST = 0,  // oldest queued frame dropped, latency bounded by capacity
+    BACKPRESSURE_DROP_NEWEST,      // pushed frame dropped
+    BACKPRESSURE_KEEP_LATEST,      // queued frames dropped on each push, only newest waits
+    BACKPRESSURE_BLOCK,            // producer waits for room, until stop
+};
+
 /* callback interface */
 class ImageProcessCallback {
 public:
@@ -39,6 +54,9 @@ public:
     virtual void process_buffer_done (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf);
     virtual void process_buffer_failed (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf);
     virtual void process_image_result_done (ImageProcessor *processor, const SmartPtr<X3aResult> &result);
+    // @buf dropped by backpressure policy, @dropped in total;
+    // don't keep @buf, v4l2 buffers return to driver right after
+    virtual void process_buffer_dropped (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf, uint64_t dropped);
 
 private:
     XCAM_DEAD_COPY (ImageProcessCallback);
@@ -53,7 +71,8 @@ class ImageProcessor
     friend class ImageProcessorThread;
     friend class X3aResultsProcessThread;
 
-    typedef SafeList<VideoBuffer> VideoBufQueue;
+    // several streams may feed one processor
+    typedef MpmcRingQueue<VideoBuffer> VideoBufQueue;
 
 public:
     explicit ImageProcessor (const char* name);
@@ -64,13 +83,25 @@ public:
     }
 
     bool set_callback (ImageProcessCallback *callback);
+    // input queue, before start, default XCAM_PROCESSOR_DEFAULT_QUEUE_SIZE and BACKPRESSURE_DROP_OLDEST
+    bool set_input_queue (uint32_t capacity, BackpressurePolicy policy);
+    // optional before start, builds what the first buffer would build lazily,
+    // may run concurrently with other startup work
+    virtual XCamReturn prepare ();
     XCamReturn start();
     XCamReturn stop ();
 
+    // XCAM_RETURN_BYPASS if @buf dropped by policy or processor stopped
     XCamReturn push_buffer (SmartPtr<VideoBuffer> &buf);
+    XCamReturn push_buffer (SmartPtr<VideoBuffer> &&buf);
     XCamReturn push_3a_results (X3aResultList &results);
     XCamReturn push_3a_result (SmartPtr<X3aResult> &result);
 
+    // attributes of thread running image handlers, must be called before start
+    virtual bool set_handler_thread_attributes (const ThreadAttributes &attrs);
+    // add queue depths, handler times and pool occupancy of this processor
+    virtual void get_metrics (PipelineMetrics &metrics);
+
 protected:
     virtual bool can_process_result (SmartPtr<X3aResult> &result) = 0;
     virtual XCamReturn apply_3a_results (X3aResultList &results) = 0;
@@ -87,6 +118,9 @@ protected:
 private:
     void filter_valid_results (X3aResultList &input, X3aResultList &valid_results);
     XCamReturn buffer_process_loop ();
+    bool is_input_full ();
+    bool wait_input_space ();
+    void drop_buffer (SmartPtr<VideoBuffer> &buf);
 
     XCamReturn process_3a_results (X3aResultList &results);
     XCamReturn process_3a_result (SmartPtr<X3aResult> &result);
@@ -98,8 +132,17 @@ protected:
     char                               *_name;
     ImageProcessCallback               *_callback;
     SmartPtr<ImageProcessorThread>      _processor_thread;
-    VideoBufQueue                       _video_buf_queue;
+    SmartPtr<VideoBufQueue>             _video_buf_queue;
     SmartPtr<X3aResultsProcessThread>   _results_thread;
+
+private:
+    uint32_t                            _queue_capacity;
+    BackpressurePolicy                  _backpressure;
+    std::atomic<bool>                   _accepting;     // false when stopped, wakes blocked producers
+    std::atomic<uint64_t>               _dropped;
+    std::atomic<uint32_t>               _space_waiters;
+    Mutex                               _space_mutex;
+    Cond                                _space_cond;
 };
 
 };
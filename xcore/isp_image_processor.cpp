@@ -50,7 +50,7 @@ IspImageProcessor::process_buffer(SmartPtr<VideoBuffer> &input, SmartPtr<VideoBu
 bool
 IspImageProcessor::can_process_result (SmartPtr<X3aResult> &result)
 {
-    if (result.ptr() == NULL)
+    if (result.ptr() == NULL || !has_controller ())
         return false;
 
     switch (result->get_type()) {
@@ -188,7 +188,7 @@ IspExposureImageProcessor::IspExposureImageProcessor (SmartPtr<IspController> &c
 bool
 IspExposureImageProcessor::can_process_result (SmartPtr<X3aResult> &result)
 {
-    if (result.ptr() == NULL)
+    if (result.ptr() == NULL || !has_controller ())
         return false;
 
     switch (result->get_type()) {
@@ -31,6 +31,10 @@ class IspController;
 class IspConfigTranslator;
 class SensorDescriptor;
 
+/*
+ * @controller NULL when no ISP is behind the capture device (virtual sources),
+ * frames are then passed through and no 3a result is taken
+ */
 class IspImageProcessor
     : public ImageProcessor
 {
@@ -39,6 +43,10 @@ public:
     virtual ~IspImageProcessor ();
 
 protected:
+    bool has_controller () const {
+        return _controller.ptr () != NULL;
+    }
+
     //derive from ImageProcessor
     virtual bool can_process_result (SmartPtr<X3aResult> &result);
     virtual XCamReturn apply_3a_results (X3aResultList &results);
@@ -0,0 +1,108 @@
+/*
+ * latency_histogram.cpp - latency histogram
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "latency_histogram.h"
+#include <math.h>
+
+#define XCAM_LATENCY_SUB_BUCKETS (1 << XCAM_LATENCY_SUB_BUCKET_BITS)
+
+namespace XCam {
+
+LatencyHistogram::LatencyHistogram ()
+{
+    reset ();
+}
+
+void
+LatencyHistogram::reset ()
+{
+    xcam_mem_clear (_buckets);
+    _count = 0;
+    _sum = 0;
+    _max = 0;
+}
+
+/*
+ * values below XCAM_LATENCY_SUB_BUCKETS have own buckets,
+ * others are bucketed by highest bit and the next SUB_BUCKET_BITS bits
+ */
+uint32_t
+LatencyHistogram::get_bucket (int64_t value)
+{
+    uint64_t v = (uint64_t)value;
+    uint32_t msb = 0, shift = 0;
+
+    if (v < XCAM_LATENCY_SUB_BUCKETS)
+        return v;
+
+    msb = 63 - __builtin_clzll (v);
+    shift = msb - XCAM_LATENCY_SUB_BUCKET_BITS;
+    return ((msb - XCAM_LATENCY_SUB_BUCKET_BITS + 1) << XCAM_LATENCY_SUB_BUCKET_BITS) +
+           ((v >> shift) & (XCAM_LATENCY_SUB_BUCKETS - 1));
+}
+
+int64_t
+LatencyHistogram::get_bucket_upper (uint32_t bucket)
+{
+    uint32_t shift = 0;
+    uint64_t lower = 0;
+
+    if (bucket < XCAM_LATENCY_SUB_BUCKETS)
+        return bucket;
+
+    shift = (bucket >> XCAM_LATENCY_SUB_BUCKET_BITS) - 1;
+    lower = (uint64_t)(XCAM_LATENCY_SUB_BUCKETS + (bucket & (XCAM_LATENCY_SUB_BUCKETS - 1))) << shift;
+    return (int64_t)(lower + (UINT64_C(1) << shift) - 1);
+}
+
+void
+LatencyHistogram::add (int64_t value)
+{
+    if (value < 0)
+        value = 0;
+    if (value >= (INT64_C(1) << XCAM_LATENCY_MAX_BITS))
+        value = (INT64_C(1) << XCAM_LATENCY_MAX_BITS) - 1;
+
+    ++_buckets[get_bucket (value)];
+    ++_count;
+    _sum += value;
+    if (value > _max)
+        _max = value;
+}
+
+int64_t
+LatencyHistogram::get_percentile (double percent) const
+{
+    uint64_t rank = 0, seen = 0;
+
+    if (!_count)
+        return 0;
+
+    rank = (uint64_t)ceil (_count * percent / 100.0);
+    rank = XCAM_MAX (rank, UINT64_C(1));
+    for (uint32_t i = 0; i < XCAM_LATENCY_BUCKET_COUNT; ++i) {
+        seen += _buckets[i];
+        if (seen >= rank)
+            return XCAM_MIN (get_bucket_upper (i), _max);
+    }
+    return _max;
+}
+
+};
@@ -0,0 +1,71 @@
+/*
+ * latency_histogram.h - latency histogram
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_LATENCY_HISTOGRAM_H
+#define XCAM_LATENCY_HISTOGRAM_H
+
+#include "xcam_utils.h"
+
+// values below 2^XCAM_LATENCY_MAX_BITS, 8 buckets per power of 2
+#define XCAM_LATENCY_SUB_BUCKET_BITS 3
+#define XCAM_LATENCY_MAX_BITS        40
+#define XCAM_LATENCY_BUCKET_COUNT    \
+    ((XCAM_LATENCY_MAX_BITS - XCAM_LATENCY_SUB_BUCKET_BITS + 1) << XCAM_LATENCY_SUB_BUCKET_BITS)
+
+namespace XCam {
+
+/*
+ * LatencyHistogram, log-linear buckets with relative error below 1/8,
+ * percentiles are reported as bucket upper bound, capped by max value.
+ * Not thread safe.
+ */
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram ();
+
+    void add (int64_t value);
+    void reset ();
+
+    uint64_t get_count () const {
+        return _count;
+    }
+    int64_t get_max () const {
+        return _max;
+    }
+    int64_t get_mean () const {
+        return _count ? _sum / (int64_t)_count : 0;
+    }
+    // @percent in (0, 100]
+    int64_t get_percentile (double percent) const;
+
+private:
+    static uint32_t get_bucket (int64_t value);
+    static int64_t get_bucket_upper (uint32_t bucket);
+
+private:
+    uint64_t   _buckets[XCAM_LATENCY_BUCKET_COUNT];
+    uint64_t   _count;
+    int64_t    _sum;
+    int64_t    _max;
+};
+
+};
+
+#endif //XCAM_LATENCY_HISTOGRAM_H
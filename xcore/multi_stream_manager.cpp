@@ -0,0 +1,684 @@
+/*
+ * multi_stream_manager.cpp - capture and process several cameras in one pipeline
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "multi_stream_manager.h"
+#include "poll_thread.h"
+#include "v4l2_buffer_proxy.h"
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <atomic>
+
+#define XCAM_MULTI_STREAM_BURST          2
+#define XCAM_MULTI_STREAM_ERROR_BACKOFF  10000  // us, stream fd disarmed after error
+
+namespace XCam {
+
+class MultiStream
+    : public PollCallback
+    , public StatsCallback
+    , public AnalyzerCallback
+    , public ImageProcessCallback
+{
+public:
+    MultiStream (MultiStreamManager *manager, uint32_t stream_id, const SmartPtr<V4l2Device> &capture_device)
+        : id (stream_id)
+        , device (capture_device)
+        , rearm_time (0)
+        , has_stats_source (false)
+        , captured_frames (0)
+        , dequeue_failures (0)
+        , capture_fps (0.0)
+        , _manager (manager)
+        , _fps_window_start (0)
+        , _fps_window_frames (0)
+    {
+        center = new X3aImageProcessCenter;
+        center->set_image_callback (this);
+    }
+
+    // only called in the shared poll thread
+    void count_captured_frame ();
+
+    //virtual functions derived from PollCallback
+    virtual XCamReturn poll_buffer_ready (SmartPtr<V4l2BufferProxy> &buf);
+    virtual XCamReturn poll_buffer_failed (int64_t timestamp, const char *msg);
+
+    //virtual functions derived from StatsCallback
+    virtual XCamReturn x3a_stats_ready (const SmartPtr<X3aStats> &stats);
+    virtual XCamReturn dvs_stats_ready () {
+        return XCAM_RETURN_NO_ERROR;
+    }
+    virtual XCamReturn scaled_image_ready (const SmartPtr<ScaledVideoBuffer> &buffer) {
+        XCAM_UNUSED (buffer);
+        return XCAM_RETURN_NO_ERROR;
+    }
+
+    //virtual functions derived from AnalyzerCallback
+    virtual void x3a_calculation_done (XAnalyzer *analyzer, X3aResultList &results);
+
+    //virtual functions derived from ImageProcessCallback
+    virtual void process_buffer_done (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf);
+
+public:
+    uint32_t                          id;
+    SmartPtr<V4l2Device>              device;
+    SmartPtr<X3aAnalyzer>             analyzer;
+    SmartPtr<X3aImageProcessCenter>   center;
+    std::vector<SmartPtr<ImageProcessor> > processors;  // put into center on each start, its stop clears them
+    SmartPtr<PollThread>              poll_thread;  // only if device can't be polled by epoll
+    int64_t                           rearm_time;   // fd disarmed after error until then
+    bool                              has_stats_source;  // stats callback handed out
+
+    std::atomic<uint64_t>             captured_frames;
+    std::atomic<uint64_t>             dequeue_failures;
+    std::atomic<double>               capture_fps;
+
+private:
+    XCAM_DEAD_COPY (MultiStream);
+
+private:
+    MultiStreamManager               *_manager;
+    int64_t                           _fps_window_start;
+    uint64_t                          _fps_window_frames;
+};
+
+class MultiStreamPollThread
+    : public Thread
+{
+public:
+    MultiStreamPollThread (MultiStreamManager *manager)
+        : Thread ("multi_stream_poll")
+        , _manager (manager)
+    {}
+
+protected:
+    virtual bool loop () {
+        XCamReturn ret = _manager->poll_loop ();
+
+        if (ret == XCAM_RETURN_NO_ERROR || ret == XCAM_RETURN_ERROR_TIMEOUT)
+            return true;
+        return false;
+    }
+
+private:
+    MultiStreamManager   *_manager;
+};
+
+// same window as PollThread
+void
+MultiStream::count_captured_frame ()
+{
+    int64_t now = xcam_get_monotonic_time ();
+
+    ++captured_frames;
+    ++_fps_window_frames;
+    if (!_fps_window_start) {
+        _fps_window_start = now;
+        _fps_window_frames = 0;
+    } else if (now - _fps_window_start >= XCAM_POLL_FPS_WINDOW) {
+        capture_fps = _fps_window_frames * 1000000.0 / (now - _fps_window_start);
+        _fps_window_start = now;
+        _fps_window_frames = 0;
+    }
+}
+
+XCamReturn
+MultiStream::poll_buffer_ready (SmartPtr<V4l2BufferProxy> &buf)
+{
+    bool ret = false;
+
+    buf->set_stream_id (id);
+    if (!processors.empty ())
+        ret = center->put_buffer (SmartPtr<VideoBuffer> (std::move (buf)));
+    else
+        ret = _manager->_shared_center->put_buffer (SmartPtr<VideoBuffer> (std::move (buf)));
+
+    // a full processor queue drops the frame, other streams and the poll thread go on
+    if (!ret)
+        XCAM_LOG_WARNING ("stream(%d) frame dropped, processor queue full", id);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+MultiStream::poll_buffer_failed (int64_t timestamp, const char *msg)
+{
+    XCAM_UNUSED (timestamp);
+    XCAM_LOG_WARNING ("stream(%d) poll buffer failed: %s", id, XCAM_STR (msg));
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+MultiStream::x3a_stats_ready (const SmartPtr<X3aStats> &stats)
+{
+    if (!analyzer.ptr ())
+        return XCAM_RETURN_NO_ERROR;
+
+    XCamReturn ret = analyzer->push_3a_stats (stats);
+    XCAM_FAIL_RETURN (
+        ERROR, ret == XCAM_RETURN_NO_ERROR, ret,
+        "stream(%d) analyze 3a statistics failed", id);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+void
+MultiStream::x3a_calculation_done (XAnalyzer *analyzer, X3aResultList &results)
+{
+    if (!processors.empty ()) {
+        XCamReturn ret = center->put_3a_results (results);
+        if (ret != XCAM_RETURN_NO_ERROR && ret != XCAM_RETURN_BYPASS) {
+            XCAM_LOG_WARNING ("stream(%d) apply 3a results failed", id);
+            return;
+        }
+    }
+    AnalyzerCallback::x3a_calculation_done (analyzer, results);
+}
+
+void
+MultiStream::process_buffer_done (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf)
+{
+    ImageProcessCallback::process_buffer_done (processor, buf);
+    _manager->stream_buffer_done (buf);
+}
+
+MultiStreamManager::MultiStreamManager ()
+    : _has_shared_processors (false)
+    , _is_running (false)
+    , _epoll_fd (-1)
+    , _wakeup_fd (-1)
+    , _polled_streams (0)
+{
+    _shared_center = new X3aImageProcessCenter;
+    _shared_center->set_image_callback (this);
+    _poll_thread = new MultiStreamPollThread (this);
+    XCAM_LOG_DEBUG ("MultiStreamManager constructed");
+}
+
+MultiStreamManager::~MultiStreamManager ()
+{
+    stop ();
+    XCAM_LOG_DEBUG ("~MultiStreamManager destructed");
+}
+
+MultiStream *
+MultiStreamManager::get_stream (uint32_t stream_id)
+{
+    if (stream_id >= _streams.size ())
+        return NULL;
+    return _streams[stream_id].ptr ();
+}
+
+bool
+MultiStreamManager::add_stream (const SmartPtr<V4l2Device> &device, uint32_t &stream_id)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !_is_running, false,
+        "multi stream manager add stream failed since started");
+    XCAM_FAIL_RETURN (
+        WARNING, device.ptr () && device->is_opened (), false,
+        "multi stream manager add stream failed, device not opened");
+    XCAM_FAIL_RETURN (
+        WARNING, _streams.size () < XCAM_MULTI_STREAM_MAX_STREAMS, false,
+        "multi stream manager add stream failed, max %d streams", XCAM_MULTI_STREAM_MAX_STREAMS);
+
+    stream_id = _streams.size ();
+    _streams.push_back (new MultiStream (this, stream_id, device));
+    XCAM_LOG_INFO ("stream(%d) added, device:%s", stream_id, XCAM_STR (device->get_device_name ()));
+    return true;
+}
+
+bool
+MultiStreamManager::set_stream_analyzer (uint32_t stream_id, const SmartPtr<X3aAnalyzer> &analyzer)
+{
+    MultiStream *stream = get_stream (stream_id);
+
+    XCAM_FAIL_RETURN (
+        WARNING, !_is_running && stream, false,
+        "multi stream manager set analyzer of stream(%d) failed", stream_id);
+    // callbacks set once, start may run again after stop
+    if (analyzer.ptr ())
+        analyzer->set_results_callback (stream);
+    stream->analyzer = analyzer;
+    return true;
+}
+
+bool
+MultiStreamManager::add_stream_processor (uint32_t stream_id, const SmartPtr<ImageProcessor> &processor)
+{
+    MultiStream *stream = get_stream (stream_id);
+
+    XCAM_FAIL_RETURN (
+        WARNING, !_is_running && stream && processor.ptr (), false,
+        "multi stream manager add processor of stream(%d) failed", stream_id);
+    stream->processors.push_back (processor);
+    return true;
+}
+
+bool
+MultiStreamManager::add_shared_processor (const SmartPtr<ImageProcessor> &processor)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !_is_running && processor.ptr (), false,
+        "multi stream manager add shared processor failed");
+    _shared_processors.push_back (processor);
+    _has_shared_processors = true;
+    return true;
+}
+
+StatsCallback *
+MultiStreamManager::get_stats_callback (uint32_t stream_id)
+{
+    MultiStream *stream = get_stream (stream_id);
+
+    if (stream)
+        stream->has_stats_source = true;
+    return stream;
+}
+
+bool
+MultiStreamManager::set_poll_thread_attributes (const ThreadAttributes &attrs)
+{
+    return _poll_thread->set_attributes (attrs);
+}
+
+// X3aImageProcessCenter::stop drops its processors, insert them again for restart
+static XCamReturn
+start_center (
+    SmartPtr<X3aImageProcessCenter> &center,
+    std::vector<SmartPtr<ImageProcessor> > &processors)
+{
+    for (std::vector<SmartPtr<ImageProcessor> >::iterator i_pro = processors.begin ();
+            i_pro != processors.end (); ++i_pro)
+        center->insert_processor (*i_pro);
+    return center->start ();
+}
+
+XCamReturn
+MultiStreamManager::start_stream (MultiStream *stream)
+{
+    XCamReturn ret = XCAM_RETURN_NO_ERROR;
+
+    ret = stream->device->start ();
+    XCAM_FAIL_RETURN (
+        ERROR, ret == XCAM_RETURN_NO_ERROR, ret,
+        "stream(%d) capture device start failed", stream->id);
+
+    if (stream->analyzer.ptr ()) {
+        SmartPtr<X3aAnalyzer> &analyzer = stream->analyzer;
+        uint32_t width = 0, height = 0;
+        uint32_t fps_n = 0, fps_d = 0;
+        double framerate = 30.0;
+
+        XCAM_FAIL_RETURN (
+            ERROR, analyzer->prepare_handlers () == XCAM_RETURN_NO_ERROR, XCAM_RETURN_ERROR_PARAM,
+            "stream(%d) prepare analyzer handler failed", stream->id);
+
+        stream->device->get_size (width, height);
+        stream->device->get_framerate (fps_n, fps_d);
+        if (fps_d)
+            framerate = (double)fps_n / (double)fps_d;
+        ret = analyzer->init (width, height, framerate);
+        XCAM_FAIL_RETURN (
+            ERROR, ret == XCAM_RETURN_NO_ERROR, ret,
+            "stream(%d) initialize analyzer failed", stream->id);
+        ret = analyzer->start ();
+        XCAM_FAIL_RETURN (
+            ERROR, ret == XCAM_RETURN_NO_ERROR, ret,
+            "stream(%d) start analyzer failed", stream->id);
+    }
+
+    if (!stream->processors.empty ()) {
+        ret = start_center (stream->center, stream->processors);
+        XCAM_FAIL_RETURN (
+            ERROR, ret == XCAM_RETURN_NO_ERROR, ret,
+            "stream(%d) processors start failed", stream->id);
+    }
+
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+MultiStreamManager::start ()
+{
+    XCamReturn ret = XCAM_RETURN_NO_ERROR;
+
+    XCAM_FAIL_RETURN (
+        ERROR, !_streams.empty (), XCAM_RETURN_ERROR_PARAM,
+        "multi stream manager start failed, no stream added");
+    if (_is_running)
+        return XCAM_RETURN_NO_ERROR;
+
+    // checked before anything starts
+    for (uint32_t i = 0; i < _streams.size (); ++i) {
+        MultiStream *stream = _streams[i].ptr ();
+        XCAM_FAIL_RETURN (
+            ERROR, _has_shared_processors || !stream->processors.empty (), XCAM_RETURN_ERROR_PARAM,
+            "stream(%d) has no processor", stream->id);
+        XCAM_FAIL_RETURN (
+            ERROR, !stream->analyzer.ptr () || stream->has_stats_source, XCAM_RETURN_ERROR_PARAM,
+            "stream(%d) analyzer has no stats source, ISP event devices are not polled, "
+            "hand get_stats_callback () to the stats producer", stream->id);
+    }
+
+    // from now on stop () undoes the partial start
+    _is_running = true;
+
+    if (_has_shared_processors) {
+        ret = start_center (_shared_center, _shared_processors);
+        if (ret != XCAM_RETURN_NO_ERROR) {
+            XCAM_LOG_ERROR ("multi stream manager shared processors start failed");
+            stop ();
+            return ret;
+        }
+    }
+
+    for (uint32_t i = 0; i < _streams.size (); ++i) {
+        ret = start_stream (_streams[i].ptr ());
+        if (ret != XCAM_RETURN_NO_ERROR) {
+            stop ();
+            return ret;
+        }
+    }
+
+    ret = start_poll ();
+    if (ret != XCAM_RETURN_NO_ERROR) {
+        XCAM_LOG_ERROR ("multi stream manager start poll failed");
+        stop ();
+        return ret;
+    }
+
+    XCAM_LOG_INFO ("multi stream manager started, %d streams, %d polled by epoll",
+                   (uint32_t)_streams.size (), _polled_streams);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+MultiStreamManager::stop ()
+{
+    if (!_is_running)
+        return XCAM_RETURN_NO_ERROR;
+    _is_running = false;
+
+    stop_poll ();
+
+    for (uint32_t i = 0; i < _streams.size (); ++i) {
+        MultiStream *stream = _streams[i].ptr ();
+        if (stream->analyzer.ptr ()) {
+            stream->analyzer->stop ();
+            stream->analyzer->deinit ();
+        }
+        stream->center->stop ();
+    }
+    _shared_center->stop ();
+
+    for (uint32_t i = 0; i < _streams.size (); ++i)
+        _streams[i]->device->stop ();
+
+    XCAM_LOG_DEBUG ("multi stream manager stopped");
+    return XCAM_RETURN_NO_ERROR;
+}
+
+/*
+ * capture fds go to one epoll set, fds epoll refuses (regular files of
+ * virtual devices) are polled by a PollThread of their stream
+ */
+XCamReturn
+MultiStreamManager::start_poll ()
+{
+    struct epoll_event event;
+
+    XCAM_ASSERT (_epoll_fd == -1 && _wakeup_fd == -1);
+    _polled_streams = 0;
+    _epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    _wakeup_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+    XCAM_FAIL_RETURN (
+        ERROR, _epoll_fd != -1 && _wakeup_fd != -1, XCAM_RETURN_ERROR_FILE,
+        "multi stream manager create epoll fd failed: %s", strerror (errno));
+
+    xcam_mem_clear (event);
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    XCAM_FAIL_RETURN (
+        ERROR, epoll_ctl (_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &event) == 0, XCAM_RETURN_ERROR_FILE,
+        "multi stream manager add wakeup fd failed: %s", strerror (errno));
+
+    for (uint32_t i = 0; i < _streams.size (); ++i) {
+        MultiStream *stream = _streams[i].ptr ();
+
+        stream->rearm_time = 0;
+        event.events = EPOLLIN;
+        event.data.ptr = stream;
+        if (epoll_ctl (_epoll_fd, EPOLL_CTL_ADD, stream->device->get_fd (), &event) == 0) {
+            ++_polled_streams;
+            continue;
+        }
+
+        XCAM_LOG_INFO ("stream(%d) can't be polled by epoll(%s), use own poll thread", i, strerror (errno));
+        SmartPtr<PollThread> poll_thread = new PollThread;
+        poll_thread->set_capture_device (stream->device);
+        poll_thread->set_poll_callback (stream);
+        poll_thread->set_stats_callback (stream);
+        {
+            SmartLock lock (_metrics_mutex);
+            stream->poll_thread = poll_thread;
+        }
+        XCAM_FAIL_RETURN (
+            ERROR, poll_thread->start () == XCAM_RETURN_NO_ERROR, XCAM_RETURN_ERROR_THREAD,
+            "stream(%d) start poll thread failed", i);
+    }
+
+    if (_polled_streams && !_poll_thread->start ())
+        return XCAM_RETURN_ERROR_THREAD;
+    return XCAM_RETURN_NO_ERROR;
+}
+
+void
+MultiStreamManager::stop_poll ()
+{
+    if (_poll_thread->is_running ()) {
+        uint64_t value = 1;
+        // poll thread blocks without timeout, wake it up
+        if (write (_wakeup_fd, &value, sizeof (value)) != sizeof (value))
+            XCAM_LOG_WARNING ("multi stream manager wakeup failed: %s", strerror (errno));
+        _poll_thread->stop ();
+    }
+
+    for (uint32_t i = 0; i < _streams.size (); ++i) {
+        MultiStream *stream = _streams[i].ptr ();
+        if (!stream->poll_thread.ptr ())
+            continue;
+        stream->poll_thread->stop ();
+        SmartLock lock (_metrics_mutex);
+        stream->poll_thread.release ();
+    }
+
+    if (_epoll_fd != -1)
+        ::close (_epoll_fd);
+    if (_wakeup_fd != -1)
+        ::close (_wakeup_fd);
+    _epoll_fd = -1;
+    _wakeup_fd = -1;
+    _polled_streams = 0;
+}
+
+bool
+MultiStreamManager::arm_stream_fd (MultiStream *stream, bool arm)
+{
+    struct epoll_event event;
+
+    xcam_mem_clear (event);
+    event.events = arm ? (uint32_t) EPOLLIN : 0;
+    event.data.ptr = stream;
+    if (epoll_ctl (_epoll_fd, EPOLL_CTL_MOD, stream->device->get_fd (), &event) != 0) {
+        XCAM_LOG_WARNING ("stream(%d) %s fd failed: %s", stream->id, arm ? "arm" : "disarm", strerror (errno));
+        return false;
+    }
+    return true;
+}
+
+/*
+ * level triggered epoll moves served fds behind other ready ones,
+ * with at most XCAM_MULTI_STREAM_BURST buffers a stream per wakeup
+ * streams are served round robin.
+ */
+XCamReturn
+MultiStreamManager::poll_loop ()
+{
+    struct epoll_event events[XCAM_MULTI_STREAM_MAX_STREAMS + 1];
+    int64_t now = xcam_get_monotonic_time ();
+    int64_t next_rearm = 0;
+    int timeout_msec = -1;
+    int count = 0;
+
+    for (uint32_t i = 0; i < _streams.size (); ++i) {
+        MultiStream *stream = _streams[i].ptr ();
+        if (!stream->rearm_time)
+            continue;
+        if (stream->rearm_time <= now) {
+            stream->rearm_time = arm_stream_fd (stream, true) ? 0 : now + XCAM_MULTI_STREAM_ERROR_BACKOFF;
+            if (!stream->rearm_time)
+                continue;
+        }
+        if (!next_rearm || stream->rearm_time < next_rearm)
+            next_rearm = stream->rearm_time;
+    }
+    if (next_rearm)
+        timeout_msec = (next_rearm - now + 999) / 1000;
+
+    count = epoll_wait (_epoll_fd, events, XCAM_MULTI_STREAM_MAX_STREAMS + 1, timeout_msec);
+    if (count < 0) {
+        if (errno == EINTR)
+            return XCAM_RETURN_NO_ERROR;
+        XCAM_LOG_ERROR ("multi stream epoll wait failed: %s", strerror (errno));
+        return XCAM_RETURN_ERROR_UNKNOWN;
+    }
+    if (count == 0)
+        return XCAM_RETURN_ERROR_TIMEOUT;
+
+    for (int i = 0; i < count; ++i) {
+        MultiStream *stream = (MultiStream *)events[i].data.ptr;
+        bool failed = (events[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+
+        if (!stream)
+            return XCAM_RETURN_BYPASS;
+
+        for (uint32_t n = 0; !failed && n < XCAM_MULTI_STREAM_BURST; ++n) {
+            SmartPtr<V4l2Buffer> buf;
+
+            if (n > 0 && stream->device->poll_event (0) <= 0)
+                break;
+            if (stream->device->dequeue_buffer (buf) != XCAM_RETURN_NO_ERROR) {
+                ++stream->dequeue_failures;
+                failed = true;
+                break;
+            }
+            stream->count_captured_frame ();
+
+            SmartPtr<V4l2BufferProxy> buf_proxy = make_smart<V4l2BufferProxy> (buf, stream->device);
+            buf_proxy->add_stamp (XCAM_STAMP_DEQUEUE);
+            stream->poll_buffer_ready (buf_proxy);
+        }
+
+        if (failed) {
+            XCAM_LOG_DEBUG ("stream(%d) poll buffer got error but continue", stream->id);
+            if (arm_stream_fd (stream, false))
+                stream->rearm_time = xcam_get_monotonic_time () + XCAM_MULTI_STREAM_ERROR_BACKOFF;
+        }
+    }
+
+    return XCAM_RETURN_NO_ERROR;
+}
+
+void
+MultiStreamManager::stream_buffer_done (const SmartPtr<VideoBuffer> &buf)
+{
+    if (!_has_shared_processors) {
+        handle_buffer (buf->get_stream_id (), buf);
+        return;
+    }
+
+    if (!_shared_center->put_buffer (SmartPtr<VideoBuffer> (buf)))
+        XCAM_LOG_WARNING ("stream(%d) frame dropped, shared processor queue full", buf->get_stream_id ());
+}
+
+void
+MultiStreamManager::process_buffer_done (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf)
+{
+    ImageProcessCallback::process_buffer_done (processor, buf);
+    handle_buffer (buf->get_stream_id (), buf);
+}
+
+void
+MultiStreamManager::get_stream_metrics (uint32_t stream_id, PipelineMetrics &metrics)
+{
+    MultiStream *stream = get_stream (stream_id);
+
+    if (!stream || !_is_running)
+        return;
+
+    {
+        SmartLock lock (_metrics_mutex);
+        if (stream->poll_thread.ptr ()) {
+            stream->poll_thread->get_metrics (metrics);
+        } else {
+            metrics.capture_fps = stream->capture_fps.load ();
+            metrics.captured_frames = stream->captured_frames.load ();
+            metrics.dequeue_failures = stream->dequeue_failures.load ();
+        }
+    }
+    if (stream->analyzer.ptr ())
+        stream->analyzer->get_metrics (metrics);
+    stream->center->get_metrics (metrics);
+}
+
+void
+MultiStreamManager::get_metrics (PipelineMetrics &metrics)
+{
+    int64_t analyze_time = 0;
+
+    if (!_is_running)
+        return;
+
+    for (uint32_t i = 0; i < _streams.size (); ++i) {
+        PipelineMetrics stream_metrics;
+
+        get_stream_metrics (i, stream_metrics);
+        metrics.capture_fps += stream_metrics.capture_fps;
+        metrics.captured_frames += stream_metrics.captured_frames;
+        metrics.dequeue_failures += stream_metrics.dequeue_failures;
+        metrics.stats_in += stream_metrics.stats_in;
+        metrics.stats_dropped += stream_metrics.stats_dropped;
+        metrics.stats_skipped += stream_metrics.stats_skipped;
+        metrics.stats_analyzed += stream_metrics.stats_analyzed;
+        analyze_time += stream_metrics.analyze_mean_time * (int64_t)stream_metrics.stats_analyzed;
+        metrics.analyze_max_time = XCAM_MAX (metrics.analyze_max_time, stream_metrics.analyze_max_time);
+        metrics.stamp_overflows += stream_metrics.stamp_overflows;
+        metrics.queues.insert (metrics.queues.end (), stream_metrics.queues.begin (), stream_metrics.queues.end ());
+        metrics.pools.insert (metrics.pools.end (), stream_metrics.pools.begin (), stream_metrics.pools.end ());
+        metrics.handlers.insert (metrics.handlers.end (), stream_metrics.handlers.begin (), stream_metrics.handlers.end ());
+    }
+    metrics.analyze_mean_time = metrics.stats_analyzed ? analyze_time / (int64_t)metrics.stats_analyzed : 0;
+
+    if (_has_shared_processors)
+        _shared_center->get_metrics (metrics);
+}
+
+};
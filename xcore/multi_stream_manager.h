@@ -0,0 +1,131 @@
+/*
+ * multi_stream_manager.h - capture and process several cameras in one pipeline
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_MULTI_STREAM_MANAGER_H
+#define XCAM_MULTI_STREAM_MANAGER_H
+
+#include "xcam_utils.h"
+#include "smartptr.h"
+#include "xcam_mutex.h"
+#include "xcam_thread.h"
+#include "v4l2_device.h"
+#include "x3a_analyzer.h"
+#include "image_processor.h"
+#include "x3a_image_process_center.h"
+#include "stats_callback_interface.h"
+#include "pipeline_metrics.h"
+#include <vector>
+
+#define XCAM_MULTI_STREAM_MAX_STREAMS 32
+
+namespace XCam {
+
+class MultiStream;
+class MultiStreamPollThread;
+
+/*
+ * MultiStreamManager, N cameras sharing one pipeline instead of one DeviceManager each.
+ * Every capture device becomes a stream with its own id, 3a analyzer and
+ * optional stream processors, which get the results of that analyzer.
+ * Frames of all streams then go through the shared processors,
+ * tagged with their stream id (see VideoBuffer::get_stream_id),
+ * CL handlers keep one output pool per stream.
+ * One epoll thread dequeues all capture devices, taking at most
+ * XCAM_MULTI_STREAM_BURST buffers of a stream per wakeup; devices epoll can't wait on
+ * (virtual devices) get their own PollThread.
+ * Analyzers and processors run on the shared Executor, CL on the process CLContext.
+ * Shared processors must not keep state across frames (e.g. TNR),
+ * such handlers belong to stream processors.
+ * No ISP event device is polled, so streams never get ISP 3a stats;
+ * a stream analyzer needs another stats producer fed by get_stats_callback ()
+ * (e.g. VirtualV4l2Device synthetic stats), start fails otherwise.
+ */
+class MultiStreamManager
+    : public ImageProcessCallback
+{
+    friend class MultiStream;
+    friend class MultiStreamPollThread;
+
+public:
+    MultiStreamManager ();
+    virtual ~MultiStreamManager ();
+
+    // before start, @device opened with format set, returns stream id
+    bool add_stream (const SmartPtr<V4l2Device> &device, uint32_t &stream_id);
+    // 3a of stream @stream_id, results applied to its stream processors, needs a stats source
+    bool set_stream_analyzer (uint32_t stream_id, const SmartPtr<X3aAnalyzer> &analyzer);
+    // processors running frames of @stream_id only, before shared ones
+    bool add_stream_processor (uint32_t stream_id, const SmartPtr<ImageProcessor> &processor);
+    // processors running frames of all streams
+    bool add_shared_processor (const SmartPtr<ImageProcessor> &processor);
+    // stats sink of @stream_id, e.g. for VirtualV4l2Device::set_stats_callback,
+    // required before start if the stream has an analyzer
+    StatsCallback *get_stats_callback (uint32_t stream_id);
+    bool set_poll_thread_attributes (const ThreadAttributes &attrs);
+
+    uint32_t get_stream_count () const {
+        return _streams.size ();
+    }
+    bool is_running () const {
+        return _is_running;
+    }
+
+    XCamReturn start ();
+    XCamReturn stop ();
+
+    // counters of all streams, fps and counters summed
+    void get_metrics (PipelineMetrics &metrics);
+    void get_stream_metrics (uint32_t stream_id, PipelineMetrics &metrics);
+
+protected:
+    // called on shared workers, frames of different streams may run concurrently
+    virtual void handle_buffer (uint32_t stream_id, const SmartPtr<VideoBuffer> &buf) = 0;
+
+    //virtual functions derived from ImageProcessCallback, for shared processors
+    virtual void process_buffer_done (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf);
+
+private:
+    MultiStream *get_stream (uint32_t stream_id);
+    void stream_buffer_done (const SmartPtr<VideoBuffer> &buf);
+    XCamReturn start_stream (MultiStream *stream);
+    XCamReturn start_poll ();
+    void stop_poll ();
+    XCamReturn poll_loop ();
+    bool arm_stream_fd (MultiStream *stream, bool arm);
+
+    XCAM_DEAD_COPY (MultiStreamManager);
+
+private:
+    std::vector<SmartPtr<MultiStream> >   _streams;
+    SmartPtr<X3aImageProcessCenter>       _shared_center;
+    std::vector<SmartPtr<ImageProcessor> > _shared_processors;
+    bool                                  _has_shared_processors;
+    bool                                  _is_running;
+
+    SmartPtr<MultiStreamPollThread>       _poll_thread;
+    int                                   _epoll_fd;
+    int                                   _wakeup_fd;
+    uint32_t                              _polled_streams;  // streams waited on by epoll
+    Mutex                                 _metrics_mutex;   // stream poll threads created and released
+};
+
+};
+
+#endif //XCAM_MULTI_STREAM_MANAGER_H
@@ -0,0 +1,111 @@
+/*
+ * pipeline_metrics.h - runtime metrics of capture pipeline
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_PIPELINE_METRICS_H
+#define XCAM_PIPELINE_METRICS_H
+
+#include "xcam_utils.h"
+#include "buffer_pool.h"
+#include <vector>
+
+#define XCAM_METRICS_NAME_SIZE 48
+
+namespace XCam {
+
+struct QueueMetrics {
+    char       name[XCAM_METRICS_NAME_SIZE];   // "<owner>.<queue>"
+    uint32_t   depth;
+    uint64_t   dropped;   // frames dropped by backpressure policy
+};
+
+struct PoolMetrics {
+    char       name[XCAM_METRICS_NAME_SIZE];
+    uint32_t   allocated;
+    uint32_t   in_flight;
+    uint32_t   peak_in_flight;
+    uint64_t   waits;
+};
+
+struct HandlerMetrics {
+    char       name[XCAM_METRICS_NAME_SIZE];
+    uint64_t   executions;
+    int64_t    mean_time;     // microseconds
+    int64_t    max_time;
+};
+
+/*
+ * snapshot of pipeline counters, counters are totals since start,
+ * times in microseconds
+ */
+struct PipelineMetrics {
+    double                       capture_fps;
+    uint64_t                     captured_frames;
+    uint64_t                     dequeue_failures;
+
+    uint64_t                     stats_in;        // 3a stats queued to analyzer
+    uint64_t                     stats_dropped;   // 3a stats lost on full analyzer queue
+    uint64_t                     stats_skipped;   // 3a stats coalesced or expired in analyzer
+    uint64_t                     stats_analyzed;
+    int64_t                      analyze_mean_time;
+    int64_t                      analyze_max_time;
+    uint64_t                     stamp_overflows; // frames with stamps dropped, latency stages incomplete
+
+    std::vector<QueueMetrics>    queues;
+    std::vector<PoolMetrics>     pools;
+    std::vector<HandlerMetrics>  handlers;
+
+    PipelineMetrics ()
+        : capture_fps (0.0)
+        , captured_frames (0)
+        , dequeue_failures (0)
+        , stats_in (0)
+        , stats_dropped (0)
+        , stats_skipped (0)
+        , stats_analyzed (0)
+        , analyze_mean_time (0)
+        , analyze_max_time (0)
+        , stamp_overflows (0)
+    {}
+
+    void add_queue (const char *owner, const char *queue, uint32_t depth, uint64_t dropped = 0) {
+        QueueMetrics metrics;
+        snprintf (metrics.name, sizeof (metrics.name), "%s.%s", XCAM_STR (owner), queue);
+        metrics.depth = depth;
+        metrics.dropped = dropped;
+        queues.push_back (metrics);
+    }
+
+    void add_pool (const char *name, BufferPool &pool) {
+        PoolMetrics metrics;
+        BufferPoolStats stats;
+        pool.get_stats (stats);
+        strncpy (metrics.name, XCAM_STR (name), sizeof (metrics.name) - 1);
+        metrics.name[sizeof (metrics.name) - 1] = '\0';
+        metrics.allocated = stats.allocated;
+        metrics.in_flight = stats.in_flight;
+        metrics.peak_in_flight = stats.peak_in_flight;
+        metrics.waits = stats.waits;
+        pools.push_back (metrics);
+    }
+};
+
+};
+
+#endif //XCAM_PIPELINE_METRICS_H
@@ -22,6 +22,13 @@
 #include "xcam_thread.h"
 #include "x3a_statistics_queue.h"
 #include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define XCAM_POLL_EPOLL_MAX_EVENTS    4
+#define XCAM_POLL_MAX_DRAIN_BUFFERS   32
+#define XCAM_POLL_ERROR_BACKOFF       10000  // us, capture fd disarmed after error
 
 namespace XCam {
 
@@ -77,15 +84,55 @@ private:
     PollThread   *_poll;
 };
 
+class EpollPollThread
+    : public Thread
+{
+public:
+    EpollPollThread (PollThread *poll)
+        : Thread ("epoll")
+        , _poll (poll)
+    {}
+
+protected:
+    virtual bool started () {
+        if (_poll->_event_dev.ptr () &&
+                _poll->init_3a_stats_pool () != XCAM_RETURN_NO_ERROR)
+            return false;
+        return true;
+    }
+    virtual bool loop () {
+        XCamReturn ret = _poll->epoll_loop ();
+
+        if (ret == XCAM_RETURN_NO_ERROR || ret == XCAM_RETURN_ERROR_TIMEOUT)
+            return true;
+        return false;
+    }
+
+private:
+    PollThread   *_poll;
+};
+
 const int PollThread::default_subdev_event_timeout = 100; // ms
 const int PollThread::default_capture_event_timeout = 100; // ms
 
 PollThread::PollThread ()
-    : _poll_callback (NULL)
+    : _poll_mode (POLL_MODE_THREADS)
+    , _epoll_running (false)
+    , _epoll_fd (-1)
+    , _wakeup_fd (-1)
+    , _capture_rearm_time (0)
+    , _stats_pool_ready (false)
+    , _poll_callback (NULL)
     , _stats_callback (NULL)
+    , _captured_frames (0)
+    , _dequeue_failures (0)
+    , _capture_fps (0.0)
+    , _fps_window_start (0)
+    , _fps_window_frames (0)
 {
     _event_loop = new EventPollThread(this);
     _capture_loop = new CapturePollThread (this);
+    _epoll_loop = new EpollPollThread (this);
 
     XCAM_LOG_DEBUG ("PollThread constructed");
 }
@@ -138,10 +185,56 @@ PollThread::set_stats_callback (StatsCallback *callback)
     return true;
 }
 
+bool
+PollThread::set_poll_mode (PollMode mode)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !_epoll_running && !_capture_loop->is_running (), false,
+        "poll thread set poll mode failed since started");
+    _poll_mode = mode;
+    return true;
+}
 
-XCamReturn PollThread::start ()
+bool
+PollThread::set_capture_thread_attributes (const ThreadAttributes &attrs)
+{
+    return _capture_loop->set_attributes (attrs) && _epoll_loop->set_attributes (attrs);
+}
+
+bool
+PollThread::set_event_thread_attributes (const ThreadAttributes &attrs)
+{
+    return _event_loop->set_attributes (attrs);
+}
+
+
+XCamReturn
+PollThread::prepare ()
 {
     _3a_stats_pool = new X3aStatisticsQueue;
+    if (!_event_dev.ptr ())
+        return XCAM_RETURN_NO_ERROR;
+    return init_3a_stats_pool ();
+}
+
+XCamReturn PollThread::start ()
+{
+    if (!_stats_pool_ready)
+        _3a_stats_pool = new X3aStatisticsQueue;
+
+    if (_poll_mode == POLL_MODE_EPOLL) {
+        if (init_epoll ()) {
+            _epoll_running = true;
+            if (!_epoll_loop->start ()) {
+                _epoll_running = false;
+                deinit_epoll ();
+                return XCAM_RETURN_ERROR_THREAD;
+            }
+            return XCAM_RETURN_NO_ERROR;
+        }
+        XCAM_LOG_WARNING ("poll thread init epoll failed, fall back to poll threads");
+    }
+
     if (_event_dev.ptr () && !_event_loop->start ()) {
         return XCAM_RETURN_ERROR_THREAD;
     }
@@ -157,11 +250,21 @@ XCamReturn PollThread::stop ()
     if (_3a_stats_pool.ptr ())
         _3a_stats_pool->stop ();
 
+    if (_epoll_running) {
+        uint64_t value = 1;
+        // epoll thread blocks without timeout, wake it up
+        if (write (_wakeup_fd, &value, sizeof (value)) != sizeof (value))
+            XCAM_LOG_WARNING ("poll thread wakeup failed: %s", strerror (errno));
+        _epoll_loop->stop ();
+        deinit_epoll ();
+        _epoll_running = false;
+    }
     _event_loop->stop ();
     _capture_loop->stop ();
 
     // can't release now, stats buffer may still in use
     //_3a_stats_pool.release ();
+    _stats_pool_ready = false;
     return XCAM_RETURN_NO_ERROR;
 }
 
@@ -171,6 +274,12 @@ PollThread::init_3a_stats_pool ()
     XCamReturn ret = XCAM_RETURN_NO_ERROR;
     struct atomisp_parm parameters;
 
+    if (_stats_pool_ready)
+        return XCAM_RETURN_NO_ERROR;
+
+    XCAM_FAIL_RETURN (
+        ERROR, _isp_controller.ptr (), XCAM_RETURN_ERROR_PARAM,
+        "poll thread has event device but no isp controller");
     xcam_mem_clear (parameters);
     ret = _isp_controller->get_isp_parameter (parameters);
     if (ret != XCAM_RETURN_NO_ERROR ) {
@@ -182,10 +291,12 @@ PollThread::init_3a_stats_pool ()
         return XCAM_RETURN_ERROR_ISP;
     }
     _3a_stats_pool.dynamic_cast_ptr<X3aStatisticsQueue>()->set_grid_info (parameters.info);
+    _3a_stats_pool->set_thread_cache (2);
     if (!_3a_stats_pool->reserve (6)) {
         XCAM_LOG_WARNING ("init_3a_stats_pool failed to reserve stats buffer.");
         return XCAM_RETURN_ERROR_MEM;
     }
+    _stats_pool_ready = true;
     return XCAM_RETURN_NO_ERROR;
 }
 
@@ -284,12 +395,61 @@ PollThread::poll_subdev_event_loop ()
     return ret;
 }
 
+// dequeue until no event pending
 XCamReturn
-PollThread::poll_buffer_loop ()
+PollThread::dequeue_subdev_events ()
 {
     XCamReturn ret = XCAM_RETURN_NO_ERROR;
+    struct v4l2_event event;
+
+    do {
+        xcam_mem_clear (event);
+        ret = _event_dev->dequeue_event (event);
+        if (ret != XCAM_RETURN_NO_ERROR) {
+            XCAM_LOG_WARNING ("dequeue event failed on dev:%s", XCAM_STR(_event_dev->get_device_name()));
+            return XCAM_RETURN_ERROR_IOCTL;
+        }
+
+        ret = handle_events (event);
+        if (ret != XCAM_RETURN_NO_ERROR)
+            XCAM_LOG_WARNING ("handle event(type:0x%x) failed but continue", event.type);
+    } while (event.pending > 0);
+
+    return XCAM_RETURN_NO_ERROR;
+}
+
+// fps over windows of XCAM_POLL_FPS_WINDOW, only called in capture thread
+void
+PollThread::count_captured_frame ()
+{
+    int64_t now = xcam_get_monotonic_time ();
+
+    ++_captured_frames;
+    ++_fps_window_frames;
+    if (!_fps_window_start) {
+        _fps_window_start = now;
+        _fps_window_frames = 0;
+    } else if (now - _fps_window_start >= XCAM_POLL_FPS_WINDOW) {
+        _capture_fps = _fps_window_frames * 1000000.0 / (now - _fps_window_start);
+        _fps_window_start = now;
+        _fps_window_frames = 0;
+    }
+}
+
+void
+PollThread::get_metrics (PipelineMetrics &metrics)
+{
+    metrics.capture_fps = _capture_fps.load ();
+    metrics.captured_frames = _captured_frames.load ();
+    metrics.dequeue_failures = _dequeue_failures.load ();
+    if (_3a_stats_pool.ptr ())
+        metrics.add_pool ("3a_stats", *_3a_stats_pool.ptr ());
+}
+
+XCamReturn
+PollThread::poll_buffer_loop ()
+{
     int poll_ret = 0;
-    SmartPtr<V4l2Buffer> buf;
 
     poll_ret = _capture_dev->poll_event (PollThread::default_capture_event_timeout);
 
@@ -305,15 +465,27 @@ PollThread::poll_buffer_loop ()
         return XCAM_RETURN_ERROR_TIMEOUT;
     }
 
+    return dequeue_capture_buffer ();
+}
+
+XCamReturn
+PollThread::dequeue_capture_buffer ()
+{
+    XCamReturn ret = XCAM_RETURN_NO_ERROR;
+    SmartPtr<V4l2Buffer> buf;
+
     ret = _capture_dev->dequeue_buffer (buf);
     if (ret != XCAM_RETURN_NO_ERROR) {
+        ++_dequeue_failures;
         XCAM_LOG_WARNING ("capture buffer failed");
         return ret;
     }
+    count_captured_frame ();
     XCAM_ASSERT (buf.ptr());
     XCAM_ASSERT (_poll_callback);
 
-    SmartPtr<V4l2BufferProxy> buf_proxy = new V4l2BufferProxy (buf, _capture_dev);
+    SmartPtr<V4l2BufferProxy> buf_proxy = make_smart<V4l2BufferProxy> (buf, _capture_dev);
+    buf_proxy->add_stamp (XCAM_STAMP_DEQUEUE);
 
     if (_poll_callback)
         return _poll_callback->poll_buffer_ready (buf_proxy);
@@ -321,4 +493,151 @@ PollThread::poll_buffer_loop ()
     return ret;
 }
 
+// ready buffers at most XCAM_POLL_MAX_DRAIN_BUFFERS, first one known ready
+XCamReturn
+PollThread::drain_capture_buffers ()
+{
+    XCamReturn ret = XCAM_RETURN_NO_ERROR;
+
+    for (uint32_t i = 0; i < XCAM_POLL_MAX_DRAIN_BUFFERS; ++i) {
+        if (i > 0 && _capture_dev->poll_event (0) <= 0)
+            break;
+        ret = dequeue_capture_buffer ();
+        if (ret != XCAM_RETURN_NO_ERROR)
+            return ret;
+    }
+    return XCAM_RETURN_NO_ERROR;
+}
+
+bool
+PollThread::arm_capture_fd (bool arm)
+{
+    struct epoll_event event;
+
+    xcam_mem_clear (event);
+    event.events = arm ? (uint32_t) EPOLLIN : 0;
+    event.data.fd = _capture_dev->get_fd ();
+    if (epoll_ctl (_epoll_fd, EPOLL_CTL_MOD, event.data.fd, &event) != 0) {
+        XCAM_LOG_WARNING ("poll thread %s capture fd failed: %s", arm ? "arm" : "disarm", strerror (errno));
+        return false;
+    }
+    return true;
+}
+
+bool
+PollThread::init_epoll ()
+{
+    struct epoll_event event;
+
+    XCAM_ASSERT (_epoll_fd == -1 && _wakeup_fd == -1);
+    _epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    _wakeup_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_epoll_fd == -1 || _wakeup_fd == -1) {
+        XCAM_LOG_WARNING ("poll thread create epoll fd failed: %s", strerror (errno));
+        deinit_epoll ();
+        return false;
+    }
+
+    xcam_mem_clear (event);
+    event.events = EPOLLIN;
+    event.data.fd = _wakeup_fd;
+    if (epoll_ctl (_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &event) != 0)
+        goto failed;
+
+    // regular file of virtual device fails with EPERM
+    event.events = EPOLLIN;
+    event.data.fd = _capture_dev->get_fd ();
+    if (epoll_ctl (_epoll_fd, EPOLL_CTL_ADD, event.data.fd, &event) != 0)
+        goto failed;
+
+    // v4l2 events are signaled as exceptions
+    if (_event_dev.ptr ()) {
+        event.events = EPOLLPRI;
+        event.data.fd = _event_dev->get_fd ();
+        if (epoll_ctl (_epoll_fd, EPOLL_CTL_ADD, event.data.fd, &event) != 0)
+            goto failed;
+    }
+
+    _capture_rearm_time = 0;
+    return true;
+
+failed:
+    XCAM_LOG_WARNING ("poll thread add fd(%d) to epoll failed: %s", event.data.fd, strerror (errno));
+    deinit_epoll ();
+    return false;
+}
+
+void
+PollThread::deinit_epoll ()
+{
+    if (_epoll_fd != -1)
+        ::close (_epoll_fd);
+    if (_wakeup_fd != -1)
+        ::close (_wakeup_fd);
+    _epoll_fd = -1;
+    _wakeup_fd = -1;
+}
+
+/*
+ * one wakeup handles every ready device, all pending events and buffers.
+ * on capture errors the capture fd is disarmed for XCAM_POLL_ERROR_BACKOFF,
+ * events and stop still served meanwhile.
+ */
+XCamReturn
+PollThread::epoll_loop ()
+{
+    struct epoll_event events[XCAM_POLL_EPOLL_MAX_EVENTS];
+    int timeout_msec = -1;
+    int count = 0;
+
+    if (_capture_rearm_time) {
+        int64_t wait_time = _capture_rearm_time - xcam_get_monotonic_time ();
+        if (wait_time <= 0) {
+            if (arm_capture_fd (true))
+                _capture_rearm_time = 0;
+            else
+                _capture_rearm_time = xcam_get_monotonic_time () + XCAM_POLL_ERROR_BACKOFF;
+            return XCAM_RETURN_NO_ERROR;
+        }
+        timeout_msec = (wait_time + 999) / 1000;
+    }
+
+    count = epoll_wait (_epoll_fd, events, XCAM_POLL_EPOLL_MAX_EVENTS, timeout_msec);
+    if (count < 0) {
+        if (errno == EINTR)
+            return XCAM_RETURN_NO_ERROR;
+        XCAM_LOG_ERROR ("epoll wait failed: %s", strerror (errno));
+        return XCAM_RETURN_ERROR_UNKNOWN;
+    }
+    if (count == 0)
+        return XCAM_RETURN_ERROR_TIMEOUT;
+
+    for (int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+
+        if (fd == _wakeup_fd)
+            return XCAM_RETURN_BYPASS;
+
+        if (_event_dev.ptr () && fd == _event_dev->get_fd ()) {
+            if (events[i].events & EPOLLPRI)
+                dequeue_subdev_events ();
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                XCAM_LOG_WARNING ("poll event got error, stop polling dev:%s", XCAM_STR(_event_dev->get_device_name()));
+                epoll_ctl (_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            }
+            continue;
+        }
+
+        XCAM_ASSERT (fd == _capture_dev->get_fd ());
+        if ((events[i].events & (EPOLLERR | EPOLLHUP)) ||
+                drain_capture_buffers () != XCAM_RETURN_NO_ERROR) {
+            XCAM_LOG_DEBUG ("poll buffer event got error but continue");
+            if (arm_capture_fd (false))
+                _capture_rearm_time = xcam_get_monotonic_time () + XCAM_POLL_ERROR_BACKOFF;
+        }
+    }
+
+    return XCAM_RETURN_NO_ERROR;
+}
+
 };
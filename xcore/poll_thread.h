@@ -23,15 +23,25 @@
 
 #include "xcam_utils.h"
 #include "xcam_mutex.h"
+#include "xcam_thread.h"
 #include "x3a_event.h"
 #include "v4l2_buffer_proxy.h"
 #include "x3a_stats_pool.h"
 #include "v4l2_device.h"
 #include "isp_controller.h"
 #include "stats_callback_interface.h"
+#include "pipeline_metrics.h"
+#include <atomic>
+
+#define XCAM_POLL_FPS_WINDOW (1000000) // 1 second
 
 namespace XCam {
 
+enum PollMode {
+    POLL_MODE_THREADS = 0,  // one thread per device, polled with timeout
+    POLL_MODE_EPOLL,        // single epoll thread for both devices, woken up on stop
+};
+
 class X3aStats;
 
 class PollCallback
@@ -52,11 +62,13 @@ class V4l2SubDevice;
 class X3aStatisticsQueue;
 class EventPollThread;
 class CapturePollThread;
+class EpollPollThread;
 
 class PollThread
 {
     friend class EventPollThread;
     friend class CapturePollThread;
+    friend class EpollPollThread;
 public:
     explicit PollThread ();
     ~PollThread ();
@@ -66,13 +78,24 @@ public:
     bool set_isp_controller (SmartPtr<IspController>  &isp);
     bool set_poll_callback (PollCallback *callback);
     bool set_stats_callback (StatsCallback *callback);
-
+    // must be called before start
+    bool set_poll_mode (PollMode mode);
+    // also applied to the epoll thread
+    bool set_capture_thread_attributes (const ThreadAttributes &attrs);
+    bool set_event_thread_attributes (const ThreadAttributes &attrs);
+
+    // optional before start, allocates 3a stats pool ahead once devices started
+    XCamReturn prepare ();
     XCamReturn start();
     XCamReturn stop ();
 
+    // capture rate and counters, 3a stats pool occupancy
+    void get_metrics (PipelineMetrics &metrics);
+
 protected:
     XCamReturn poll_subdev_event_loop ();
     XCamReturn poll_buffer_loop ();
+    XCamReturn epoll_loop ();
 
     XCamReturn handle_events (struct v4l2_event &event);
     XCamReturn handle_3a_stats_event (struct v4l2_event &event);
@@ -80,7 +103,13 @@ protected:
 private:
     XCamReturn init_3a_stats_pool ();
     XCamReturn capture_3a_stats (SmartPtr<X3aStats> &stats);
-
+    void count_captured_frame ();
+    XCamReturn dequeue_capture_buffer ();
+    XCamReturn dequeue_subdev_events ();
+    XCamReturn drain_capture_buffers ();
+    bool init_epoll ();
+    void deinit_epoll ();
+    bool arm_capture_fd (bool arm);
 
 private:
     XCAM_DEAD_COPY (PollThread);
@@ -91,6 +120,14 @@ private:
 
     SmartPtr<EventPollThread>        _event_loop;
     SmartPtr<CapturePollThread>      _capture_loop;
+    SmartPtr<EpollPollThread>        _epoll_loop;
+
+    PollMode                         _poll_mode;
+    bool                             _epoll_running;
+    int                              _epoll_fd;
+    int                              _wakeup_fd;
+    int64_t                          _capture_rearm_time;  // capture fd disarmed after error until then
+    bool                             _stats_pool_ready;
 
     SmartPtr<V4l2SubDevice>          _event_dev;
     SmartPtr<X3aStatsPool>           _3a_stats_pool;
@@ -100,6 +137,12 @@ private:
 
     PollCallback                    *_poll_callback;
     StatsCallback                   *_stats_callback;
+
+    std::atomic<uint64_t>            _captured_frames;
+    std::atomic<uint64_t>            _dequeue_failures;
+    std::atomic<double>              _capture_fps;
+    int64_t                          _fps_window_start;
+    uint64_t                         _fps_window_frames;
 };
 
 };
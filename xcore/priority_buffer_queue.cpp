@@ -19,6 +19,8 @@
  */
 
 #include "priority_buffer_queue.h"
+#include "xcam_trace.h"
+#include <algorithm>
 
 #define XCAM_PRIORITY_BUFFER_FIXED_DELAY 6
 
@@ -36,25 +38,156 @@ PriorityBuffer::priority_less_than (const PriorityBuffer& buf) const
     return result > 0;
 }
 
+PriorityBufferQueue::PriorityBufferQueue (PriorityPolicy policy)
+    : _policy (policy)
+    , _served_arrival (0)
+    , _push_count (0)
+    , _pop_paused (false)
+{
+}
 
 bool
-PriorityBufferQueue::push_priority_buf (const SmartPtr<PriorityBuffer> &buf)
+PriorityBufferQueue::higher_priority (const PriorityBuffer &buf, const PriorityBuffer &other) const
+{
+    switch (_policy) {
+    case PRIORITY_POLICY_FIXED_DELAY:
+        if (buf.priority_less_than (other))
+            return true;
+        if (other.priority_less_than (buf))
+            return false;
+        break;
+    case PRIORITY_POLICY_DEADLINE:
+        if (buf.deadline != other.deadline)
+            return buf.deadline < other.deadline;
+        // same frame, nearly done one first
+        if (buf.rank != other.rank)
+            return buf.rank > other.rank;
+        break;
+    case PRIORITY_POLICY_STREAM_FIFO:
+        // n-th frame of every stream before (n+1)-th of any, backlog of one stream won't delay others
+        if (buf.arrival != other.arrival)
+            return buf.arrival < other.arrival;
+        if (buf.stream_id != other.stream_id)
+            return buf.stream_id < other.stream_id;
+        break;
+    }
+
+    return buf.push_order < other.push_order;
+}
+
+void
+PriorityBufferQueue::set_policy (PriorityPolicy policy)
+{
+    SmartLock lock (_mutex);
+    _policy = policy;
+    std::sort (_buffers.begin (), _buffers.end (), LowerPriority (this));
+}
+
+void
+PriorityBufferQueue::set_latency_budget (uint32_t stream_id, int64_t budget)
 {
-    XCAM_ASSERT (buf.ptr ());
     SmartLock lock (_mutex);
+    if (stream_id >= _latency_budgets.size ())
+        _latency_budgets.resize (stream_id + 1, XCAM_PRIORITY_DEFAULT_LATENCY_BUDGET);
+    _latency_budgets[stream_id] = budget;
+}
 
-    ObjList::iterator iter = _obj_list.begin ();
+int64_t
+PriorityBufferQueue::get_latency_budget (uint32_t stream_id) const
+{
+    if (stream_id < _latency_budgets.size ())
+        return _latency_budgets[stream_id];
+    return XCAM_PRIORITY_DEFAULT_LATENCY_BUDGET;
+}
+
+bool
+PriorityBufferQueue::push_priority_buf (const PriorityBufPtr &buf)
+{
+    XCAM_ASSERT (buf.ptr ());
+    SmartLock lock (_mutex);
 
-    for (; iter != _obj_list.end (); ++iter) {
-        SmartPtr<PriorityBuffer> &current = *iter;
-        XCAM_ASSERT (current.ptr ());
-        if (buf->priority_less_than (*current.ptr()))
-            break;
+    // first push of a frame, later ranks keep its place.
+    // deadline on monotonic clock, capture timestamps may come from another one
+    if (!buf->arrival) {
+        if (buf->stream_id >= _stream_arrivals.size ())
+            _stream_arrivals.resize (buf->stream_id + 1, 0);
+        // new or idle stream joins at current round instead of getting a burst
+        uint64_t &arrival = _stream_arrivals[buf->stream_id];
+        arrival = XCAM_MAX (arrival + 1, _served_arrival);
+        buf->arrival = arrival;
+        buf->deadline = xcam_get_monotonic_time () + get_latency_budget (buf->stream_id);
     }
+    buf->push_order = ++_push_count;
 
-    _obj_list.insert (iter, buf);
+    _buffers.insert (
+        std::upper_bound (_buffers.begin (), _buffers.end (), buf, LowerPriority (this)),
+        buf);
     _new_obj_cond.signal ();
     return true;
 }
 
+PriorityBufferQueue::PriorityBufPtr
+PriorityBufferQueue::pop (int32_t timeout)
+{
+    SmartLock lock (_mutex);
+    PriorityBufPtr buf;
+
+    if (_pop_paused)
+        return NULL;
+
+    if (_buffers.empty () && timeout != 0) {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_QUEUE, "priority_queue_wait");
+        if (timeout < 0)
+            _new_obj_cond.wait (_mutex);
+        else
+            _new_obj_cond.timedwait (_mutex, timeout);
+    }
+
+    if (_buffers.empty () || _pop_paused) {
+        XCAM_LOG_DEBUG ("priority buffer queue pop failed");
+        return NULL;
+    }
+
+    buf = std::move (_buffers.back ());
+    _buffers.pop_back ();
+    _served_arrival = buf->arrival;
+    return buf;
+}
+
+uint32_t
+PriorityBufferQueue::size ()
+{
+    SmartLock lock (_mutex);
+    return _buffers.size ();
+}
+
+bool
+PriorityBufferQueue::is_empty ()
+{
+    SmartLock lock (_mutex);
+    return _buffers.empty ();
+}
+
+void
+PriorityBufferQueue::pause_pop ()
+{
+    SmartLock lock (_mutex);
+    _pop_paused = true;
+    _new_obj_cond.broadcast ();
+}
+
+void
+PriorityBufferQueue::resume_pop ()
+{
+    SmartLock lock (_mutex);
+    _pop_paused = false;
+}
+
+void
+PriorityBufferQueue::clear ()
+{
+    SmartLock lock (_mutex);
+    _buffers.clear ();
+}
+
 };
@@ -22,23 +22,46 @@
 #define XCAM_PRIORITY_BUFFER_QUEUE_H
 
 #include "xcam_utils.h"
-#include "safe_list.h"
+#include "xcam_mutex.h"
 #include "drm_bo_buffer.h"
 #include "cl_image_handler.h"
+#include <vector>
+
+#define XCAM_PRIORITY_DEFAULT_LATENCY_BUDGET 33333 // us, one frame at 30fps
 
 namespace XCam {
 
+enum PriorityPolicy {
+    // seq_num * fixed delay + rank, later handlers of old frames first
+    PRIORITY_POLICY_FIXED_DELAY = 0,
+    // earliest deadline first, deadline is first push time + latency budget of its stream
+    PRIORITY_POLICY_DEADLINE,
+    // each stream strictly FIFO, streams take turns by their own arrival count
+    PRIORITY_POLICY_STREAM_FIFO,
+};
+
 struct PriorityBuffer
+    : public RefObj
 {
     SmartPtr<DrmBoBuffer>     data;
     SmartPtr<CLImageHandler>  handler;
     uint32_t                  rank;
     uint32_t                  seq_num;
+    uint32_t                  stream_id;
+
+    // set by PriorityBufferQueue on first push, arrival counted per stream
+    uint64_t                  arrival;
+    int64_t                   deadline;
+    uint64_t                  push_order;
 
 public:
     PriorityBuffer ()
         : rank (0)
         , seq_num (0)
+        , stream_id (0)
+        , arrival (0)
+        , deadline (0)
+        , push_order (0)
     {}
 
     void set_seq_num (const uint32_t value) {
@@ -56,18 +79,66 @@ public:
     bool priority_less_than (const PriorityBuffer& buf) const;
 };
 
+/*
+ * PriorityBufferQueue, vector sorted by selected policy, highest priority at back.
+ * pop takes the back, push binary searches its place; re-pushed buffers
+ * of the running frame land near the back, so little is moved.
+ * Equal priorities pop in push order.
+ */
 class PriorityBufferQueue
-    : public SafeList<PriorityBuffer>
 {
-public:
+    typedef SmartPtr<PriorityBuffer> PriorityBufPtr;
 
-    PriorityBufferQueue () {}
+public:
+    explicit PriorityBufferQueue (PriorityPolicy policy = PRIORITY_POLICY_FIXED_DELAY);
     ~PriorityBufferQueue () {}
 
-    bool push_priority_buf (const SmartPtr<PriorityBuffer> &buf);
+    void set_policy (PriorityPolicy policy);
+    PriorityPolicy get_policy () const {
+        return _policy;
+    }
+    // latency budget of @stream_id in microseconds, used by PRIORITY_POLICY_DEADLINE
+    void set_latency_budget (uint32_t stream_id, int64_t budget);
+
+    bool push_priority_buf (const PriorityBufPtr &buf);
+    /*
+     * timeout, -1,  wait until wakeup
+     *         >=0,  wait for @timeout microsseconds
+     */
+    PriorityBufPtr pop (int32_t timeout = -1);
+
+    uint32_t size ();
+    bool is_empty ();
+    void pause_pop ();
+    void resume_pop ();
+    void clear ();
 
 private:
+    bool higher_priority (const PriorityBuffer &buf, const PriorityBuffer &other) const;
+    int64_t get_latency_budget (uint32_t stream_id) const;
     XCAM_DEAD_COPY (PriorityBufferQueue);
+
+private:
+    // sort compare, true when @buf pops after @other
+    class LowerPriority {
+    public:
+        explicit LowerPriority (const PriorityBufferQueue *queue) : _queue (queue) {}
+        bool operator () (const PriorityBufPtr &buf, const PriorityBufPtr &other) const {
+            return _queue->higher_priority (*other.ptr (), *buf.ptr ());
+        }
+    private:
+        const PriorityBufferQueue *_queue;
+    };
+
+    Mutex                          _mutex;
+    Cond                           _new_obj_cond;
+    std::vector<PriorityBufPtr>    _buffers;
+    PriorityPolicy                 _policy;
+    std::vector<int64_t>           _latency_budgets;
+    std::vector<uint64_t>          _stream_arrivals;
+    uint64_t                       _served_arrival;
+    uint64_t                       _push_count;
+    bool                           _pop_paused;
 };
 
 };
@@ -0,0 +1,142 @@
+/*
+ * record_writer.h - queue and writer thread shared by recorders
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_RECORD_WRITER_H
+#define XCAM_RECORD_WRITER_H
+
+#include "xcam_utils.h"
+#include "xcam_thread.h"
+#include "ring_queue.h"
+#include <inttypes.h>
+#include <atomic>
+
+#define XCAM_RECORD_WRITER_POP_TIMEOUT        100000  // us
+#define XCAM_RECORD_WRITER_DROP_LOG_INTERVAL  30
+
+namespace XCam {
+
+template<class Record>
+class RecordSink {
+public:
+    virtual ~RecordSink () {}
+
+    // on writer thread, or caller of RecordWriter::stop for records left
+    virtual bool write_record (const SmartPtr<Record> &record) = 0;
+    // no record within XCAM_RECORD_WRITER_POP_TIMEOUT
+    virtual void writer_idle () {}
+};
+
+/*
+ * RecordWriter, push () queues records without blocking, a dedicated thread
+ * hands them to the sink. Records are dropped and counted when the queue is full,
+ * the sink counts its write failures with count_dropped () too.
+ * Queue lives until destruction, push () racing with stop () stays safe.
+ */
+template<class Record>
+class RecordWriter {
+    class WriterThread
+        : public Thread
+    {
+    public:
+        WriterThread (const char *name, RecordWriter *writer)
+            : Thread (name)
+            , _writer (writer)
+        {}
+
+    protected:
+        virtual bool loop () {
+            SmartPtr<Record> record = _writer->_queue.pop (XCAM_RECORD_WRITER_POP_TIMEOUT);
+
+            if (record.ptr ())
+                _writer->_sink->write_record (record);
+            else
+                _writer->_sink->writer_idle ();
+            return true;
+        }
+
+    private:
+        RecordWriter   *_writer;
+    };
+
+public:
+    // @name, thread name and log prefix; @path, only for logs
+    RecordWriter (const char *name, const char *path, uint32_t queue_size, RecordSink<Record> *sink)
+        : _name (name)
+        , _path (path)
+        , _sink (sink)
+        , _queue (queue_size)
+        , _dropped (0)
+    {
+        XCAM_ASSERT (name && path && sink);
+        _thread = new WriterThread (name, this);
+    }
+
+    // records of last run dropped, drop count reset
+    bool start () {
+        _queue.clear ();
+        _dropped = 0;
+        return _thread->start ();
+    }
+    // records still queued written in caller thread
+    void stop () {
+        SmartPtr<Record> record;
+
+        _queue.wakeup ();
+        _thread->stop ();
+        while ((record = _queue.pop (0)).ptr ())
+            _sink->write_record (record);
+    }
+
+    // check before preparing a record dropped anyway
+    bool is_full () {
+        return _queue.size () >= _queue.capacity ();
+    }
+    bool push (SmartPtr<Record> &&record) {
+        if (!_queue.push (std::move (record))) {
+            count_dropped ();
+            return false;
+        }
+        return true;
+    }
+
+    void count_dropped () {
+        uint64_t dropped = ++_dropped;
+        if (dropped == 1 || dropped % XCAM_RECORD_WRITER_DROP_LOG_INTERVAL == 0)
+            XCAM_LOG_WARNING ("%s(%s) can't keep up, %" PRIu64 " dropped", _name, _path, dropped);
+    }
+    uint64_t get_dropped () const {
+        return _dropped.load ();
+    }
+
+private:
+    XCAM_DEAD_COPY (RecordWriter);
+
+private:
+    const char                  *_name;
+    const char                  *_path;
+    RecordSink<Record>          *_sink;
+    MpmcRingQueue<Record>        _queue;
+    SmartPtr<WriterThread>       _thread;
+    std::atomic<uint64_t>        _dropped;
+};
+
+};
+
+#endif //XCAM_RECORD_WRITER_H
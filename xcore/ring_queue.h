@@ -0,0 +1,386 @@
+/*
+ * ring_queue.h - bounded lock-free ring queue templates
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_RING_QUEUE_H
+#define XCAM_RING_QUEUE_H
+
+#include <base/xcam_defs.h>
+#include <base/xcam_common.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+#include "smartptr.h"
+#include "xcam_trace.h"
+
+#define XCAM_CACHE_LINE_SIZE 64
+#define XCAM_RING_QUEUE_DEFAULT_SIZE 32
+#define XCAM_RING_QUEUE_SPIN_COUNT 256
+
+namespace XCam {
+
+/*
+ * RingQueueWaiter, event count used by ring queues to sleep on empty.
+ * consumer: key = prepare_wait (); re-check queue; wait (key, timeout);
+ * producer: publish object; notify ();
+ */
+class RingQueueWaiter {
+public:
+    RingQueueWaiter ()
+        : _seq (0)
+        , _waiters (0)
+    {}
+
+    uint32_t prepare_wait () {
+        _waiters.fetch_add (1);
+        return _seq.load ();
+    }
+    void cancel_wait () {
+        _waiters.fetch_sub (1);
+    }
+
+    /*
+     * timeout, -1,  wait until notified
+     *         >=0,  wait for @timeout microseconds
+     * return 0 on wakeup, ETIMEDOUT on timeout
+     */
+    int wait (uint32_t key, int32_t timeout) {
+        struct timespec ts;
+        struct timespec *pts = NULL;
+        int ret = 0;
+
+        if (timeout >= 0) {
+            ts.tv_sec = timeout / 1000000;
+            ts.tv_nsec = (timeout % 1000000) * 1000;
+            pts = &ts;
+        }
+        if (syscall (SYS_futex, (uint32_t *)&_seq, FUTEX_WAIT_PRIVATE, key, pts, NULL, 0) != 0 &&
+                errno == ETIMEDOUT)
+            ret = ETIMEDOUT;
+        _waiters.fetch_sub (1);
+        return ret;
+    }
+
+    void notify () {
+        _seq.fetch_add (1);
+        if (_waiters.load ())
+            syscall (SYS_futex, (uint32_t *)&_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+
+private:
+    XCAM_DEAD_COPY (RingQueueWaiter);
+
+private:
+    std::atomic<uint32_t>  _seq;
+    std::atomic<uint32_t>  _waiters;
+};
+
+inline void
+xcam_cpu_relax ()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause ();
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+inline uint32_t
+xcam_ring_queue_round_up (uint32_t size)
+{
+    uint32_t cap = 2;
+    while (cap < size)
+        cap <<= 1;
+    return cap;
+}
+
+/*
+ * RingQueueBase, common pop/wait/pause logic shared by ring queues
+ * Queue must provide try_push/try_pop/size.
+ * API and pop timeout/pause semantics are same as SafeList,
+ * except push returns false when queue is full.
+ */
+template<class OBj, class Queue>
+class RingQueueBase {
+public:
+    typedef SmartPtr<OBj> ObjPtr;
+
+    RingQueueBase ()
+        : _pop_paused (false)
+    {}
+
+    /*
+     * timeout, -1,  wait until wakeup
+     *         >=0,  wait for @timeout microsseconds
+    */
+    inline ObjPtr pop (int32_t timeout = -1);
+    inline bool push (const ObjPtr &obj);
+    // move @obj into queue, @obj is kept if queue is full
+    inline bool push (ObjPtr &&obj);
+
+    bool is_empty () {
+        return static_cast<Queue*>(this)->size () == 0;
+    }
+    void wakeup () {
+        _waiter.notify ();
+    }
+    void pause_pop () {
+        _pop_paused.store (true);
+        wakeup ();
+    }
+    void resume_pop () {
+        _pop_paused.store (false);
+    }
+    void clear () {
+        ObjPtr obj;
+        while (static_cast<Queue*>(this)->try_pop (obj))
+            obj.release ();
+    }
+
+private:
+    RingQueueWaiter        _waiter;
+    std::atomic<bool>      _pop_paused;
+};
+
+template<class OBj, class Queue>
+typename RingQueueBase<OBj, Queue>::ObjPtr
+RingQueueBase<OBj, Queue>::pop (int32_t timeout)
+{
+    Queue *queue = static_cast<Queue*>(this);
+    ObjPtr obj;
+    int code = 0;
+
+    if (_pop_paused.load ())
+        return NULL;
+
+    if (queue->try_pop (obj))
+        return obj;
+    if (!timeout)
+        return NULL;
+
+    for (uint32_t i = 0; i < XCAM_RING_QUEUE_SPIN_COUNT; ++i) {
+        xcam_cpu_relax ();
+        if (queue->try_pop (obj))
+            return obj;
+    }
+
+    uint32_t key = _waiter.prepare_wait ();
+    if (queue->try_pop (obj) || _pop_paused.load ()) {
+        _waiter.cancel_wait ();
+        return obj;
+    }
+    {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_QUEUE, "ring_queue_wait");
+        code = _waiter.wait (key, timeout);
+    }
+
+    if (_pop_paused.load () || !queue->try_pop (obj)) {
+        if (code == ETIMEDOUT) {
+            XCAM_LOG_DEBUG ("ring queue pop timeout");
+        } else {
+            XCAM_LOG_DEBUG ("ring queue pop failed");
+        }
+        return NULL;
+    }
+    return obj;
+}
+
+template<class OBj, class Queue>
+bool
+RingQueueBase<OBj, Queue>::push (const ObjPtr &obj)
+{
+    if (!static_cast<Queue*>(this)->try_push (obj)) {
+        XCAM_LOG_DEBUG ("ring queue push failed, queue full");
+        return false;
+    }
+    _waiter.notify ();
+    return true;
+}
+
+template<class OBj, class Queue>
+bool
+RingQueueBase<OBj, Queue>::push (ObjPtr &&obj)
+{
+    if (!static_cast<Queue*>(this)->try_push (std::move (obj))) {
+        XCAM_LOG_DEBUG ("ring queue push failed, queue full");
+        return false;
+    }
+    _waiter.notify ();
+    return true;
+}
+
+/*
+ * SpscRingQueue, single producer and single consumer
+ * push must be called in one thread, pop/clear in another thread.
+ */
+template<class OBj>
+class SpscRingQueue
+    : public RingQueueBase<OBj, SpscRingQueue<OBj> >
+{
+    friend class RingQueueBase<OBj, SpscRingQueue<OBj> >;
+public:
+    typedef SmartPtr<OBj> ObjPtr;
+
+    explicit SpscRingQueue (uint32_t size = XCAM_RING_QUEUE_DEFAULT_SIZE)
+        : _head (0)
+        , _tail (0)
+    {
+        _capacity = xcam_ring_queue_round_up (size);
+        _slots = new ObjPtr[_capacity];
+    }
+    ~SpscRingQueue () {
+        delete [] _slots;
+    }
+
+    uint32_t size () {
+        return _tail.load (std::memory_order_acquire) - _head.load (std::memory_order_acquire);
+    }
+    uint32_t capacity () const {
+        return _capacity;
+    }
+
+private:
+    template <typename ObjRef>
+    bool try_push (ObjRef &&obj) {
+        uint32_t tail = _tail.load (std::memory_order_relaxed);
+        if (tail - _head.load (std::memory_order_acquire) >= _capacity)
+            return false;
+        _slots[tail & (_capacity - 1)] = std::forward<ObjRef> (obj);
+        _tail.store (tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_pop (ObjPtr &obj) {
+        uint32_t head = _head.load (std::memory_order_relaxed);
+        if (head == _tail.load (std::memory_order_acquire))
+            return false;
+        obj = std::move (_slots[head & (_capacity - 1)]);
+        _head.store (head + 1, std::memory_order_release);
+        return true;
+    }
+
+    XCAM_DEAD_COPY (SpscRingQueue);
+
+private:
+    std::atomic<uint32_t>  _head;
+    char                   _head_pad[XCAM_CACHE_LINE_SIZE - sizeof (std::atomic<uint32_t>)];
+    std::atomic<uint32_t>  _tail;
+    char                   _tail_pad[XCAM_CACHE_LINE_SIZE - sizeof (std::atomic<uint32_t>)];
+    uint32_t               _capacity;
+    ObjPtr                *_slots;
+};
+
+/*
+ * MpmcRingQueue, multiple producers, bounded sequence-per-slot queue
+ * pop is also safe from multiple threads, so clear can be called from
+ * another thread while consumer thread is stopping.
+ */
+template<class OBj>
+class MpmcRingQueue
+    : public RingQueueBase<OBj, MpmcRingQueue<OBj> >
+{
+    friend class RingQueueBase<OBj, MpmcRingQueue<OBj> >;
+
+    struct Slot {
+        std::atomic<uint32_t>  seq;
+        SmartPtr<OBj>          obj;
+    };
+
+public:
+    typedef SmartPtr<OBj> ObjPtr;
+
+    explicit MpmcRingQueue (uint32_t size = XCAM_RING_QUEUE_DEFAULT_SIZE)
+        : _head (0)
+        , _tail (0)
+    {
+        _capacity = xcam_ring_queue_round_up (size);
+        _slots = new Slot[_capacity];
+        for (uint32_t i = 0; i < _capacity; ++i)
+            _slots[i].seq.store (i, std::memory_order_relaxed);
+    }
+    ~MpmcRingQueue () {
+        delete [] _slots;
+    }
+
+    uint32_t size () {
+        int32_t count =
+            (int32_t)(_tail.load (std::memory_order_acquire) - _head.load (std::memory_order_acquire));
+        return count > 0 ? (uint32_t)count : 0;
+    }
+    uint32_t capacity () const {
+        return _capacity;
+    }
+
+private:
+    template <typename ObjRef>
+    bool try_push (ObjRef &&obj) {
+        uint32_t pos = _tail.load (std::memory_order_relaxed);
+        Slot *slot = NULL;
+
+        while (true) {
+            slot = &_slots[pos & (_capacity - 1)];
+            int32_t diff = (int32_t)(slot->seq.load (std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else
+                pos = _tail.load (std::memory_order_relaxed);
+        }
+        slot->obj = std::forward<ObjRef> (obj);
+        slot->seq.store (pos + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_pop (ObjPtr &obj) {
+        uint32_t pos = _head.load (std::memory_order_relaxed);
+        Slot *slot = NULL;
+
+        while (true) {
+            slot = &_slots[pos & (_capacity - 1)];
+            int32_t diff = (int32_t)(slot->seq.load (std::memory_order_acquire) - (pos + 1));
+            if (diff == 0) {
+                if (_head.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else
+                pos = _head.load (std::memory_order_relaxed);
+        }
+        obj = std::move (slot->obj);
+        slot->seq.store (pos + _capacity, std::memory_order_release);
+        return true;
+    }
+
+    XCAM_DEAD_COPY (MpmcRingQueue);
+
+private:
+    std::atomic<uint32_t>  _head;
+    char                   _head_pad[XCAM_CACHE_LINE_SIZE - sizeof (std::atomic<uint32_t>)];
+    std::atomic<uint32_t>  _tail;
+    char                   _tail_pad[XCAM_CACHE_LINE_SIZE - sizeof (std::atomic<uint32_t>)];
+    uint32_t               _capacity;
+    Slot                  *_slots;
+};
+
+};
+#endif //XCAM_RING_QUEUE_H
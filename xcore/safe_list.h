@@ -27,6 +27,7 @@
 #include <list>
 #include "smartptr.h"
 #include "xcam_mutex.h"
+#include "xcam_trace.h"
 
 namespace XCam {
 
@@ -48,6 +49,10 @@ public:
     */
     inline ObjPtr pop (int32_t timeout = -1);
     inline bool push (const ObjPtr &obj);
+    // move out up to @max objects without waiting, return number of objects got
+    inline uint32_t pop_batch (ObjPtr *objs, uint32_t max);
+    // move in @count objects under one lock
+    inline void push_batch (ObjPtr *objs, uint32_t count);
     uint32_t size () {
         SmartLock lock(_mutex);
         return _obj_list.size();
@@ -88,7 +93,10 @@ SafeList<OBj>::pop (int32_t timeout)
     if (_pop_paused)
         return NULL;
 
-    if (_obj_list.empty()) {
+    if (_obj_list.empty() && timeout == 0) {
+        code = ETIMEDOUT;
+    } else if (_obj_list.empty()) {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_QUEUE, "safe_list_wait");
         if (timeout < 0)
             code = _new_obj_cond.wait(_mutex);
         else
@@ -104,7 +112,7 @@ SafeList<OBj>::pop (int32_t timeout)
         return NULL;
     }
 
-    SafeList<OBj>::ObjPtr obj = *_obj_list.begin ();
+    SafeList<OBj>::ObjPtr obj = std::move (*_obj_list.begin ());
     _obj_list.erase (_obj_list.begin ());
     return obj;
 }
@@ -119,6 +127,37 @@ SafeList<OBj>::push (const SafeList<OBj>::ObjPtr &obj)
     return true;
 }
 
+template<class OBj>
+uint32_t
+SafeList<OBj>::pop_batch (SafeList<OBj>::ObjPtr *objs, uint32_t max)
+{
+    uint32_t count = 0;
+    SmartLock lock (_mutex);
+
+    if (_pop_paused)
+        return 0;
+
+    for (; count < max && !_obj_list.empty (); ++count) {
+        objs[count] = std::move (*_obj_list.begin ());
+        _obj_list.erase (_obj_list.begin ());
+    }
+    return count;
+}
+
+template<class OBj>
+void
+SafeList<OBj>::push_batch (SafeList<OBj>::ObjPtr *objs, uint32_t count)
+{
+    if (!count)
+        return;
+
+    SmartLock lock (_mutex);
+    for (uint32_t i = 0; i < count; ++i) {
+        _obj_list.push_back (std::move (objs[i]));
+    }
+    _new_obj_cond.broadcast ();
+}
+
 template<class OBj>
 void SafeList<OBj>::clear ()
 {
@@ -35,7 +35,10 @@ ScaledVideoBuffer::get_scaled_buffer (XCamVideoBuffer& buffer)
     SmartPtr<BufferData> data = get_buffer_data ();
     XCAM_ASSERT(data.ptr());
 
+    // mapping is kept by data, only sync per frame
     buffer.data = data->map ();
+    data->sync_for_cpu ();
+    data->unmap ();
     buffer.info = _video_info;
     buffer.timestamp = get_timestamp ();
 
@@ -22,37 +22,92 @@
 
 #include <stdint.h>
 #include <atomic>
+#include <utility>
 #include <base/xcam_defs.h>
 
 namespace XCam {
 
+#if ENABLE_PROFILING
+#define XCAM_REF_COUNT_PROFILING ++RefCount::thread_rmw_count ()
+#else
+#define XCAM_REF_COUNT_PROFILING
+#endif
+
 class RefCount {
 public:
-    RefCount (): _ref_count(1) {}
+    RefCount (): _ref_count(1), _embedded (false) {}
     void ref() {
+        XCAM_REF_COUNT_PROFILING;
         ++_ref_count;
     }
     uint32_t unref() {
+        XCAM_REF_COUNT_PROFILING;
         return --_ref_count;
     }
+    bool is_embedded () const {
+        return _embedded;
+    }
+    // out of line, so compiler won't see embedded counts reaching delete
+    static void __attribute__ ((noinline)) destroy (RefCount *ref) {
+        XCAM_ASSERT (!ref->is_embedded ());
+        delete ref;
+    }
+#if ENABLE_PROFILING
+    // atomic read-modify-write operations on counts done by calling thread
+    static uint64_t &thread_rmw_count () {
+        static __thread uint64_t count = 0;
+        return count;
+    }
+#endif
+
+protected:
+    explicit RefCount (uint32_t count, bool embedded)
+        : _ref_count (count)
+        , _embedded (embedded)
+    {}
+
 private:
     mutable std::atomic<uint32_t> _ref_count;
+    bool                          _embedded;
 };
 
+/*
+ * RefObj, base class of objects which carry their own reference count.
+ * SmartPtr uses the embedded count instead of allocating a RefCount,
+ * so wrapping a RefObj (e.g. by make_smart) costs only one allocation.
+ * The count starts from 0 and is increased by every SmartPtr taking the object.
+ * Destructor is virtual, so any RefObj can be held as SmartPtr<RefObj>.
+ */
+class RefObj
+    : public RefCount
+{
+public:
+    virtual ~RefObj () {}
+
+protected:
+    RefObj () : RefCount (0, true) {}
+    RefObj (const RefObj &) : RefCount (0, true) {}
+    RefObj & operator = (const RefObj &) {
+        return *this;
+    }
+};
+
+template <typename Obj> class BorrowedPtr;
 
 template <typename Obj>
 class SmartPtr {
 private:
     template<typename ObjDerive> friend class SmartPtr;
+    template<typename ObjDerive> friend class BorrowedPtr;
 public:
     SmartPtr (Obj *obj = NULL) : _ptr (obj), _ref(NULL) {
         if (_ptr)
-            _ref = new RefCount();
+            _ref = new_ref_count (obj);
     }
     template <typename ObjDerive>
     SmartPtr (ObjDerive *obj) : _ptr (obj), _ref(NULL) {
         if (_ptr)
-            _ref = new RefCount();
+            _ref = new_ref_count (obj);
     }
 
     // copy from pointer
@@ -67,34 +122,63 @@ public:
         if (_ptr)
             _ref->ref();
     }
+
+    // move from pointer, no reference count change
+    SmartPtr (SmartPtr<Obj> &&obj)
+        : _ptr(obj._ptr), _ref(obj._ref)  {
+        obj._ptr = NULL;
+        obj._ref = NULL;
+    }
+    template <typename ObjDerive>
+    SmartPtr (SmartPtr<ObjDerive> &&obj)
+        : _ptr(obj._ptr), _ref(obj._ref)  {
+        obj._ptr = NULL;
+        obj._ref = NULL;
+    }
     ~SmartPtr () {
         release();
     }
 
     /* operator = */
     SmartPtr<Obj> & operator = (Obj *obj) {
-        release ();
-        new_pointer (obj, NULL);
+        SmartPtr<Obj> tmp (obj);
+        swap (tmp);
         return *this;
     }
     template <typename ObjDerive>
     SmartPtr<Obj> & operator = (ObjDerive *obj) {
-        release ();
-        new_pointer (obj, NULL);
+        SmartPtr<Obj> tmp (obj);
+        swap (tmp);
         return *this;
     }
     SmartPtr<Obj> & operator = (const SmartPtr<Obj> &obj) {
-        release ();
-        new_pointer (obj._ptr, obj._ref);
+        SmartPtr<Obj> tmp (obj);
+        swap (tmp);
         return *this;
     }
     template <typename ObjDerive>
     SmartPtr<Obj> & operator = (const SmartPtr<ObjDerive> &obj) {
-        release ();
-        new_pointer (obj._ptr, obj._ref);
+        SmartPtr<Obj> tmp (obj);
+        swap (tmp);
+        return *this;
+    }
+    SmartPtr<Obj> & operator = (SmartPtr<Obj> &&obj) {
+        SmartPtr<Obj> tmp (std::move (obj));
+        swap (tmp);
+        return *this;
+    }
+    template <typename ObjDerive>
+    SmartPtr<Obj> & operator = (SmartPtr<ObjDerive> &&obj) {
+        SmartPtr<Obj> tmp (std::move (obj));
+        swap (tmp);
         return *this;
     }
 
+    void swap (SmartPtr<Obj> &obj) {
+        std::swap (_ptr, obj._ptr);
+        std::swap (_ref, obj._ref);
+    }
+
     Obj *operator -> () const {
         return _ptr;
     }
@@ -108,7 +192,8 @@ public:
             return;
         XCAM_ASSERT (_ref);
         if (!_ref->unref()) {
-            delete _ref;
+            if (!_ref->is_embedded ())
+                RefCount::destroy (_ref);
             delete _ptr;
         }
         _ptr = NULL;
@@ -127,18 +212,45 @@ public:
         ret.new_pointer (obj_derive, _ref);
         return ret;
     }
+
+    // caller knows the real type, no RTTI
+    template <typename ObjDerive>
+    SmartPtr<ObjDerive> static_cast_ptr () const {
+        SmartPtr<ObjDerive> ret(NULL);
+        if (!_ref)
+            return ret;
+        ret.new_pointer (static_cast<ObjDerive*>(_ptr), _ref);
+        return ret;
+    }
 private:
     void new_pointer (Obj *obj, RefCount *ref) {
         if (!obj) {
             _ptr = NULL;
             _ref = NULL;
+            return;
         }
         _ptr = obj;
         if (ref) {
             _ref = ref;
             _ref->ref();
         } else
-            _ref = new RefCount();
+            _ref = new_ref_count (obj);
+    }
+
+    // overload resolution prefers RefObj* to void* for objects derived from RefObj
+    static RefCount *new_ref_count (RefObj *obj) {
+#if XCAM_SEPARATE_REF_COUNT
+        // measurement build, RefObj counted like any other object
+        XCAM_UNUSED (obj);
+        return new RefCount ();
+#else
+        obj->ref ();
+        return obj;
+#endif
+    }
+    static RefCount *new_ref_count (void *obj) {
+        XCAM_UNUSED (obj);
+        return new RefCount ();
     }
 
 private:
@@ -147,5 +259,59 @@ private:
     mutable RefCount *_ref;
 };
 
+template <typename Obj>
+inline void swap (SmartPtr<Obj> &obj1, SmartPtr<Obj> &obj2)
+{
+    obj1.swap (obj2);
+}
+
+/*
+ * BorrowedPtr, non-owning view of object held by SmartPtr,
+ * passed by value as function parameter without touching reference count.
+ * Caller must keep the owning SmartPtr alive during the call,
+ * call share () to keep the object beyond that.
+ */
+template <typename Obj>
+class BorrowedPtr {
+private:
+    template<typename ObjDerive> friend class BorrowedPtr;
+public:
+    BorrowedPtr () : _ptr (NULL), _ref (NULL) {}
+    template <typename ObjDerive>
+    BorrowedPtr (const SmartPtr<ObjDerive> &obj)
+        : _ptr (obj._ptr), _ref (obj._ref) {}
+    template <typename ObjDerive>
+    BorrowedPtr (const BorrowedPtr<ObjDerive> &obj)
+        : _ptr (obj._ptr), _ref (obj._ref) {}
+
+    Obj *operator -> () const {
+        return _ptr;
+    }
+
+    Obj *ptr() const {
+        return _ptr;
+    }
+
+    SmartPtr<Obj> share () const {
+        SmartPtr<Obj> ret;
+        ret.new_pointer (_ptr, _ref);
+        return ret;
+    }
+
+private:
+    Obj       *_ptr;
+    RefCount  *_ref;
+};
+
+/*
+ * make_smart, allocate object and wrap it into SmartPtr,
+ * objects derived from RefObj take one allocation instead of two.
+ */
+template <typename Obj, typename... Args>
+SmartPtr<Obj> make_smart (Args&&... args)
+{
+    return SmartPtr<Obj> (new Obj (std::forward<Args> (args)...));
+}
+
 }; // end namespace
 #endif //XCAM_SMARTPTR_H
\ No newline at end of file
@@ -0,0 +1,154 @@
+/*
+ * startup_graph.cpp - concurrent startup steps ordered by dependencies
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "startup_graph.h"
+#include "xcam_trace.h"
+
+namespace XCam {
+
+StartupStep::StartupStep (const char *name)
+    : Thread (name)
+    , _graph (NULL)
+    , _deps (0)
+{
+    xcam_mem_clear (_stats);
+    strncpy (_stats.name, XCAM_STR (name), XCAM_STARTUP_NAME_SIZE - 1);
+    _stats.ret = XCAM_RETURN_BYPASS;
+}
+
+bool
+StartupStep::loop ()
+{
+    int64_t start_time = xcam_get_monotonic_time ();
+
+    {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_PROCESSOR, _stats.name);
+        _stats.ret = execute ();
+    }
+    _stats.start = start_time - _graph->_start_time;
+    _stats.duration = xcam_get_monotonic_time () - start_time;
+
+    _graph->step_done (this);
+    // one run per step
+    return false;
+}
+
+StartupGraph::~StartupGraph ()
+{
+    for (uint32_t i = 0; i < _steps.size (); ++i)
+        _steps[i]->stop ();
+}
+
+int
+StartupGraph::add_step (const SmartPtr<StartupStep> &step, uint32_t deps)
+{
+    XCAM_ASSERT (step.ptr ());
+    XCAM_FAIL_RETURN (
+        WARNING,
+        _steps.size () < XCAM_STARTUP_MAX_STEPS,
+        -1,
+        "startup graph add step(%s) failed, at most %d steps", step->_stats.name, XCAM_STARTUP_MAX_STEPS);
+    XCAM_FAIL_RETURN (
+        WARNING,
+        !(deps >> _steps.size ()),
+        -1,
+        "startup graph add step(%s) failed, depends on steps not added yet", step->_stats.name);
+
+    step->_graph = this;
+    step->_deps = deps;
+    _steps.push_back (step);
+    return _steps.size () - 1;
+}
+
+XCamReturn
+StartupGraph::run ()
+{
+    SmartLock lock (_mutex);
+
+    _start_time = xcam_get_monotonic_time ();
+    _started_mask = 0;
+    _done_mask = 0;
+    _running = 0;
+    _ret = XCAM_RETURN_NO_ERROR;
+    for (uint32_t i = 0; i < _steps.size (); ++i) {
+        _steps[i]->_stats.start = 0;
+        _steps[i]->_stats.duration = 0;
+        _steps[i]->_stats.ret = XCAM_RETURN_BYPASS;
+    }
+
+    start_ready_steps ();
+    while (_running)
+        _done_cond.wait (_mutex);
+
+    return _ret;
+}
+
+void
+StartupGraph::start_ready_steps ()
+{
+    for (uint32_t i = 0; i < _steps.size () && _ret == XCAM_RETURN_NO_ERROR; ++i) {
+        SmartPtr<StartupStep> &step = _steps[i];
+
+        if ((_started_mask & XCAM_STARTUP_DEP (i)) || (step->_deps & ~_done_mask))
+            continue;
+
+        _started_mask |= XCAM_STARTUP_DEP (i);
+        ++_running;
+        if (!step->start ()) {
+            --_running;
+            step->_stats.ret = XCAM_RETURN_ERROR_THREAD;
+            _ret = XCAM_RETURN_ERROR_THREAD;
+        }
+    }
+}
+
+void
+StartupGraph::step_done (StartupStep *step)
+{
+    SmartLock lock (_mutex);
+
+    for (uint32_t i = 0; i < _steps.size (); ++i) {
+        if (_steps[i].ptr () == step) {
+            _done_mask |= XCAM_STARTUP_DEP (i);
+            break;
+        }
+    }
+    --_running;
+
+    if (step->_stats.ret != XCAM_RETURN_NO_ERROR) {
+        XCAM_LOG_WARNING ("startup step(%s) failed", step->_stats.name);
+        if (_ret == XCAM_RETURN_NO_ERROR)
+            _ret = step->_stats.ret;
+    }
+    start_ready_steps ();
+    _done_cond.broadcast ();
+}
+
+void
+StartupGraph::get_stats (StartupStatsList &stats)
+{
+    SmartLock lock (_mutex);
+
+    stats.resize (_steps.size ());
+    for (uint32_t i = 0; i < _steps.size (); ++i)
+        stats[i] = _steps[i]->_stats;
+}
+
+};
@@ -0,0 +1,142 @@
+/*
+ * startup_graph.h - concurrent startup steps ordered by dependencies
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_STARTUP_GRAPH_H
+#define XCAM_STARTUP_GRAPH_H
+
+#include "xcam_utils.h"
+#include "xcam_mutex.h"
+#include "xcam_thread.h"
+#include "smartptr.h"
+#include <vector>
+
+#define XCAM_STARTUP_MAX_STEPS      32
+#define XCAM_STARTUP_NAME_SIZE      32
+
+#define XCAM_STARTUP_DEP(step)      (1u << (step))
+
+namespace XCam {
+
+// timing of one step, in microseconds from start of run
+struct StartupStepStats {
+    char         name[XCAM_STARTUP_NAME_SIZE];
+    int64_t      start;
+    int64_t      duration;
+    XCamReturn   ret;       // XCAM_RETURN_BYPASS if not run after an earlier failure
+};
+
+typedef std::vector<StartupStepStats> StartupStatsList;
+
+class StartupGraph;
+
+class StartupStep
+    : public Thread
+{
+    friend class StartupGraph;
+
+public:
+    explicit StartupStep (const char *name);
+    virtual ~StartupStep () {}
+
+protected:
+    virtual XCamReturn execute () = 0;
+
+private:
+    virtual bool loop ();
+
+    XCAM_DEAD_COPY (StartupStep);
+
+private:
+    StartupGraph        *_graph;
+    uint32_t             _deps;
+    StartupStepStats     _stats;
+};
+
+template <class Owner>
+class MemberStartupStep
+    : public StartupStep
+{
+public:
+    typedef XCamReturn (Owner::*StepFunc) ();
+
+    MemberStartupStep (const char *name, Owner *owner, StepFunc func)
+        : StartupStep (name)
+        , _owner (owner)
+        , _func (func)
+    {}
+
+protected:
+    virtual XCamReturn execute () {
+        return (_owner->*_func) ();
+    }
+
+private:
+    Owner       *_owner;
+    StepFunc     _func;
+};
+
+/*
+ * StartupGraph, each step runs in its own short-lived thread once all
+ * steps of its dependency mask are done, independent steps run concurrently.
+ * Steps get their own threads rather than Executor workers since they may
+ * block on hardware, library loading or TaskThread::stop.
+ * After a failure no new step is started, running ones are waited for.
+ */
+class StartupGraph {
+    friend class StartupStep;
+
+public:
+    StartupGraph () {}
+    ~StartupGraph ();
+
+    // returns step index for XCAM_STARTUP_DEP, -1 on error
+    int add_step (const SmartPtr<StartupStep> &step, uint32_t deps = 0);
+
+    template <class Owner>
+    int add_step (
+        const char *name, Owner *owner, typename MemberStartupStep<Owner>::StepFunc func,
+        uint32_t deps = 0) {
+        return add_step (new MemberStartupStep<Owner> (name, owner, func), deps);
+    }
+
+    // first failed step return, XCAM_RETURN_NO_ERROR if all steps succeeded
+    XCamReturn run ();
+    void get_stats (StartupStatsList &stats);
+
+private:
+    void start_ready_steps ();
+    void step_done (StartupStep *step);
+
+    XCAM_DEAD_COPY (StartupGraph);
+
+private:
+    std::vector<SmartPtr<StartupStep> >  _steps;
+    Mutex                                _mutex;
+    Cond                                 _done_cond;
+    int64_t                              _start_time;
+    uint32_t                             _started_mask;
+    uint32_t                             _done_mask;
+    uint32_t                             _running;
+    XCamReturn                           _ret;
+};
+
+};
+
+#endif //XCAM_STARTUP_GRAPH_H
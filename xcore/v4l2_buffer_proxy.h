@@ -57,6 +57,10 @@ public:
         _buf.length = value;
     }
 
+    void set_userptr (uintptr_t ptr) {
+        _buf.m.userptr = ptr;
+    }
+
     void reset () {
         xcam_mem_clear (_buf.timestamp);
         xcam_mem_clear (_buf.timecode);
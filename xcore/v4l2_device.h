@@ -86,11 +86,11 @@ public:
     bool set_framerate (uint32_t n, uint32_t d);
     void get_framerate (uint32_t &n, uint32_t &d);
 
-    XCamReturn open ();
-    XCamReturn close ();
+    virtual XCamReturn open ();
+    virtual XCamReturn close ();
     // set_format
-    XCamReturn get_format (struct v4l2_format &format);
-    XCamReturn set_format (struct v4l2_format &format);
+    virtual XCamReturn get_format (struct v4l2_format &format);
+    virtual XCamReturn set_format (struct v4l2_format &format);
     XCamReturn set_format (
         uint32_t width, uint32_t height, uint32_t pixelformat,
         enum v4l2_field field = V4L2_FIELD_NONE, uint32_t bytes_perline = 0);
@@ -100,9 +100,9 @@ public:
     virtual XCamReturn start ();
     virtual XCamReturn stop ();
 
-    int poll_event (int timeout_msec);
-    XCamReturn dequeue_buffer (SmartPtr<V4l2Buffer> &buf);
-    XCamReturn queue_buffer (SmartPtr<V4l2Buffer> &buf);
+    virtual int poll_event (int timeout_msec);
+    virtual XCamReturn dequeue_buffer (SmartPtr<V4l2Buffer> &buf);
+    virtual XCamReturn queue_buffer (SmartPtr<V4l2Buffer> &buf);
 
     // use as less as possible
     int io_control (int cmd, void *arg);
@@ -288,4 +288,41 @@ VideoBufferInfo::get_planar_info (
     return true;
 }
 
+void
+VideoBuffer::add_stamp (const char *checkpoint)
+{
+    if (_stamp_count >= XCAM_VIDEO_BUFFER_MAX_STAMPS) {
+        // later stages stay unstamped rather than charged to a wrong stage
+        ++_stamp_overflow;
+        return;
+    }
+
+    _stamps[_stamp_count].checkpoint = checkpoint;
+    _stamps[_stamp_count].time = xcam_get_monotonic_time ();
+    ++_stamp_count;
+}
+
+void
+VideoBuffer::copy_stamps (const VideoBuffer &from)
+{
+    _stamp_count = from._stamp_count;
+    _stamp_overflow = from._stamp_overflow;
+    for (uint32_t i = 0; i < _stamp_count; ++i)
+        _stamps[i] = from._stamps[i];
+}
+
+void
+VideoBuffer::copy_metas (const VideoBuffer &from)
+{
+    for (uint32_t i = 0; i < VIDEO_BUFFER_META_COUNT; ++i)
+        _metas[i] = from._metas[i];
+}
+
+void
+VideoBuffer::clear_metas ()
+{
+    for (uint32_t i = 0; i < VIDEO_BUFFER_META_COUNT; ++i)
+        _metas[i].release ();
+}
+
 };
@@ -61,10 +61,55 @@ namespace XCam {
 #define XCAM_PIX_FMT_LAB    v4l2_fourcc('h', 'L', 'a', 'b')
 
 #define XCAM_VIDEO_MAX_COMPONENTS 4
+// fixed checkpoints below plus a wait and a done stamp per image handler
+#define XCAM_STAMP_FIXED_COUNT 8
+#define XCAM_STAMP_MAX_HANDLERS 28
+#define XCAM_VIDEO_BUFFER_MAX_STAMPS (XCAM_STAMP_FIXED_COUNT + 2 * XCAM_STAMP_MAX_HANDLERS)
+#define XCAM_STAMP_NAME_SIZE 32
+
+// frame checkpoints, a stamp names the pipeline stage ending there
+#define XCAM_STAMP_DEQUEUE        "dequeue"
+#define XCAM_STAMP_PROCESS_PUSH   "process_push"
+#define XCAM_STAMP_DONE_PUSH      "done_push"
+#define XCAM_STAMP_HANDLE_BUFFER  "handle_buffer"
+#define XCAM_STAMP_STATS_PUSH     "stats_push"
 
 class VideoBuffer;
 typedef std::list<SmartPtr<VideoBuffer>>  VideoBufferList;
 
+// per-frame side data slots, each holds one object of the noted type,
+// frame timing is kept in stamps
+enum VideoBufferMetaType {
+    VIDEO_BUFFER_META_3A_STATS = 0,   // X3aStats
+    VIDEO_BUFFER_META_ROI,            // VideoBufferRoi
+    VIDEO_BUFFER_META_COUNT,
+};
+
+struct VideoBufferRect {
+    uint32_t pos_x;
+    uint32_t pos_y;
+    uint32_t width;
+    uint32_t height;
+
+    VideoBufferRect ()
+        : pos_x (0), pos_y (0), width (0), height (0)
+    {}
+    VideoBufferRect (uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+        : pos_x (x), pos_y (y), width (w), height (h)
+    {}
+};
+
+// region of interest, a plain rect so the frame holds no reference to itself
+struct VideoBufferRoi
+    : public RefObj
+{
+    VideoBufferRect rect;
+
+    explicit VideoBufferRoi (const VideoBufferRect &roi)
+        : rect (roi)
+    {}
+};
+
 struct VideoBufferPlanarInfo {
     uint32_t width;
     uint32_t height;
@@ -97,20 +142,40 @@ struct VideoBufferInfo {
         VideoBufferPlanarInfo &planar, const uint32_t index = 0) const;
 };
 
-class VideoBuffer {
+struct VideoBufferStamp {
+    const char  *checkpoint;  // not copied, must outlive the pipeline
+    int64_t      time;        // monotonic, in microseconds
+};
+
+class VideoBuffer
+    : public RefObj
+{
 public:
     explicit VideoBuffer (int64_t timestamp = InvalidTimestamp)
         : _timestamp (timestamp)
+        , _stream_id (0)
+        , _stamp_count (0)
+        , _stamp_overflow (0)
     {}
     explicit VideoBuffer (const VideoBufferInfo &info, int64_t timestamp = InvalidTimestamp)
         : _videoinfo (info)
         , _timestamp (timestamp)
+        , _stream_id (0)
+        , _stamp_count (0)
+        , _stamp_overflow (0)
     {}
     virtual ~VideoBuffer () {}
 
     virtual uint8_t *map () = 0;
     virtual bool unmap () = 0;
     virtual int get_fd () = 0;
+    // see BufferData, mapping may be kept across map/unmap
+    virtual bool sync_for_cpu () {
+        return true;
+    }
+    virtual bool sync_for_device () {
+        return true;
+    }
 
     const VideoBufferInfo & get_video_info () const {
         return _videoinfo;
@@ -130,9 +195,50 @@ public:
     uint32_t get_size () const {
         return _videoinfo.size;
     }
+
+    // camera the frame comes from, 0 for single stream pipelines
+    uint32_t get_stream_id () const {
+        return _stream_id;
+    }
+    void set_stream_id (uint32_t stream_id) {
+        _stream_id = stream_id;
+    }
+
+    // stamp current time at @checkpoint, when full the stamp is dropped and counted
+    void add_stamp (const char *checkpoint);
+    // take stamps of the buffer this one is derived from
+    void copy_stamps (const VideoBuffer &from);
+    const VideoBufferStamp *get_stamps (uint32_t &count) const {
+        count = _stamp_count;
+        return _stamps;
+    }
+    // stamps dropped since array was full
+    uint32_t get_stamp_overflow () const {
+        return _stamp_overflow;
+    }
+
+    void set_meta (VideoBufferMetaType type, const SmartPtr<RefObj> &meta) {
+        XCAM_ASSERT (type < VIDEO_BUFFER_META_COUNT);
+        _metas[type] = meta;
+    }
+    // @Meta must be the type noted on @type
+    template <typename Meta>
+    SmartPtr<Meta> get_meta (VideoBufferMetaType type) const {
+        XCAM_ASSERT (type < VIDEO_BUFFER_META_COUNT);
+        return _metas[type].static_cast_ptr<Meta> ();
+    }
+    // share metas of the buffer this one is derived from
+    void copy_metas (const VideoBuffer &from);
+    void clear_metas ();
+
 private:
-    VideoBufferInfo _videoinfo;
-    int64_t         _timestamp; // in microseconds
+    VideoBufferInfo   _videoinfo;
+    int64_t           _timestamp; // in microseconds
+    uint32_t          _stream_id;
+    uint32_t          _stamp_count;
+    uint32_t          _stamp_overflow;
+    VideoBufferStamp  _stamps[XCAM_VIDEO_BUFFER_MAX_STAMPS];
+    SmartPtr<RefObj>  _metas[VIDEO_BUFFER_META_COUNT];
 };
 
 };
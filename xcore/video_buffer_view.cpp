@@ -0,0 +1,180 @@
+/*
+ * video_buffer_view.cpp - region view of video buffer
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "video_buffer_view.h"
+
+namespace XCam {
+
+// planar info keeps full width for interleaved chroma, horizontal subsampling comes from format
+static uint32_t
+get_chroma_x_alignment (uint32_t format)
+{
+    switch (format) {
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_YUYV:
+        return 2;
+    default:
+        break;
+    }
+    return 1;
+}
+
+VideoBufferView::VideoBufferView (const SmartPtr<VideoBuffer> &parent, const VideoBufferRect &rect)
+    : VideoBuffer (parent.ptr () ? parent->get_timestamp () : InvalidTimestamp)
+    , _rect (rect)
+{
+    XCAM_ASSERT (parent.ptr ());
+    if (!parent.ptr () || !init_view_info (parent->get_video_info ()))
+        return;
+
+    _parent = parent;
+    set_stream_id (parent->get_stream_id ());
+    copy_stamps (*parent.ptr ());
+    copy_metas (*parent.ptr ());
+}
+
+bool
+VideoBufferView::init_view_info (const VideoBufferInfo &parent_info)
+{
+    VideoBufferInfo info = parent_info;
+    uint32_t x_alignment = get_chroma_x_alignment (parent_info.format);
+
+    XCAM_FAIL_RETURN (
+        WARNING,
+        _rect.width && _rect.height &&
+        _rect.pos_x + _rect.width <= parent_info.width &&
+        _rect.pos_y + _rect.height <= parent_info.height,
+        false,
+        "VideoBufferView rect(%d, %d, %dx%d) out of parent(%dx%d)",
+        _rect.pos_x, _rect.pos_y, _rect.width, _rect.height,
+        parent_info.width, parent_info.height);
+    XCAM_FAIL_RETURN (
+        WARNING,
+        _rect.pos_x % x_alignment == 0 && _rect.width % x_alignment == 0,
+        false,
+        "VideoBufferView rect(%d, %d, %dx%d) not aligned to chroma of %s",
+        _rect.pos_x, _rect.pos_y, _rect.width, _rect.height,
+        xcam_fourcc_to_string (parent_info.format));
+
+    for (uint32_t i = 0; i < parent_info.components; ++i) {
+        VideoBufferPlanarInfo planar;
+        uint32_t plane_x = 0, plane_y = 0;
+
+        if (!parent_info.get_planar_info (parent_info.format, parent_info.width, parent_info.height, planar, i))
+            return false;
+
+        // subsampled planes, rect must fall on whole chroma samples
+        XCAM_FAIL_RETURN (
+            WARNING,
+            (_rect.pos_y * planar.height) % parent_info.height == 0 &&
+            (_rect.height * planar.height) % parent_info.height == 0 &&
+            (_rect.pos_x * planar.width) % parent_info.width == 0 &&
+            (_rect.width * planar.width) % parent_info.width == 0,
+            false,
+            "VideoBufferView rect(%d, %d, %dx%d) not aligned to plane %d of %s",
+            _rect.pos_x, _rect.pos_y, _rect.width, _rect.height,
+            i, xcam_fourcc_to_string (parent_info.format));
+
+        plane_x = _rect.pos_x * planar.width / parent_info.width;
+        plane_y = _rect.pos_y * planar.height / parent_info.height;
+        info.offsets[i] = parent_info.offsets[i] + plane_y * parent_info.strides[i] + plane_x * planar.pixel_bytes;
+    }
+
+    info.width = _rect.width;
+    info.height = _rect.height;
+    info.aligned_width = _rect.width;
+    info.aligned_height = _rect.height;
+    set_video_info (info);
+    return true;
+}
+
+uint8_t *
+VideoBufferView::map ()
+{
+    XCAM_ASSERT (_parent.ptr ());
+    return _parent->map ();
+}
+
+bool
+VideoBufferView::unmap ()
+{
+    XCAM_ASSERT (_parent.ptr ());
+    return _parent->unmap ();
+}
+
+int
+VideoBufferView::get_fd ()
+{
+    XCAM_ASSERT (_parent.ptr ());
+    return _parent->get_fd ();
+}
+
+bool
+VideoBufferView::sync_for_cpu ()
+{
+    XCAM_ASSERT (_parent.ptr ());
+    return _parent->sync_for_cpu ();
+}
+
+bool
+VideoBufferView::sync_for_device ()
+{
+    XCAM_ASSERT (_parent.ptr ());
+    return _parent->sync_for_device ();
+}
+
+bool
+VideoBufferView::split_tiles (
+    const SmartPtr<VideoBuffer> &parent, uint32_t cols, uint32_t rows,
+    std::list<SmartPtr<VideoBufferView>> &tiles)
+{
+    XCAM_ASSERT (parent.ptr ());
+    const VideoBufferInfo &info = parent->get_video_info ();
+    // even tile sizes keep 4:2:0 chroma aligned
+    uint32_t tile_width = XCAM_ALIGN_DOWN (info.width / XCAM_MAX (cols, 1u), 2);
+    uint32_t tile_height = XCAM_ALIGN_DOWN (info.height / XCAM_MAX (rows, 1u), 2);
+
+    XCAM_FAIL_RETURN (
+        WARNING,
+        cols && rows && tile_width && tile_height,
+        false,
+        "VideoBufferView can't split %dx%d into %dx%d tiles", info.width, info.height, cols, rows);
+
+    for (uint32_t row = 0; row < rows; ++row) {
+        for (uint32_t col = 0; col < cols; ++col) {
+            VideoBufferRect rect (col * tile_width, row * tile_height, tile_width, tile_height);
+            if (col == cols - 1)
+                rect.width = info.width - rect.pos_x;
+            if (row == rows - 1)
+                rect.height = info.height - rect.pos_y;
+
+            SmartPtr<VideoBufferView> tile = new VideoBufferView (parent, rect);
+            XCAM_FAIL_RETURN (
+                WARNING,
+                tile->is_valid (),
+                false,
+                "VideoBufferView tile(%d, %d) invalid", col, row);
+            tiles.push_back (tile);
+        }
+    }
+    return true;
+}
+
+};
@@ -0,0 +1,77 @@
+/*
+ * video_buffer_view.h - region view of video buffer
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_VIDEO_BUFFER_VIEW_H
+#define XCAM_VIDEO_BUFFER_VIEW_H
+
+#include "xcam_utils.h"
+#include "video_buffer.h"
+
+namespace XCam {
+
+/*
+ * VideoBufferView, a rectangle of parent buffer without copy.
+ * Video info keeps parent strides, offsets point to the rectangle
+ * inside parent memory, so plane i of the view starts at
+ * map () + get_video_info ().offsets[i] with parent stride.
+ * map/unmap go to parent, balance them as on any buffer.
+ * Rectangle must be aligned to chroma subsampling, check is_valid ().
+ */
+class VideoBufferView
+    : public VideoBuffer
+{
+public:
+    explicit VideoBufferView (const SmartPtr<VideoBuffer> &parent, const VideoBufferRect &rect);
+    virtual ~VideoBufferView () {}
+
+    bool is_valid () const {
+        return _parent.ptr () != NULL;
+    }
+    const SmartPtr<VideoBuffer> &get_parent () const {
+        return _parent;
+    }
+    const VideoBufferRect &get_rect () const {
+        return _rect;
+    }
+
+    // derived from VideoBuffer
+    virtual uint8_t *map ();
+    virtual bool unmap ();
+    virtual int get_fd ();
+    virtual bool sync_for_cpu ();
+    virtual bool sync_for_device ();
+
+    // split @parent into @cols x @rows tiles, edge tiles take the remainder
+    static bool split_tiles (
+        const SmartPtr<VideoBuffer> &parent, uint32_t cols, uint32_t rows,
+        std::list<SmartPtr<VideoBufferView>> &tiles);
+
+private:
+    bool init_view_info (const VideoBufferInfo &parent_info);
+    XCAM_DEAD_COPY (VideoBufferView);
+
+private:
+    SmartPtr<VideoBuffer>    _parent;
+    VideoBufferRect          _rect;
+};
+
+};
+
+#endif //XCAM_VIDEO_BUFFER_VIEW_H
@@ -0,0 +1,628 @@
+/*
+ * virtual_v4l2_device.cpp - file backed virtual capture device
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "virtual_v4l2_device.h"
+#include "v4l2_buffer_proxy.h"
+#include "frame_recorder.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define XCAM_VIRTUAL_DEFAULT_FPS          30
+#define XCAM_VIRTUAL_STATS_POOL_SIZE      6
+#define XCAM_VIRTUAL_MAX_WAIT_TIME        1000000  // us
+#define XCAM_VIRTUAL_TIMESTAMPS_SUFFIX    ".timestamps"
+#define XCAM_VIRTUAL_MAX_PATH_SIZE        512
+
+namespace XCam {
+
+VirtualV4l2Device::VirtualV4l2Device (const char *source)
+    : V4l2Device (source)
+    , _frame_index (0)
+    , _sequence (0)
+    , _next_frame_time (0)
+    , _rate (VIRTUAL_CAPTURE_RATE_FIXED)
+    , _stats_callback (NULL)
+{
+}
+
+VirtualV4l2Device::~VirtualV4l2Device ()
+{
+    close ();
+}
+
+bool
+VirtualV4l2Device::is_virtual_source (const char *name)
+{
+    struct stat st;
+
+    if (!name || stat (name, &st) != 0)
+        return false;
+    return S_ISREG (st.st_mode) || S_ISDIR (st.st_mode);
+}
+
+bool
+VirtualV4l2Device::set_capture_rate (VirtualCaptureRate rate)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !is_activated (), false,
+        "device(%s) set capture rate failed since activated", XCAM_STR (_name));
+    _rate = rate;
+    return true;
+}
+
+bool
+VirtualV4l2Device::set_stats_callback (StatsCallback *callback)
+{
+    XCAM_FAIL_RETURN (
+        WARNING, !is_activated (), false,
+        "device(%s) set stats callback failed since activated", XCAM_STR (_name));
+    _stats_callback = callback;
+    return true;
+}
+
+XCamReturn
+VirtualV4l2Device::open ()
+{
+    struct stat st;
+
+    if (is_opened ()) {
+        XCAM_LOG_DEBUG ("device(%s) was already opened", XCAM_STR (_name));
+        return XCAM_RETURN_NO_ERROR;
+    }
+
+    XCAM_FAIL_RETURN (
+        ERROR, _name, XCAM_RETURN_ERROR_PARAM,
+        "virtual device open failed, there's no source");
+    XCAM_FAIL_RETURN (
+        ERROR, stat (_name, &st) == 0, XCAM_RETURN_ERROR_FILE,
+        "virtual device stat source(%s) failed", _name);
+
+    if (S_ISDIR (st.st_mode)) {
+        struct dirent **entries = NULL;
+        int count = scandir (_name, &entries, NULL, alphasort);
+        XCAM_FAIL_RETURN (
+            ERROR, count >= 0, XCAM_RETURN_ERROR_FILE,
+            "virtual device scan dir(%s) failed", _name);
+
+        for (int i = 0; i < count; ++i) {
+            char path[XCAM_VIRTUAL_MAX_PATH_SIZE];
+            if (entries[i]->d_name[0] != '.') {
+                snprintf (path, sizeof (path), "%s/%s", _name, entries[i]->d_name);
+                map_file (path);
+            }
+            free (entries[i]);
+        }
+        free (entries);
+    } else {
+        map_file (_name);
+    }
+
+    if (_mappings.empty ()) {
+        XCAM_LOG_ERROR ("virtual device source(%s) has no frame data", _name);
+        return XCAM_RETURN_ERROR_FILE;
+    }
+
+    // keeps is_opened () working, v4l2 ioctls on it just fail
+    _fd = ::open (_name, O_RDONLY);
+    if (_fd == -1) {
+        XCAM_LOG_ERROR ("virtual device open source(%s) failed", _name);
+        unmap_source ();
+        return XCAM_RETURN_ERROR_FILE;
+    }
+
+    load_timestamps ();
+    XCAM_LOG_INFO (
+        "virtual device(%s) opened with %d file(s), %d timestamp(s)",
+        _name, (int)_mappings.size (), (int)_timestamps.size ());
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+VirtualV4l2Device::close ()
+{
+    if (!is_opened ())
+        return XCAM_RETURN_NO_ERROR;
+
+    if (is_activated ())
+        stop ();
+    unmap_source ();
+    return V4l2Device::close ();
+}
+
+bool
+VirtualV4l2Device::map_file (const char *path)
+{
+    struct stat st;
+    Mapping mapping;
+    int fd = ::open (path, O_RDONLY);
+
+    if (fd == -1) {
+        XCAM_LOG_WARNING ("virtual device open file(%s) failed", path);
+        return false;
+    }
+
+    if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || !st.st_size) {
+        XCAM_LOG_DEBUG ("virtual device skipped file(%s)", path);
+        ::close (fd);
+        return false;
+    }
+
+    // private writable mapping, in-place processing never reaches the file
+    mapping.size = st.st_size;
+    mapping.addr = mmap (NULL, mapping.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close (fd);
+    if (mapping.addr == MAP_FAILED) {
+        XCAM_LOG_WARNING ("virtual device mmap file(%s) failed", path);
+        return false;
+    }
+
+    _mappings.push_back (mapping);
+    return true;
+}
+
+void
+VirtualV4l2Device::unmap_source ()
+{
+    for (std::vector<Mapping>::iterator i = _mappings.begin (); i != _mappings.end (); ++i)
+        munmap (i->addr, i->size);
+    _mappings.clear ();
+    _frames.clear ();
+    _timestamps.clear ();
+}
+
+/*
+ * "<source>.timestamps" holds one capture time in microseconds per line,
+ * only used by VIRTUAL_CAPTURE_RATE_TIMESTAMPS
+ */
+void
+VirtualV4l2Device::load_timestamps ()
+{
+    char path[XCAM_VIRTUAL_MAX_PATH_SIZE];
+    int64_t timestamp = 0;
+    FILE *file = NULL;
+
+    snprintf (path, sizeof (path), "%s" XCAM_VIRTUAL_TIMESTAMPS_SUFFIX, _name);
+    file = fopen (path, "r");
+    if (!file)
+        return;
+
+    while (fscanf (file, "%" SCNd64, &timestamp) == 1)
+        _timestamps.push_back (timestamp);
+    fclose (file);
+}
+
+/*
+ * FrameRecorder recording, frames must be packed as set_format,
+ * recorded timestamps replace "<source>.timestamps"
+ */
+void
+VirtualV4l2Device::split_recording (
+    const Mapping &mapping, const struct v4l2_format &format, std::vector<int64_t> &timestamps)
+{
+    const uint8_t *data = (const uint8_t *)mapping.addr;
+    size_t offset = 0;
+    uint32_t skipped = 0;
+    uint32_t stride = format.fmt.pix.bytesperline;
+
+    if (format.fmt.pix.pixelformat == V4L2_PIX_FMT_NV12)
+        stride = stride * 2 / 3;
+
+    while (offset + sizeof (RecordFrameHeader) <= mapping.size) {
+        const RecordFrameHeader *header = (const RecordFrameHeader *)(data + offset);
+        if (header->magic != XCAM_RECORD_FRAME_MAGIC || header->header_size < sizeof (RecordFrameHeader) ||
+                offset + header->header_size + header->data_size > mapping.size)
+            break;
+
+        if (header->info.format == format.fmt.pix.pixelformat &&
+                header->info.width == format.fmt.pix.width &&
+                header->info.height == format.fmt.pix.height &&
+                header->info.strides[0] == stride &&
+                header->data_size >= format.fmt.pix.sizeimage) {
+            _frames.push_back (data + offset + header->header_size);
+            timestamps.push_back (header->timestamp);
+        } else
+            ++skipped;
+        offset += header->header_size + header->data_size;
+    }
+
+    if (skipped)
+        XCAM_LOG_WARNING ("virtual device skipped %d recorded frames not packed as format", skipped);
+}
+
+// every file holds whole frames, trailing bytes ignored
+bool
+VirtualV4l2Device::split_frames (const struct v4l2_format &format)
+{
+    uint32_t frame_size = format.fmt.pix.sizeimage;
+    std::vector<int64_t> recorded_timestamps;
+
+    _frames.clear ();
+    for (std::vector<Mapping>::iterator i = _mappings.begin (); i != _mappings.end (); ++i) {
+        const uint8_t *data = (const uint8_t *)i->addr;
+        if (i->size >= sizeof (RecordFrameHeader) &&
+                ((const RecordFrameHeader *)data)->magic == XCAM_RECORD_FRAME_MAGIC) {
+            split_recording (*i, format, recorded_timestamps);
+            continue;
+        }
+        if (i->size < frame_size)
+            XCAM_LOG_WARNING ("virtual device skipped file of %d bytes, less than a frame", (int)i->size);
+        for (size_t offset = 0; offset + frame_size <= i->size; offset += frame_size)
+            _frames.push_back (data + offset);
+    }
+    if (!recorded_timestamps.empty ())
+        _timestamps = recorded_timestamps;
+    return !_frames.empty ();
+}
+
+XCamReturn
+VirtualV4l2Device::get_format (struct v4l2_format &format)
+{
+    if (!is_opened () || !_format.fmt.pix.pixelformat)
+        return XCAM_RETURN_ERROR_PARAM;
+
+    format = _format;
+    return XCAM_RETURN_NO_ERROR;
+}
+
+/*
+ * frames are packed, bytesperline follows what V4l2BufferProxy expects,
+ * NV12 bytesperline covers both planes as atomisp reports it
+ */
+XCamReturn
+VirtualV4l2Device::set_format (struct v4l2_format &format)
+{
+    uint32_t width = format.fmt.pix.width;
+    uint32_t height = format.fmt.pix.height;
+
+    XCAM_FAIL_RETURN (ERROR, !is_activated (), XCAM_RETURN_ERROR_PARAM,
+                      "Cannot set format to virtual device while it is active.");
+    XCAM_FAIL_RETURN (ERROR, is_opened (), XCAM_RETURN_ERROR_FILE,
+                      "Cannot set format to virtual device while it is closed.");
+    XCAM_FAIL_RETURN (ERROR, width && height && !(width % 2) && !(height % 2), XCAM_RETURN_ERROR_PARAM,
+                      "virtual device size(%dx%d) must be even", width, height);
+
+    switch (format.fmt.pix.pixelformat) {
+    case V4L2_PIX_FMT_NV12:
+        format.fmt.pix.bytesperline = width * 3 / 2;
+        format.fmt.pix.sizeimage = width * height * 3 / 2;
+        break;
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_SBGGR10:
+    case V4L2_PIX_FMT_SGBRG10:
+    case V4L2_PIX_FMT_SGRBG10:
+    case V4L2_PIX_FMT_SRGGB10:
+    case V4L2_PIX_FMT_SBGGR12:
+    case V4L2_PIX_FMT_SGBRG12:
+    case V4L2_PIX_FMT_SGRBG12:
+    case V4L2_PIX_FMT_SRGGB12:
+        format.fmt.pix.bytesperline = width * 2;
+        format.fmt.pix.sizeimage = width * height * 2;
+        break;
+    default:
+        XCAM_LOG_ERROR (
+            "virtual device doesn't support format(%s)",
+            xcam_fourcc_to_string (format.fmt.pix.pixelformat));
+        return XCAM_RETURN_ERROR_PARAM;
+    }
+    format.type = _capture_buf_type;
+    format.fmt.pix.field = V4L2_FIELD_NONE;
+
+    XCAM_FAIL_RETURN (
+        ERROR, split_frames (format), XCAM_RETURN_ERROR_PARAM,
+        "virtual device source(%s) has no whole frame of %d bytes",
+        XCAM_STR (_name), format.fmt.pix.sizeimage);
+
+    if (!_fps_n || !_fps_d) {
+        _fps_n = XCAM_VIRTUAL_DEFAULT_FPS;
+        _fps_d = 1;
+    }
+
+    _format = format;
+    XCAM_LOG_INFO (
+        "virtual device(%s) set format(w:%d, h:%d, pixelformat:%s, bytesperline:%d,image_size:%d), %d frames",
+        XCAM_STR (_name), width, height,
+        xcam_fourcc_to_string (format.fmt.pix.pixelformat),
+        format.fmt.pix.bytesperline, format.fmt.pix.sizeimage,
+        (int)_frames.size ());
+
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+VirtualV4l2Device::start ()
+{
+    XCAM_FAIL_RETURN (
+        ERROR, !_frames.empty (), XCAM_RETURN_ERROR_PARAM,
+        "device(%s) start failed, format not set", XCAM_STR (_name));
+
+    if (_memory_type != V4L2_MEMORY_MMAP) {
+        XCAM_LOG_WARNING ("virtual device(%s) only supports mmap buffers, mem type changed", XCAM_STR (_name));
+        _memory_type = V4L2_MEMORY_MMAP;
+    }
+
+    if (_rate == VIRTUAL_CAPTURE_RATE_TIMESTAMPS && _timestamps.size () < _frames.size ()) {
+        XCAM_LOG_WARNING (
+            "virtual device(%s) has %d timestamps for %d frames, others use fixed rate",
+            XCAM_STR (_name), (int)_timestamps.size (), (int)_frames.size ());
+    }
+
+    if (_stats_callback) {
+        VideoBufferInfo info;
+        info.init (_format.fmt.pix.pixelformat, _format.fmt.pix.width, _format.fmt.pix.height);
+        _stats_pool = new X3aStatsPool ();
+        _stats_pool->set_video_info (info);
+        XCAM_FAIL_RETURN (
+            ERROR, _stats_pool->reserve (XCAM_VIRTUAL_STATS_POOL_SIZE), XCAM_RETURN_ERROR_MEM,
+            "device(%s) reserve 3a stats failed", XCAM_STR (_name));
+    }
+
+    SmartLock lock (_mutex);
+    _buf_pool.clear ();
+    _free_indexes.clear ();
+    for (uint32_t i = 0; i < _buf_count; ++i) {
+        struct v4l2_buffer v4l2_buf;
+        xcam_mem_clear (v4l2_buf);
+        v4l2_buf.index = i;
+        v4l2_buf.type = _capture_buf_type;
+        v4l2_buf.memory = V4L2_MEMORY_MMAP;
+        v4l2_buf.length = _format.fmt.pix.sizeimage;
+        _buf_pool.push_back (new V4l2Buffer (v4l2_buf, _format));
+        _free_indexes.push_back (i);
+    }
+
+    _frame_index = 0;
+    _sequence = 0;
+    _next_frame_time = xcam_get_monotonic_time ();
+    _active = true;
+    XCAM_LOG_INFO ("virtual device(%s) started successfully", XCAM_STR (_name));
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+VirtualV4l2Device::stop ()
+{
+    {
+        SmartLock lock (_mutex);
+        _active = false;
+        _free_indexes.clear ();
+        _buf_cond.broadcast ();
+    }
+
+    if (_stats_pool.ptr ()) {
+        _stats_pool->stop ();
+        _stats_pool.release ();
+    }
+    // buffers still held by proxies are dropped on their return
+    _buf_pool.clear ();
+
+    XCAM_LOG_INFO ("virtual device(%s) stopped", XCAM_STR (_name));
+    return XCAM_RETURN_NO_ERROR;
+}
+
+int
+VirtualV4l2Device::poll_event (int timeout_msec)
+{
+    int64_t now = xcam_get_monotonic_time ();
+    int64_t deadline = timeout_msec < 0 ? INT64_MAX : now + timeout_msec * 1000LL;
+
+    SmartLock lock (_mutex);
+    while (_active) {
+        int64_t wake_time = deadline;
+
+        now = xcam_get_monotonic_time ();
+        if (!_free_indexes.empty ()) {
+            if (_rate == VIRTUAL_CAPTURE_RATE_FREE_RUN || now >= _next_frame_time)
+                return 1;
+            wake_time = XCAM_MIN (wake_time, _next_frame_time);
+        }
+        if (now >= deadline)
+            return 0;
+
+        _buf_cond.timedwait (_mutex, (uint32_t)XCAM_MIN (wake_time - now, (int64_t)XCAM_VIRTUAL_MAX_WAIT_TIME));
+    }
+    return -1;
+}
+
+int64_t
+VirtualV4l2Device::get_frame_interval ()
+{
+    if (_rate == VIRTUAL_CAPTURE_RATE_TIMESTAMPS && _frame_index + 1 < _timestamps.size ()) {
+        int64_t interval = _timestamps[_frame_index + 1] - _timestamps[_frame_index];
+        if (interval > 0)
+            return interval;
+    }
+    return 1000000LL * _fps_d / _fps_n;
+}
+
+void
+VirtualV4l2Device::advance_frame ()
+{
+    int64_t interval = get_frame_interval ();
+    int64_t now = xcam_get_monotonic_time ();
+
+    _frame_index = (_frame_index + 1) % _frames.size ();
+    _next_frame_time += interval;
+    // consumer fell behind, restart pacing instead of bursting to catch up
+    if (_next_frame_time + interval < now)
+        _next_frame_time = now;
+}
+
+XCamReturn
+VirtualV4l2Device::dequeue_buffer (SmartPtr<V4l2Buffer> &buf)
+{
+    const uint8_t *frame = NULL;
+    int64_t timestamp = 0;
+    struct timeval time;
+
+    {
+        SmartLock lock (_mutex);
+        if (!is_activated ()) {
+            XCAM_LOG_DEBUG (
+                "device(%s) dequeue buffer failed since not activated", XCAM_STR (_name));
+            return XCAM_RETURN_ERROR_PARAM;
+        }
+        XCAM_FAIL_RETURN (
+            WARNING, !_free_indexes.empty (), XCAM_RETURN_ERROR_MEM,
+            "device(%s) dequeue buffer failed, all buffers in use", XCAM_STR (_name));
+
+        buf = _buf_pool [_free_indexes.front ()];
+        _free_indexes.pop_front ();
+
+        frame = _frames [_frame_index];
+        timestamp = (_rate == VIRTUAL_CAPTURE_RATE_FREE_RUN) ? xcam_get_monotonic_time () : _next_frame_time;
+        time.tv_sec = timestamp / 1000000;
+        time.tv_usec = timestamp % 1000000;
+
+        buf->set_userptr ((uintptr_t)frame);
+        buf->set_timestamp (time);
+        buf->set_sequence (_sequence++);
+        advance_frame ();
+    }
+
+    XCAM_LOG_DEBUG ("device(%s) dequeue buffer index:%d", XCAM_STR (_name), buf->get_buf ().index);
+
+    if (_stats_pool.ptr ())
+        post_3a_stats (frame, timestamp);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+VirtualV4l2Device::queue_buffer (SmartPtr<V4l2Buffer> &buf)
+{
+    XCAM_ASSERT (buf.ptr());
+    buf->reset ();
+
+    SmartLock lock (_mutex);
+    if (!is_activated ())
+        return XCAM_RETURN_NO_ERROR;
+
+    XCAM_ASSERT (buf->get_buf ().index < _buf_count);
+    _free_indexes.push_back (buf->get_buf ().index);
+    _buf_cond.signal ();
+    return XCAM_RETURN_NO_ERROR;
+}
+
+// 8 bits sample, luma of YUV or raw value of Bayer
+uint32_t
+VirtualV4l2Device::get_sample (const uint8_t *frame, uint32_t x, uint32_t y)
+{
+    uint32_t width = _format.fmt.pix.width;
+
+    switch (_format.fmt.pix.pixelformat) {
+    case V4L2_PIX_FMT_NV12:
+        return frame[y * width + x];
+    case V4L2_PIX_FMT_YUYV:
+        return frame[(y * width + x) * 2];
+    case V4L2_PIX_FMT_SBGGR10:
+    case V4L2_PIX_FMT_SGBRG10:
+    case V4L2_PIX_FMT_SGRBG10:
+    case V4L2_PIX_FMT_SRGGB10:
+        return XCAM_MIN (((const uint16_t *)frame)[y * width + x] >> 2, 255);
+    default:
+        return XCAM_MIN (((const uint16_t *)frame)[y * width + x] >> 4, 255);
+    }
+}
+
+/*
+ * synthetic stats, one 2x2 quad sampled at center of each grid,
+ * YUV frames report luma as gray for awb, af values left 0
+ */
+void
+VirtualV4l2Device::post_3a_stats (const uint8_t *frame, int64_t timestamp)
+{
+    // quad position of r, gr, gb, b
+    uint32_t r_pos = 0, gr_pos = 1, gb_pos = 2, b_pos = 3;
+    bool bayer = true;
+    SmartPtr<X3aStats> stats;
+    XCam3AStats *stats_ptr = NULL;
+
+    stats = _stats_pool->get_buffer (_stats_pool, 0).dynamic_cast_ptr<X3aStats> ();
+    if (!stats.ptr ()) {
+        XCAM_LOG_DEBUG ("virtual device(%s) dropped 3a stats, pool exhausted", XCAM_STR (_name));
+        return;
+    }
+    stats_ptr = stats->get_stats ();
+    const XCam3AStatsInfo &info = stats_ptr->info;
+
+    switch (_format.fmt.pix.pixelformat) {
+    case V4L2_PIX_FMT_SGRBG10:
+    case V4L2_PIX_FMT_SGRBG12:
+        r_pos = 1, gr_pos = 0, gb_pos = 3, b_pos = 2;
+        break;
+    case V4L2_PIX_FMT_SBGGR10:
+    case V4L2_PIX_FMT_SBGGR12:
+        r_pos = 3, gr_pos = 2, gb_pos = 1, b_pos = 0;
+        break;
+    case V4L2_PIX_FMT_SGBRG10:
+    case V4L2_PIX_FMT_SGBRG12:
+        r_pos = 2, gr_pos = 3, gb_pos = 0, b_pos = 1;
+        break;
+    case V4L2_PIX_FMT_SRGGB10:
+    case V4L2_PIX_FMT_SRGGB12:
+        break;
+    default:
+        bayer = false;
+        break;
+    }
+
+    memset (stats_ptr->hist_rgb, 0, sizeof (XCamHistogram) * info.histogram_bins);
+    memset (stats_ptr->hist_y, 0, sizeof (uint32_t) * info.histogram_bins);
+
+    for (uint32_t grid_y = 0; grid_y < info.height; ++grid_y) {
+        for (uint32_t grid_x = 0; grid_x < info.width; ++grid_x) {
+            XCamGridStat &grid = stats_ptr->stats[grid_y * info.aligned_width + grid_x];
+            uint32_t x = (grid_x * info.grid_pixel_size + info.grid_pixel_size / 2) & ~1;
+            uint32_t y = (grid_y * info.grid_pixel_size + info.grid_pixel_size / 2) & ~1;
+            uint32_t quad[4] = {
+                get_sample (frame, x, y), get_sample (frame, x + 1, y),
+                get_sample (frame, x, y + 1), get_sample (frame, x + 1, y + 1)
+            };
+
+            if (bayer) {
+                grid.avg_r = quad[r_pos];
+                grid.avg_gr = quad[gr_pos];
+                grid.avg_gb = quad[gb_pos];
+                grid.avg_b = quad[b_pos];
+            } else {
+                grid.avg_r = grid.avg_gr = grid.avg_gb = grid.avg_b =
+                                                 (quad[0] + quad[1] + quad[2] + quad[3]) / 4;
+            }
+            grid.avg_y = (grid.avg_r + grid.avg_gr + grid.avg_gb + grid.avg_b) / 4;
+            grid.valid_wb_count = info.grid_pixel_size * info.grid_pixel_size;
+            grid.f_value1 = 0;
+            grid.f_value2 = 0;
+
+            ++stats_ptr->hist_y[grid.avg_y];
+            ++stats_ptr->hist_rgb[grid.avg_r].r;
+            ++stats_ptr->hist_rgb[grid.avg_gr].gr;
+            ++stats_ptr->hist_rgb[grid.avg_gb].gb;
+            ++stats_ptr->hist_rgb[grid.avg_b].b;
+        }
+    }
+
+    stats->set_timestamp (timestamp);
+    _stats_callback->x3a_stats_ready (stats);
+}
+
+};
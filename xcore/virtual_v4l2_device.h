@@ -0,0 +1,114 @@
+/*
+ * virtual_v4l2_device.h - file backed virtual capture device
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_VIRTUAL_V4L2_DEVICE_H
+#define XCAM_VIRTUAL_V4L2_DEVICE_H
+
+#include "xcam_utils.h"
+#include "v4l2_device.h"
+#include "xcam_mutex.h"
+#include "x3a_stats_pool.h"
+#include "stats_callback_interface.h"
+#include <list>
+#include <vector>
+
+namespace XCam {
+
+enum VirtualCaptureRate {
+    VIRTUAL_CAPTURE_RATE_FIXED = 0,   // framerate of set_framerate, 30fps if not set
+    VIRTUAL_CAPTURE_RATE_FREE_RUN,    // as soon as a buffer is returned
+    VIRTUAL_CAPTURE_RATE_TIMESTAMPS,  // original frame gaps in "<source>.timestamps"
+};
+
+/*
+ * VirtualV4l2Device, replays raw frames instead of capturing from hardware.
+ * Source is one file of back-to-back frames with the format's sizeimage,
+ * or a directory of one file per frame in name order; it loops at the end.
+ * FrameRecorder recordings are also accepted as source.
+ * Files are mmapped private, buffers point into the mapping without copy.
+ * Supported formats: NV12, YUYV, 10/12 bits Bayer (16 bits per pixel).
+ */
+class VirtualV4l2Device
+    : public V4l2Device
+{
+    struct Mapping {
+        void      *addr;
+        size_t     size;
+    };
+
+public:
+    explicit VirtualV4l2Device (const char *source = NULL);
+    ~VirtualV4l2Device ();
+
+    // regular file or directory
+    static bool is_virtual_source (const char *name);
+
+    // before start
+    bool set_capture_rate (VirtualCaptureRate rate);
+    // synthetic 3a stats computed from each frame, NULL to disable
+    bool set_stats_callback (StatsCallback *callback);
+
+    virtual XCamReturn open ();
+    virtual XCamReturn close ();
+    virtual XCamReturn get_format (struct v4l2_format &format);
+    virtual XCamReturn set_format (struct v4l2_format &format);
+    using V4l2Device::set_format;
+
+    virtual XCamReturn start ();
+    virtual XCamReturn stop ();
+
+    virtual int poll_event (int timeout_msec);
+    virtual XCamReturn dequeue_buffer (SmartPtr<V4l2Buffer> &buf);
+    virtual XCamReturn queue_buffer (SmartPtr<V4l2Buffer> &buf);
+
+private:
+    bool map_file (const char *path);
+    void unmap_source ();
+    void load_timestamps ();
+    void split_recording (
+        const Mapping &mapping, const struct v4l2_format &format, std::vector<int64_t> &timestamps);
+    bool split_frames (const struct v4l2_format &format);
+    int64_t get_frame_interval ();
+    void advance_frame ();
+    void post_3a_stats (const uint8_t *frame, int64_t timestamp);
+    uint32_t get_sample (const uint8_t *frame, uint32_t x, uint32_t y);
+
+    XCAM_DEAD_COPY (VirtualV4l2Device);
+
+private:
+    std::vector<Mapping>          _mappings;
+    std::vector<const uint8_t *>  _frames;
+    std::vector<int64_t>          _timestamps;
+    uint32_t                      _frame_index;
+    uint32_t                      _sequence;
+    int64_t                       _next_frame_time;
+    VirtualCaptureRate            _rate;
+
+    Mutex                         _mutex;
+    Cond                          _buf_cond;
+    std::list<uint32_t>           _free_indexes;
+
+    StatsCallback                *_stats_callback;
+    SmartPtr<X3aStatsPool>        _stats_pool;
+};
+
+};
+
+#endif //XCAM_VIRTUAL_V4L2_DEVICE_H
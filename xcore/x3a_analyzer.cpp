@@ -21,6 +21,8 @@
 #include "xcam_analyzer.h"
 #include "x3a_analyzer.h"
 #include "x3a_stats_pool.h"
+#include "xcam_trace.h"
+#include <inttypes.h>
 
 namespace XCam {
 
@@ -30,6 +32,8 @@ X3aAnalyzer::X3aAnalyzer (const char *name)
     , _awb_handler (NULL)
     , _af_handler (NULL)
     , _common_handler (NULL)
+    , _fast_convergence (false)
+    , _warm_seeded (false)
 {
 }
 
@@ -81,7 +85,117 @@ X3aAnalyzer::release_handlers ()
 XCamReturn
 X3aAnalyzer::configure ()
 {
-    return configure_3a ();
+    XCamReturn ret = configure_3a ();
+    if (ret != XCAM_RETURN_NO_ERROR)
+        return ret;
+
+    _convergence.reset ();
+    {
+        SmartLock lock (_warm_mutex);
+        _warm_seeded = false;
+    }
+    seed_warm_state ();
+    return XCAM_RETURN_NO_ERROR;
+}
+
+bool
+X3aAnalyzer::set_warm_start (const char *dir, const char *sensor, const char *scene)
+{
+    XCAM_FAIL_RETURN (
+        WARNING,
+        sensor,
+        false,
+        "analyzer(%s) set warm start failed, sensor name needed", XCAM_STR (get_name ()));
+
+    _warm_start_file = new X3aWarmStartFile (dir, sensor, scene);
+    return true;
+}
+
+bool
+X3aAnalyzer::set_fast_convergence (bool enable)
+{
+    _fast_convergence = enable;
+    return true;
+}
+
+XCamReturn
+X3aAnalyzer::warm_start_3a (const X3aWarmState &state)
+{
+    XCAM_UNUSED (state);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+static void
+get_warm_results (const X3aWarmState &state, X3aResultList &results)
+{
+    XCam3aResultExposure exposure;
+    XCam3aResultWhiteBalance wb;
+
+    xcam_mem_clear (exposure);
+    exposure.exposure_time = (int32_t)state.exposure_time;
+    exposure.analog_gain = state.analog_gain;
+    exposure.digital_gain = state.digital_gain;
+    SmartPtr<X3aExposureResult> exposure_result = new X3aExposureResult (XCAM_3A_RESULT_EXPOSURE);
+    exposure_result->set_standard_result (exposure);
+    results.push_back (exposure_result);
+
+    xcam_mem_clear (wb);
+    wb.r_gain = state.r_gain;
+    wb.gr_gain = state.gr_gain;
+    wb.gb_gain = state.gb_gain;
+    wb.b_gain = state.b_gain;
+    SmartPtr<X3aWhiteBalanceResult> wb_result = new X3aWhiteBalanceResult (XCAM_3A_RESULT_WHITE_BALANCE);
+    wb_result->set_standard_result (wb);
+    results.push_back (wb_result);
+}
+
+void
+X3aAnalyzer::seed_warm_state ()
+{
+    X3aWarmState state;
+    X3aResultList results;
+
+    if (!_warm_start_file.ptr () || !_warm_start_file->load (state))
+        return;
+
+    if (warm_start_3a (state) != XCAM_RETURN_NO_ERROR) {
+        XCAM_LOG_WARNING ("analyzer(%s) warm start failed, start cold", XCAM_STR (get_name ()));
+        return;
+    }
+
+    get_warm_results (state, results);
+    // first analysis is compared with the seeded state
+    _convergence.update (results, state.cct);
+
+    XCAM_LOG_INFO (
+        "analyzer(%s) warm started from %s, exposure:%" PRId64 "us, gain:%.2f, cct:%u",
+        XCAM_STR (get_name ()), _warm_start_file->get_path (),
+        state.exposure_time, state.analog_gain, state.cct);
+    {
+        SmartLock lock (_warm_mutex);
+        _warm_state = state;
+        _warm_seeded = true;
+    }
+    notify_calculation_done (results);
+}
+
+void
+X3aAnalyzer::push_warm_state ()
+{
+    X3aWarmState state;
+    X3aResultList results;
+    {
+        SmartLock lock (_warm_mutex);
+        // not configured yet, configure sends them itself
+        if (!_warm_seeded)
+            return;
+        state = _warm_state;
+    }
+
+    // fresh results, processors mark the sent ones done
+    get_warm_results (state, results);
+    XCAM_LOG_DEBUG ("analyzer(%s) push warm start results again", XCAM_STR (get_name ()));
+    notify_calculation_done (results);
 }
 
 XCamReturn
@@ -105,6 +219,7 @@ X3aAnalyzer::analyze_3a_statistics (SmartPtr<X3aStats> &stats)
     XCamReturn ret = XCAM_RETURN_NO_ERROR;
     X3aResultList results;
 
+    XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_ANALYZER, get_name ());
     ret = pre_3a_analyze (stats);
     if (ret != XCAM_RETURN_NO_ERROR) {
         notify_calculation_failed(
@@ -112,28 +227,40 @@ X3aAnalyzer::analyze_3a_statistics (SmartPtr<X3aStats> &stats)
         return ret;
     }
 
-    ret = _ae_handler->analyze (results);
+    {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_ANALYZER, "ae_analyze");
+        ret = _ae_handler->analyze (results);
+    }
     if (ret != XCAM_RETURN_NO_ERROR) {
         notify_calculation_failed(
             _ae_handler.ptr(), stats->get_timestamp (), "ae calculation failed");
         return ret;
     }
 
-    ret = _awb_handler->analyze (results);
+    {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_ANALYZER, "awb_analyze");
+        ret = _awb_handler->analyze (results);
+    }
     if (ret != XCAM_RETURN_NO_ERROR) {
         notify_calculation_failed(
             _awb_handler.ptr(), stats->get_timestamp (), "awb calculation failed");
         return ret;
     }
 
-    ret = _af_handler->analyze (results);
+    {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_ANALYZER, "af_analyze");
+        ret = _af_handler->analyze (results);
+    }
     if (ret != XCAM_RETURN_NO_ERROR) {
         notify_calculation_failed(
             _af_handler.ptr(), stats->get_timestamp (), "af calculation failed");
         return ret;
     }
 
-    ret = _common_handler->analyze (results);
+    {
+        XCAM_TRACE_SCOPE (XCAM_TRACE_CAT_ANALYZER, "common_analyze");
+        ret = _common_handler->analyze (results);
+    }
     if (ret != XCAM_RETURN_NO_ERROR) {
         notify_calculation_failed(
             _common_handler.ptr(), stats->get_timestamp (), "3a other calculation failed");
@@ -147,6 +274,12 @@ X3aAnalyzer::analyze_3a_statistics (SmartPtr<X3aStats> &stats)
         return ret;
     }
 
+    if (_convergence.update (results, _awb_handler->get_current_estimate_cct ()) &&
+            _warm_start_file.ptr ()) {
+        XCAM_LOG_DEBUG ("analyzer(%s) ae/awb converged, save warm state", XCAM_STR (get_name ()));
+        _warm_start_file->save (_convergence.get_state ());
+    }
+
     if (!results.empty ()) {
         set_results_timestamp(results, stats->get_timestamp ());
         notify_calculation_done (results);
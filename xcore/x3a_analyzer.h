@@ -24,6 +24,7 @@
 #include "xcam_utils.h"
 #include "xcam_analyzer.h"
 #include "handler_interface.h"
+#include "x3a_warm_start.h"
 
 namespace XCam {
 
@@ -42,6 +43,17 @@ public:
     /* analyze 3A statistics */
     XCamReturn push_3a_stats (const SmartPtr<X3aStats> &stats);
 
+    /* warm start, before start */
+    // converged state saved to and first results seeded from <dir>/<sensor>-<scene>.x3a
+    bool set_warm_start (const char *dir, const char *sensor, const char *scene = NULL);
+    // analyze every frame until ae/awb converged, then back off to normal interval
+    bool set_fast_convergence (bool enable);
+    bool is_converged () const {
+        return _convergence.is_converged ();
+    }
+    // send warm start results again, for result consumers started after configure
+    void push_warm_state ();
+
     /* AWB */
     bool set_awb_mode (XCamAwbMode mode);
     bool set_awb_speed (double speed);
@@ -124,9 +136,17 @@ protected:
     virtual XCamReturn pre_3a_analyze (SmartPtr<X3aStats> &stats) = 0;
     // @param[out]  results,   new 3a results merged into \c results
     virtual XCamReturn post_3a_analyze (X3aResultList &results) = 0;
+    // after configure_3a, seed internal state from last converged session
+    virtual XCamReturn warm_start_3a (const X3aWarmState &state);
+
+    // analyzers with intervals analyze every frame while true
+    bool is_fast_converging () const {
+        return _fast_convergence && !_convergence.is_converged ();
+    }
 
 private:
     XCamReturn analyze_3a_statistics (SmartPtr<X3aStats> &stats);
+    void seed_warm_state ();
 
     XCAM_DEAD_COPY (X3aAnalyzer);
 
@@ -138,6 +158,13 @@ private:
     SmartPtr<AwbHandler>     _awb_handler;
     SmartPtr<AfHandler>      _af_handler;
     SmartPtr<CommonHandler>  _common_handler;
+
+    SmartPtr<X3aWarmStartFile>  _warm_start_file;
+    bool                        _fast_convergence;
+    X3aConvergenceTracker       _convergence;   // only touched in analyzer thread
+    Mutex                       _warm_mutex;
+    X3aWarmState                _warm_state;    // seeded in configure
+    bool                        _warm_seeded;
 };
 
 }
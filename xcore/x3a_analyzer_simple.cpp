@@ -144,6 +144,15 @@ X3aAnalyzerSimple::configure_3a ()
     return XCAM_RETURN_NO_ERROR;
 }
 
+XCamReturn
+X3aAnalyzerSimple::warm_start_3a (const X3aWarmState &state)
+{
+    // seeded exposure is applied already, go on from it
+    _last_target_exposure = (double)state.exposure_time * state.analog_gain;
+    _is_ae_started = true;
+    return XCAM_RETURN_NO_ERROR;
+}
+
 XCamReturn
 X3aAnalyzerSimple::pre_3a_analyze (SmartPtr<X3aStats> &stats)
 {
@@ -243,7 +252,7 @@ X3aAnalyzerSimple::analyze_ae (X3aResultList &output)
         return XCAM_RETURN_NO_ERROR;
     }
 
-    if (_ae_calculation_interval % 10 == 0) {
+    if (_ae_calculation_interval % 10 == 0 || is_fast_converging ()) {
         for (uint32_t i = 0; i < stats->info.height; ++i)
             for (uint32_t j = 0; j < stats->info.width; ++j) {
                 sum_y += (double)(stats->stats[i * stats->info.aligned_width + j].avg_y);
@@ -58,6 +58,7 @@ protected:
     virtual XCamReturn configure_3a ();
     virtual XCamReturn pre_3a_analyze (SmartPtr<X3aStats> &stats);
     virtual XCamReturn post_3a_analyze (X3aResultList &results);
+    virtual XCamReturn warm_start_3a (const X3aWarmState &state);
 
 public:
     XCamReturn analyze_ae (X3aResultList &output);
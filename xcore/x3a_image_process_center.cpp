@@ -55,6 +55,43 @@ X3aImageProcessCenter::has_processors ()
     return !_image_processors.empty();
 }
 
+bool
+X3aImageProcessCenter::set_handler_thread_attributes (const ThreadAttributes &attrs)
+{
+    bool ret = true;
+    for (ImageProcessorIter i_pro = _image_processors.begin ();
+            i_pro != _image_processors.end (); ++i_pro) {
+        if (!(*i_pro)->set_handler_thread_attributes (attrs))
+            ret = false;
+    }
+    return ret;
+}
+
+void
+X3aImageProcessCenter::get_metrics (PipelineMetrics &metrics)
+{
+    for (ImageProcessorIter i_pro = _image_processors.begin ();
+            i_pro != _image_processors.end (); ++i_pro)
+        (*i_pro)->get_metrics (metrics);
+}
+
+XCamReturn
+X3aImageProcessCenter::prepare ()
+{
+    XCamReturn ret = XCAM_RETURN_NO_ERROR;
+
+    for (ImageProcessorIter i_pro = _image_processors.begin ();
+            i_pro != _image_processors.end (); ++i_pro) {
+        ret = (*i_pro)->prepare ();
+        XCAM_FAIL_RETURN (
+            WARNING,
+            ret == XCAM_RETURN_NO_ERROR,
+            ret,
+            "processor(%s) prepare failed", XCAM_STR ((*i_pro)->get_name ()));
+    }
+    return XCAM_RETURN_NO_ERROR;
+}
+
 XCamReturn
 X3aImageProcessCenter::start ()
 {
@@ -118,6 +155,19 @@ X3aImageProcessCenter::put_buffer (SmartPtr<VideoBuffer> &buf)
     return true;
 }
 
+bool
+X3aImageProcessCenter::put_buffer (SmartPtr<VideoBuffer> &&buf)
+{
+    XCAM_ASSERT (!_image_processors.empty());
+    if (_image_processors.empty())
+        return false;
+
+    SmartPtr<ImageProcessor> &processor = *_image_processors.begin ();
+    if (processor->push_buffer (std::move (buf)) != XCAM_RETURN_NO_ERROR)
+        return false;
+    return true;
+}
+
 
 XCamReturn
 X3aImageProcessCenter::put_3a_results (X3aResultList &results)
@@ -200,9 +250,8 @@ X3aImageProcessCenter::process_buffer_done (ImageProcessor *processor, const Sma
 
     if (++i_pro != _image_processors.end()) {
         SmartPtr<ImageProcessor> &next_processor = *i_pro;
-        SmartPtr<VideoBuffer> cur_buf = buf;
         XCAM_ASSERT (next_processor.ptr());
-        XCamReturn ret = next_processor->push_buffer (cur_buf);
+        XCamReturn ret = next_processor->push_buffer (SmartPtr<VideoBuffer> (buf));
         if (ret != XCAM_RETURN_NO_ERROR) {
             XCAM_LOG_ERROR ("processor(%s) failed in push_buffer", next_processor->get_name());
         }
@@ -234,4 +283,14 @@ X3aImageProcessCenter::process_image_result_done (ImageProcessor *processor, con
         ImageProcessCallback::process_image_result_done (processor, result);
 }
 
+void
+X3aImageProcessCenter::process_buffer_dropped (
+    ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf, uint64_t dropped)
+{
+    if (_callback)
+        _callback->process_buffer_dropped (processor, buf, dropped);
+    else
+        ImageProcessCallback::process_buffer_dropped (processor, buf, dropped);
+}
+
 };
@@ -38,11 +38,16 @@ public:
     bool insert_processor (SmartPtr<ImageProcessor> &processor);
     bool has_processors ();
     bool set_image_callback (ImageProcessCallback *callback);
+    bool set_handler_thread_attributes (const ThreadAttributes &attrs);
+    void get_metrics (PipelineMetrics &metrics);
 
+    // prepare all processors, e.g. CL kernel builds
+    XCamReturn prepare ();
     XCamReturn start ();
     XCamReturn stop ();
 
     bool put_buffer (SmartPtr<VideoBuffer> &buf);
+    bool put_buffer (SmartPtr<VideoBuffer> &&buf);
 
     XCamReturn put_3a_results (X3aResultList &results);
     XCamReturn put_3a_result (SmartPtr<X3aResult> &result);
@@ -51,6 +56,7 @@ public:
     virtual void process_buffer_done (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf);
     virtual void process_buffer_failed (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf);
     virtual void process_image_result_done (ImageProcessor *processor, const SmartPtr<X3aResult> &result);
+    virtual void process_buffer_dropped (ImageProcessor *processor, const SmartPtr<VideoBuffer> &buf, uint64_t dropped);
 
 private:
     XCAM_DEAD_COPY (X3aImageProcessCenter);
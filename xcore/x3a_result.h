@@ -29,6 +29,7 @@
 namespace XCam {
 
 class X3aResult
+    : public RefObj
 {
 protected:
     explicit X3aResult (
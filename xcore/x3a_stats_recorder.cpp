@@ -0,0 +1,308 @@
+/*
+ * x3a_stats_recorder.cpp - record and replay 3a stats stream
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "x3a_stats_recorder.h"
+#include <errno.h>
+#include <inttypes.h>
+
+namespace XCam {
+
+static uint32_t
+grid_count (const XCam3AStatsInfo &info)
+{
+    return info.aligned_width * info.aligned_height;
+}
+
+static uint32_t
+stats_data_size (const XCam3AStatsInfo &info)
+{
+    return sizeof (XCamGridStat) * grid_count (info) +
+           sizeof (XCamHistogram) * info.histogram_bins +
+           sizeof (uint32_t) * info.histogram_bins;
+}
+
+class X3aStatsRecord
+    : public RefObj
+{
+public:
+    X3aStatsRecord ()
+        : data (NULL)
+    {
+        xcam_mem_clear (header);
+    }
+    ~X3aStatsRecord () {
+        if (data)
+            xcam_free (data);
+    }
+
+    // grids, hist_rgb and hist_y packed as laid out in file
+    bool copy_stats (const SmartPtr<X3aStats> &stats) {
+        const XCam3AStats *src = stats->get_stats ();
+        uint32_t grid_size = sizeof (XCamGridStat) * grid_count (src->info);
+        uint32_t rgb_size = sizeof (XCamHistogram) * src->info.histogram_bins;
+
+        header.magic = XCAM_STATS_RECORD_MAGIC;
+        header.header_size = sizeof (header);
+        header.timestamp = stats->get_timestamp ();
+        header.info = src->info;
+        header.data_size = stats_data_size (src->info);
+
+        data = (uint8_t *) xcam_malloc (header.data_size);
+        if (!data)
+            return false;
+        memcpy (data, src->stats, grid_size);
+        memcpy (data + grid_size, src->hist_rgb, rgb_size);
+        memcpy (data + grid_size + rgb_size, src->hist_y, sizeof (uint32_t) * src->info.histogram_bins);
+        return true;
+    }
+
+    X3aStatsRecordHeader   header;
+    uint8_t               *data;
+
+private:
+    XCAM_DEAD_COPY (X3aStatsRecord);
+};
+
+X3aStatsRecorder::X3aStatsRecorder (const char *path)
+    : _path (NULL)
+    , _file (NULL)
+    , _opened (false)
+    , _recorded (0)
+{
+    XCAM_ASSERT (path);
+    _path = strdup (path);
+}
+
+X3aStatsRecorder::~X3aStatsRecorder ()
+{
+    close ();
+    if (_path)
+        xcam_free (_path);
+}
+
+XCamReturn
+X3aStatsRecorder::open ()
+{
+    if (_opened)
+        return XCAM_RETURN_NO_ERROR;
+
+    _file = fopen (_path, "wb");
+    XCAM_FAIL_RETURN (
+        ERROR, _file, XCAM_RETURN_ERROR_FILE,
+        "stats recorder open file(%s) failed: %s", _path, strerror (errno));
+    _recorded = 0;
+
+    // writer lives until destruction, record () may still hold it after close ()
+    if (!_writer.ptr ())
+        _writer = new RecordWriter<X3aStatsRecord> ("stats_recorder", _path, XCAM_STATS_RECORD_QUEUE_SIZE, this);
+    _opened = true;
+    if (!_writer->start ()) {
+        XCAM_LOG_ERROR ("stats recorder(%s) start thread failed", _path);
+        close ();
+        return XCAM_RETURN_ERROR_THREAD;
+    }
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+X3aStatsRecorder::close ()
+{
+    if (!_opened)
+        return XCAM_RETURN_NO_ERROR;
+
+    _opened = false;
+    _writer->stop ();
+
+    fclose (_file);
+    _file = NULL;
+
+    XCAM_LOG_INFO (
+        "stats recorder(%s) closed, recorded %" PRIu64 " stats, dropped %" PRIu64,
+        _path, _recorded.load (), _writer->get_dropped ());
+    return XCAM_RETURN_NO_ERROR;
+}
+
+bool
+X3aStatsRecorder::record (const SmartPtr<X3aStats> &stats)
+{
+    SmartPtr<X3aStatsRecord> record;
+    XCam3AStats *data = NULL;
+
+    XCAM_ASSERT (stats.ptr ());
+    if (!_opened)
+        return false;
+
+    data = stats->get_stats ();
+    XCAM_FAIL_RETURN (
+        WARNING, data && data->hist_rgb && data->hist_y, false,
+        "stats recorder(%s) got stats without data", _path);
+
+    // no copy for stats dropped anyway
+    if (_writer->is_full ()) {
+        _writer->count_dropped ();
+        return false;
+    }
+
+    record = new X3aStatsRecord;
+    if (!record->copy_stats (stats)) {
+        XCAM_LOG_WARNING ("stats recorder(%s) copy stats failed", _path);
+        _writer->count_dropped ();
+        return false;
+    }
+    return _writer->push (std::move (record));
+}
+
+bool
+X3aStatsRecorder::write_record (const SmartPtr<X3aStatsRecord> &record)
+{
+    bool ret =
+        fwrite (&record->header, sizeof (record->header), 1, _file) == 1 &&
+        fwrite (record->data, 1, record->header.data_size, _file) == record->header.data_size;
+
+    if (!ret) {
+        XCAM_LOG_ERROR ("stats recorder(%s) write failed: %s", _path, strerror (errno));
+        _writer->count_dropped ();
+        return false;
+    }
+    ++_recorded;
+    return true;
+}
+
+X3aStatsReader::X3aStatsReader (const char *path)
+    : _path (NULL)
+    , _file (NULL)
+{
+    XCAM_ASSERT (path);
+    _path = strdup (path);
+    xcam_mem_clear (_pool_info);
+}
+
+X3aStatsReader::~X3aStatsReader ()
+{
+    close ();
+    if (_path)
+        xcam_free (_path);
+}
+
+XCamReturn
+X3aStatsReader::open ()
+{
+    if (_file)
+        return XCAM_RETURN_NO_ERROR;
+
+    _file = fopen (_path, "rb");
+    XCAM_FAIL_RETURN (
+        ERROR, _file, XCAM_RETURN_ERROR_FILE,
+        "stats reader open file(%s) failed: %s", _path, strerror (errno));
+    return XCAM_RETURN_NO_ERROR;
+}
+
+void
+X3aStatsReader::close ()
+{
+    if (_file) {
+        fclose (_file);
+        _file = NULL;
+    }
+}
+
+XCamReturn
+X3aStatsReader::rewind ()
+{
+    XCAM_FAIL_RETURN (
+        ERROR, _file && fseek (_file, 0, SEEK_SET) == 0, XCAM_RETURN_ERROR_FILE,
+        "stats reader(%s) rewind failed", _path);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+bool
+X3aStatsReader::ensure_pool (const XCam3AStatsInfo &info)
+{
+    if (_pool.ptr () && !memcmp (&_pool_info, &info, sizeof (info)))
+        return true;
+
+    // stats still held by caller keep the old pool alive
+    _pool = new X3aStatsPool ();
+    _pool->set_stats_info (info);
+    XCAM_FAIL_RETURN (
+        ERROR, _pool->reserve (XCAM_STATS_REPLAY_POOL_SIZE), false,
+        "stats reader(%s) reserve stats buffer failed", _path);
+    _pool_info = info;
+    return true;
+}
+
+XCamReturn
+X3aStatsReader::read (SmartPtr<X3aStats> &stats)
+{
+    X3aStatsRecordHeader header;
+    XCam3AStats *data = NULL;
+    size_t size = 0;
+
+    XCAM_ASSERT (_file);
+    size = fread (&header, 1, sizeof (header), _file);
+    if (size == 0 && feof (_file))
+        return XCAM_RETURN_BYPASS;
+
+    XCAM_FAIL_RETURN (
+        ERROR,
+        size == sizeof (header) && header.magic == XCAM_STATS_RECORD_MAGIC &&
+        header.header_size == sizeof (header),
+        XCAM_RETURN_ERROR_FILE,
+        "stats reader(%s) found invalid record header", _path);
+    XCAM_FAIL_RETURN (
+        ERROR,
+        header.info.aligned_width && header.info.aligned_width <= XCAM_STATS_REPLAY_MAX_GRID_SIDE &&
+        header.info.aligned_height && header.info.aligned_height <= XCAM_STATS_REPLAY_MAX_GRID_SIDE &&
+        header.info.width <= header.info.aligned_width && header.info.height <= header.info.aligned_height &&
+        header.info.histogram_bins && header.info.histogram_bins <= XCAM_STATS_REPLAY_MAX_BINS,
+        XCAM_RETURN_ERROR_FILE,
+        "stats reader(%s) found invalid stats info, grids:%dx%d aligned:%dx%d bins:%d",
+        _path, header.info.width, header.info.height,
+        header.info.aligned_width, header.info.aligned_height, header.info.histogram_bins);
+    // sizes below fit in 32 bits once info is bounded
+    XCAM_FAIL_RETURN (
+        ERROR,
+        header.data_size == stats_data_size (header.info),
+        XCAM_RETURN_ERROR_FILE,
+        "stats reader(%s) record size(%d) doesn't match stats info", _path, header.data_size);
+
+    if (!ensure_pool (header.info))
+        return XCAM_RETURN_ERROR_MEM;
+
+    stats = _pool->get_buffer (_pool, 0).dynamic_cast_ptr<X3aStats> ();
+    XCAM_FAIL_RETURN (
+        WARNING, stats.ptr (), XCAM_RETURN_ERROR_MEM,
+        "stats reader(%s) out of stats buffers, %d at most held at once",
+        _path, XCAM_STATS_REPLAY_POOL_SIZE);
+
+    data = stats->get_stats ();
+    XCAM_ASSERT (data);
+    if (fread (data->stats, sizeof (XCamGridStat), grid_count (header.info), _file) != grid_count (header.info) ||
+            fread (data->hist_rgb, sizeof (XCamHistogram), header.info.histogram_bins, _file) != header.info.histogram_bins ||
+            fread (data->hist_y, sizeof (uint32_t), header.info.histogram_bins, _file) != header.info.histogram_bins) {
+        XCAM_LOG_ERROR ("stats reader(%s) found truncated record", _path);
+        stats.release ();
+        return XCAM_RETURN_ERROR_FILE;
+    }
+    stats->set_timestamp (header.timestamp);
+    return XCAM_RETURN_NO_ERROR;
+}
+
+};
@@ -0,0 +1,127 @@
+/*
+ * x3a_stats_recorder.h - record and replay 3a stats stream
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_3A_STATS_RECORDER_H
+#define XCAM_3A_STATS_RECORDER_H
+
+#include "xcam_utils.h"
+#include "x3a_stats_pool.h"
+#include "record_writer.h"
+#include <base/xcam_3a_stats.h>
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <atomic>
+
+#define XCAM_STATS_RECORD_MAGIC          v4l2_fourcc ('X', 'C', 'S', 'R')
+#define XCAM_STATS_RECORD_QUEUE_SIZE     16
+#define XCAM_STATS_REPLAY_POOL_SIZE      4
+// replay limits, far above any ISP grid, keep a corrupt header from sizing the pool
+#define XCAM_STATS_REPLAY_MAX_GRID_SIDE  1024
+#define XCAM_STATS_REPLAY_MAX_BINS       4096
+
+namespace XCam {
+
+/*
+ * stats recording is a sequence of records, each X3aStatsRecordHeader
+ * followed by data_size bytes: aligned_width * aligned_height XCamGridStat,
+ * then histogram_bins XCamHistogram and histogram_bins uint32_t of hist_y
+ */
+struct X3aStatsRecordHeader {
+    uint32_t          magic;        // XCAM_STATS_RECORD_MAGIC
+    uint32_t          header_size;  // sizeof (X3aStatsRecordHeader)
+    int64_t           timestamp;
+    XCam3AStatsInfo   info;
+    uint32_t          data_size;
+    uint32_t          reserved;
+};
+
+class X3aStatsRecord;
+
+/*
+ * X3aStatsRecorder, record () copies stats and queues the copy without blocking,
+ * a dedicated thread writes them, so capture path never waits on disk.
+ * Stats are dropped and counted when the queue is full.
+ */
+class X3aStatsRecorder
+    : public RecordSink<X3aStatsRecord>
+{
+public:
+    explicit X3aStatsRecorder (const char *path);
+    ~X3aStatsRecorder ();
+
+    XCamReturn open ();
+    // writes stats still queued, then closes file
+    XCamReturn close ();
+
+    // false if stats dropped
+    bool record (const SmartPtr<X3aStats> &stats);
+    uint64_t get_recorded () const {
+        return _recorded.load ();
+    }
+    uint64_t get_dropped () const {
+        return _writer.ptr () ? _writer->get_dropped () : 0;
+    }
+
+private:
+    //virtual functions derived from RecordSink
+    virtual bool write_record (const SmartPtr<X3aStatsRecord> &record);
+
+    XCAM_DEAD_COPY (X3aStatsRecorder);
+
+private:
+    char                           *_path;
+    FILE                           *_file;
+    std::atomic<bool>               _opened;
+    SmartPtr<RecordWriter<X3aStatsRecord> >  _writer;
+    std::atomic<uint64_t>           _recorded;
+};
+
+/*
+ * X3aStatsReader, reads recorded stats back into X3aStats
+ * from its own stats pool, reallocated when stats info changes.
+ */
+class X3aStatsReader {
+public:
+    explicit X3aStatsReader (const char *path);
+    ~X3aStatsReader ();
+
+    XCamReturn open ();
+    void close ();
+    // back to first record
+    XCamReturn rewind ();
+
+    // XCAM_RETURN_BYPASS at end of recording
+    XCamReturn read (SmartPtr<X3aStats> &stats);
+
+private:
+    bool ensure_pool (const XCam3AStatsInfo &info);
+
+    XCAM_DEAD_COPY (X3aStatsReader);
+
+private:
+    char                     *_path;
+    FILE                     *_file;
+    SmartPtr<X3aStatsPool>    _pool;
+    XCam3AStatsInfo           _pool_info;
+};
+
+};
+
+#endif //XCAM_3A_STATS_RECORDER_H
@@ -0,0 +1,192 @@
+/*
+ * x3a_warm_start.cpp - converged 3a state kept across sessions
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "x3a_warm_start.h"
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+
+namespace XCam {
+
+static bool
+is_stable (double last, double value)
+{
+    if (last <= 0.0)
+        return false;
+    return fabs (value - last) / last < XCAM_CONVERGENCE_TOLERANCE;
+}
+
+X3aWarmStartFile::X3aWarmStartFile (const char *dir, const char *sensor, const char *scene)
+    : _path (NULL)
+{
+    char path[512];
+
+    snprintf (
+        path, sizeof (path), "%s/%s-%s.x3a",
+        (dir ? dir : "."), XCAM_STR (sensor), (scene ? scene : "default"));
+    _path = strdup (path);
+}
+
+X3aWarmStartFile::~X3aWarmStartFile ()
+{
+    if (_path)
+        xcam_free (_path);
+}
+
+bool
+X3aWarmStartFile::load (X3aWarmState &state)
+{
+    FILE *file = fopen (_path, "rb");
+    size_t size = 0;
+
+    if (!file) {
+        XCAM_LOG_DEBUG ("no 3a warm state(%s) to load", _path);
+        return false;
+    }
+    size = fread (&state, 1, sizeof (state), file);
+    fclose (file);
+
+    XCAM_FAIL_RETURN (
+        WARNING,
+        size == sizeof (state) &&
+        state.magic == XCAM_WARM_STATE_MAGIC && state.version == XCAM_WARM_STATE_VERSION,
+        false,
+        "3a warm state(%s) invalid, ignored", _path);
+    XCAM_FAIL_RETURN (
+        WARNING,
+        state.exposure_time > 0 && state.analog_gain > 0.0 &&
+        state.r_gain > 0.0 && state.b_gain > 0.0,
+        false,
+        "3a warm state(%s) out of range, ignored", _path);
+    return true;
+}
+
+bool
+X3aWarmStartFile::save (const X3aWarmState &state)
+{
+    char tmp_path[512];
+    FILE *file = NULL;
+    size_t size = 0;
+
+    snprintf (tmp_path, sizeof (tmp_path), "%s.tmp", _path);
+    file = fopen (tmp_path, "wb");
+    XCAM_FAIL_RETURN (WARNING, file, false, "open 3a warm state(%s) failed", tmp_path);
+
+    size = fwrite (&state, 1, sizeof (state), file);
+    if (fclose (file) != 0 || size != sizeof (state)) {
+        XCAM_LOG_WARNING ("write 3a warm state(%s) failed", tmp_path);
+        unlink (tmp_path);
+        return false;
+    }
+
+    // readers see the old or the new state, never a partial one
+    XCAM_FAIL_RETURN (
+        WARNING,
+        rename (tmp_path, _path) == 0,
+        false,
+        "replace 3a warm state(%s) failed", _path);
+    return true;
+}
+
+X3aConvergenceTracker::X3aConvergenceTracker ()
+{
+    reset ();
+}
+
+void
+X3aConvergenceTracker::reset ()
+{
+    xcam_mem_clear (_state);
+    _state.magic = XCAM_WARM_STATE_MAGIC;
+    _state.version = XCAM_WARM_STATE_VERSION;
+    _state.analog_gain = 1.0;
+    _state.digital_gain = 1.0;
+    _state.r_gain = 1.0;
+    _state.gr_gain = 1.0;
+    _state.gb_gain = 1.0;
+    _state.b_gain = 1.0;
+    _has_exposure = false;
+    _has_wb = false;
+    _stable_count = 0;
+    _window_exposures = 0;
+}
+
+bool
+X3aConvergenceTracker::update (const X3aResultList &results, uint32_t cct)
+{
+    bool was_converged = is_converged ();
+    bool updated = false;
+    bool stable = true;
+    bool exposure_updated = false;
+
+    for (X3aResultList::const_iterator i_res = results.begin (); i_res != results.end (); ++i_res) {
+        SmartPtr<X3aResult> res = *i_res;
+
+        // isp specific results derive from the standard ones
+        SmartPtr<X3aExposureResult> exposure = res.dynamic_cast_ptr<X3aExposureResult> ();
+        if (exposure.ptr ()) {
+            const XCam3aResultExposure &value = exposure->get_standard_result ();
+            double last = (double)_state.exposure_time * _state.analog_gain * _state.digital_gain;
+            double now = (double)value.exposure_time * value.analog_gain * value.digital_gain;
+
+            stable = stable && _has_exposure && is_stable (last, now);
+            _state.exposure_time = value.exposure_time;
+            _state.analog_gain = value.analog_gain;
+            _state.digital_gain = value.digital_gain;
+            _has_exposure = true;
+            exposure_updated = true;
+            updated = true;
+            continue;
+        }
+
+        SmartPtr<X3aWhiteBalanceResult> wb = res.dynamic_cast_ptr<X3aWhiteBalanceResult> ();
+        if (wb.ptr ()) {
+            const XCam3aResultWhiteBalance &value = wb->get_standard_result ();
+
+            stable = stable && _has_wb &&
+                     is_stable (_state.r_gain, value.r_gain) && is_stable (_state.b_gain, value.b_gain);
+            _state.r_gain = value.r_gain;
+            _state.gr_gain = value.gr_gain;
+            _state.gb_gain = value.gb_gain;
+            _state.b_gain = value.b_gain;
+            _has_wb = true;
+            updated = true;
+        }
+    }
+
+    // analyses without ae/awb results, e.g. between ae intervals, don't count
+    if (!updated)
+        return false;
+
+    if (cct)
+        _state.cct = cct;
+    if (stable && _has_exposure) {
+        ++_stable_count;
+        if (exposure_updated)
+            ++_window_exposures;
+    } else {
+        _stable_count = 0;
+        _window_exposures = 0;
+    }
+
+    return !was_converged && is_converged ();
+}
+
+};
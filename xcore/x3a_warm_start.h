@@ -0,0 +1,107 @@
+/*
+ * x3a_warm_start.h - converged 3a state kept across sessions
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_3A_WARM_START_H
+#define XCAM_3A_WARM_START_H
+
+#include "xcam_utils.h"
+#include "x3a_result.h"
+
+#define XCAM_WARM_STATE_MAGIC              0x53574158  // "XAWS"
+#define XCAM_WARM_STATE_VERSION            1
+// relative change between analyses below which ae/awb counts as stable
+#define XCAM_CONVERGENCE_TOLERANCE         0.05
+#define XCAM_CONVERGENCE_STABLE_COUNT      3
+
+namespace XCam {
+
+struct X3aWarmState {
+    uint32_t   magic;
+    uint32_t   version;
+    int64_t    exposure_time;   // us
+    double     analog_gain;
+    double     digital_gain;
+    double     r_gain;
+    double     gr_gain;
+    double     gb_gain;
+    double     b_gain;
+    uint32_t   cct;
+    uint32_t   reserved;
+};
+
+/*
+ * X3aWarmStartFile, one small file per sensor and scene,
+ * <dir>/<sensor>-<scene>.x3a, replaced atomically on save.
+ */
+class X3aWarmStartFile {
+public:
+    explicit X3aWarmStartFile (const char *dir, const char *sensor, const char *scene);
+    ~X3aWarmStartFile ();
+
+    bool load (X3aWarmState &state);
+    bool save (const X3aWarmState &state);
+
+    const char *get_path () const {
+        return _path;
+    }
+
+private:
+    XCAM_DEAD_COPY (X3aWarmStartFile);
+
+private:
+    char     *_path;
+};
+
+/*
+ * X3aConvergenceTracker, fed with results of each analysis,
+ * exposure counts as stable when time * gains moved less than
+ * XCAM_CONVERGENCE_TOLERANCE, white balance when r and b gains did.
+ * converged after XCAM_CONVERGENCE_STABLE_COUNT stable analyses in a row.
+ */
+class X3aConvergenceTracker {
+public:
+    X3aConvergenceTracker ();
+
+    void reset ();
+    // true if this analysis made the state converged
+    bool update (const X3aResultList &results, uint32_t cct);
+
+    // wb-only analyses between ae runs don't prove ae converged
+    bool is_converged () const {
+        return _stable_count >= XCAM_CONVERGENCE_STABLE_COUNT && _window_exposures > 0;
+    }
+    const X3aWarmState &get_state () const {
+        return _state;
+    }
+
+private:
+    XCAM_DEAD_COPY (X3aConvergenceTracker);
+
+private:
+    X3aWarmState   _state;
+    bool           _has_exposure;
+    bool           _has_wb;
+    uint32_t       _stable_count;
+    uint32_t       _window_exposures;  // stable exposure results in current stable run
+};
+
+};
+
+#endif //XCAM_3A_WARM_START_H
@@ -27,7 +27,7 @@
 namespace XCam {
 
 AnalyzerThread::AnalyzerThread (XAnalyzer *analyzer)
-    : Thread ("AnalyzerThread")
+    : TaskThread ("AnalyzerThread")
     , _analyzer (analyzer)
 {}
 
@@ -39,7 +39,13 @@ AnalyzerThread::~AnalyzerThread ()
 bool
 AnalyzerThread::push_stats (const SmartPtr<BufferProxy> &buffer)
 {
-    _stats_queue.push (buffer);
+    buffer->add_stamp (XCAM_STAMP_STATS_PUSH);
+    if (_stats_queue.push (buffer)) {
+        ++_analyzer->_stats_in;
+        wakeup ();
+    } else {
+        ++_analyzer->_stats_dropped;
+    }
     return true;
 }
 
@@ -62,19 +68,27 @@ AnalyzerThread::started ()
 bool
 AnalyzerThread::loop ()
 {
-    const static int32_t timeout = -1;
     SmartPtr<BufferProxy> latest_stats;
-    SmartPtr<BufferProxy> stats = _stats_queue.pop (timeout);
+    // one stats queued per wakeup, don't wait
+    SmartPtr<BufferProxy> stats = _stats_queue.pop (0);
     if (!stats.ptr()) {
-        XCAM_LOG_DEBUG ("analyzer thread got empty stats, stop thread");
-        return false;
+        XCAM_LOG_DEBUG ("analyzer thread got empty stats");
+        return true;
+    }
+    if (_analyzer->_stats_latest_only) {
+        // older stats go back to X3aStatsPool on reassignment
+        while ((latest_stats = _stats_queue.pop (0)).ptr ()) {
+            stats = std::move (latest_stats);
+            ++_analyzer->_stats_skipped;
+        }
+    }
+    if (is_stats_expired (stats)) {
+        ++_analyzer->_stats_skipped;
+        XCAM_LOG_DEBUG ("analyzer(%s) skipped expired 3a stats", XCAM_STR(_analyzer->get_name()));
+        return true;
     }
-    //while ((latest_stats = _stats_queue.pop (0)).ptr ()) {
-    //    stats = latest_stats;
-    //    XCAM_LOG_WARNING ("lost 3a stats since 3a analyzer too slow");
-    //}
 
-    XCamReturn ret = _analyzer->analyze (stats);
+    XCamReturn ret = _analyzer->analyze_timed (stats);
     if (ret == XCAM_RETURN_NO_ERROR || ret == XCAM_RETURN_BYPASS)
         return true;
 
@@ -82,6 +96,21 @@ AnalyzerThread::loop ()
     return false;
 }
 
+bool
+AnalyzerThread::is_stats_expired (const SmartPtr<BufferProxy> &stats)
+{
+    uint32_t count = 0;
+    const VideoBufferStamp *stamps = NULL;
+
+    if (_analyzer->_stats_max_age <= 0)
+        return false;
+
+    stamps = stats->get_stamps (count);
+    if (!count)
+        return false;
+    return xcam_get_monotonic_time () - stamps[count - 1].time > _analyzer->_stats_max_age;
+}
+
 void
 AnalyzerCallback::x3a_calculation_done (XAnalyzer *analyzer, X3aResultList &results)
 {
@@ -115,6 +144,14 @@ XAnalyzer::XAnalyzer (const char *name)
     , _height (0)
     , _framerate (30.0)
     , _callback (NULL)
+    , _stats_latest_only (false)
+    , _stats_max_age (0)
+    , _stats_in (0)
+    , _stats_dropped (0)
+    , _stats_skipped (0)
+    , _stats_analyzed (0)
+    , _analyze_time (0)
+    , _analyze_max_time (0)
 {
     if (name)
         _name = strdup (name);
@@ -191,6 +228,30 @@ XAnalyzer::set_sync_mode (bool sync)
     return XCAM_RETURN_NO_ERROR;
 }
 
+XCamReturn
+XAnalyzer::set_stats_coalesce (bool latest_only, int64_t max_age)
+{
+    if (_started) {
+        XCAM_LOG_ERROR ("can't set_stats_coalesce after analyzer started");
+        return XCAM_RETURN_ERROR_PARAM;
+    }
+    _stats_latest_only = latest_only;
+    _stats_max_age = max_age;
+    return XCAM_RETURN_NO_ERROR;
+}
+
+XCamReturn
+XAnalyzer::set_thread_attributes (const ThreadAttributes &attrs)
+{
+    if (_started) {
+        XCAM_LOG_ERROR ("can't set_thread_attributes after analyzer started");
+        return XCAM_RETURN_ERROR_PARAM;
+    }
+    if (!_analyzer_thread->set_attributes (attrs))
+        return XCAM_RETURN_ERROR_THREAD;
+    return XCAM_RETURN_NO_ERROR;
+}
+
 XCamReturn
 XAnalyzer::start ()
 {
@@ -235,7 +296,8 @@ XAnalyzer::push_buffer (const SmartPtr<BufferProxy> &buffer)
 
     if (get_sync_mode ()) {
         SmartPtr<BufferProxy> data = buffer;
-        ret = analyze (data);
+        ++_stats_in;
+        ret = analyze_timed (data);
     }
     else {
         if (!_analyzer_thread->is_running())
@@ -248,6 +310,34 @@ XAnalyzer::push_buffer (const SmartPtr<BufferProxy> &buffer)
     return ret;
 }
 
+XCamReturn
+XAnalyzer::analyze_timed (SmartPtr<BufferProxy> &buffer)
+{
+    int64_t start_time = xcam_get_monotonic_time ();
+    XCamReturn ret = analyze (buffer);
+    int64_t analyze_time = xcam_get_monotonic_time () - start_time;
+    int64_t max_time = _analyze_max_time.load ();
+
+    while (analyze_time > max_time && !_analyze_max_time.compare_exchange_weak (max_time, analyze_time));
+    _analyze_time += analyze_time;
+    ++_stats_analyzed;
+    return ret;
+}
+
+void
+XAnalyzer::get_metrics (PipelineMetrics &metrics)
+{
+    uint64_t analyzed = _stats_analyzed.load ();
+
+    metrics.stats_in += _stats_in.load ();
+    metrics.stats_dropped += _stats_dropped.load ();
+    metrics.stats_skipped += _stats_skipped.load ();
+    metrics.stats_analyzed += analyzed;
+    metrics.analyze_mean_time = analyzed ? _analyze_time.load () / (int64_t)analyzed : 0;
+    metrics.analyze_max_time = _analyze_max_time.load ();
+    metrics.add_queue (_name, "stats", _analyzer_thread->get_queue_depth ());
+}
+
 void
 XAnalyzer::set_results_timestamp (X3aResultList &results, int64_t timestamp)
 {
@@ -24,15 +24,18 @@
 
 #include "xcam_utils.h"
 #include "handler_interface.h"
-#include "xcam_thread.h"
+#include "xcam_executor.h"
 #include "buffer_pool.h"
+#include "ring_queue.h"
+#include "pipeline_metrics.h"
+#include <atomic>
 
 namespace XCam {
 
 class XAnalyzer;
 
 class AnalyzerThread
-    : public Thread
+    : public TaskThread
 {
 public:
     AnalyzerThread (XAnalyzer *analyzer);
@@ -42,6 +45,9 @@ public:
         _stats_queue.pause_pop ();
     }
     bool push_stats (const SmartPtr<BufferProxy> &buffer);
+    uint32_t get_queue_depth () {
+        return _stats_queue.size ();
+    }
 
 protected:
     virtual bool started ();
@@ -50,9 +56,12 @@ protected:
     }
     virtual bool loop ();
 
+private:
+    bool is_stats_expired (const SmartPtr<BufferProxy> &stats);
+
 private:
     XAnalyzer              *_analyzer;
-    SafeList<BufferProxy>   _stats_queue;
+    MpmcRingQueue<BufferProxy>  _stats_queue;
 };
 
 class AnalyzerCallback {
@@ -82,12 +91,22 @@ public:
     XCamReturn deinit ();
     // set_sync_mode must be called before start
     XCamReturn set_sync_mode (bool sync);
+    // attributes of analyzer thread, must be called before start
+    XCamReturn set_thread_attributes (const ThreadAttributes &attrs);
     bool get_sync_mode () const {
         return _sync;
     };
+    /*
+     * async mode stats policy, must be called before start
+     * @latest_only, analyze newest queued stats, older ones skipped
+     * @max_age, stats queued longer than @max_age microseconds are skipped, 0 disables
+     */
+    XCamReturn set_stats_coalesce (bool latest_only, int64_t max_age = 0);
     XCamReturn start ();
     XCamReturn stop ();
     XCamReturn push_buffer (const SmartPtr<BufferProxy> &buffer);
+    // stats counters, analysis time and stats queue depth
+    void get_metrics (PipelineMetrics &metrics);
 
     uint32_t get_width () const {
         return _width;
@@ -120,6 +139,7 @@ protected:
     void set_results_timestamp (X3aResultList &results, int64_t timestamp);
 
 private:
+    XCamReturn analyze_timed (SmartPtr<BufferProxy> &buffer);
 
     XCAM_DEAD_COPY (XAnalyzer);
 
@@ -134,6 +154,15 @@ private:
     uint32_t                 _height;
     double                   _framerate;
     AnalyzerCallback        *_callback;
+    bool                     _stats_latest_only;
+    int64_t                  _stats_max_age;
+
+    std::atomic<uint64_t>    _stats_in;
+    std::atomic<uint64_t>    _stats_dropped;
+    std::atomic<uint64_t>    _stats_skipped;
+    std::atomic<uint64_t>    _stats_analyzed;
+    std::atomic<int64_t>     _analyze_time;
+    std::atomic<int64_t>     _analyze_max_time;
 };
 
 }
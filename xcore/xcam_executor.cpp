@@ -0,0 +1,526 @@
+/*
+ * xcam_executor.cpp - process-wide task executor
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "xcam_executor.h"
+#include <deque>
+#include <sched.h>
+#include <unistd.h>
+
+#define XCAM_NUMA_NODE_PATH "/sys/devices/system/node/node%d/cpulist"
+#define XCAM_NUMA_ONLINE_PATH "/sys/devices/system/node/online"
+
+namespace XCam {
+
+typedef std::vector<cpu_set_t> NodeCpuList;
+
+class ExecutorWorker
+    : public Thread
+{
+    friend class Executor;
+
+public:
+    ExecutorWorker (Executor *executor, uint32_t index, uint32_t node, const char *name)
+        : Thread (name)
+        , _executor (executor)
+        , _index (index)
+        , _node (node)
+    {}
+
+protected:
+    virtual bool started ();
+    virtual bool loop ();
+
+private:
+    Executor                    *_executor;
+    uint32_t                     _index;
+    uint32_t                     _node;
+    Mutex                        _tasks_mutex;
+    std::deque<SmartPtr<Task> >  _tasks;
+};
+
+static thread_local ExecutorWorker *current_worker = NULL;
+static thread_local TaskThread *current_task_thread = NULL;
+
+bool
+ExecutorWorker::started ()
+{
+    current_worker = this;
+    return true;
+}
+
+bool
+ExecutorWorker::loop ()
+{
+    SmartPtr<Task> task = _executor->wait_task (_index);
+    if (!task.ptr ())
+        return false;
+
+    task->run ();
+    return true;
+}
+
+// parse cpulist like "0-3,8-11", false if not readable, empty list is fine
+static bool
+parse_cpu_list (const char *path, cpu_set_t &cpus)
+{
+    char list[256];
+    char *pos = list;
+    FILE *file = fopen (path, "r");
+
+    CPU_ZERO (&cpus);
+    if (!file)
+        return false;
+    xcam_mem_clear (list);
+    if (!fgets (list, sizeof (list), file)) {
+        fclose (file);
+        return true;
+    }
+    fclose (file);
+
+    while (*pos >= '0' && *pos <= '9') {
+        char *end = NULL;
+        int first = strtol (pos, &end, 10);
+        int last = first;
+        if (*end == '-')
+            last = strtol (end + 1, &end, 10);
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET (cpu, &cpus);
+        pos = (*end == ',' ? end + 1 : end);
+    }
+    return true;
+}
+
+// CPUs this process may run on, taskset or cpuset applied
+static void
+get_process_cpus (cpu_set_t &cpus)
+{
+    CPU_ZERO (&cpus);
+    if (sched_getaffinity (0, sizeof (cpus), &cpus) == 0 && CPU_COUNT (&cpus))
+        return;
+
+    long count = sysconf (_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < count && cpu < CPU_SETSIZE; ++cpu)
+        CPU_SET (cpu, &cpus);
+}
+
+static void
+get_numa_nodes (NodeCpuList &nodes)
+{
+    char path[64];
+    cpu_set_t allowed, online, cpus;
+
+    get_process_cpus (allowed);
+
+    // node ids may be sparse, online is a list of them in cpulist format
+    if (parse_cpu_list (XCAM_NUMA_ONLINE_PATH, online)) {
+        for (int node = 0; node < CPU_SETSIZE; ++node) {
+            if (!CPU_ISSET (node, &online))
+                continue;
+            snprintf (path, sizeof (path), XCAM_NUMA_NODE_PATH, node);
+            if (!parse_cpu_list (path, cpus))
+                continue;
+            // CPU-less node, or none of its CPUs allowed to this process
+            CPU_AND (&cpus, &cpus, &allowed);
+            if (!CPU_COUNT (&cpus))
+                continue;
+            nodes.push_back (cpus);
+        }
+    }
+
+    // no NUMA info, take all CPUs of the process as one node
+    if (nodes.empty ())
+        nodes.push_back (allowed);
+}
+
+SmartPtr<Executor> Executor::_instance (NULL);
+Mutex Executor::_instance_mutex;
+uint32_t Executor::_workers_per_node = XCAM_EXECUTOR_DEFAULT_WORKERS_PER_NODE;
+
+SmartPtr<Executor>
+Executor::instance ()
+{
+    SmartLock lock (_instance_mutex);
+    if (_instance.ptr ())
+        return _instance;
+    _instance = new Executor (_workers_per_node);
+    return _instance;
+}
+
+void
+Executor::set_workers_per_node (uint32_t count)
+{
+    SmartLock lock (_instance_mutex);
+    if (_instance.ptr ()) {
+        XCAM_LOG_WARNING ("executor already running, workers per node not changed");
+        return;
+    }
+    _workers_per_node = count;
+}
+
+Executor::Executor (uint32_t workers_per_node)
+    : _queued (0)
+    , _sleepers (0)
+    , _next_worker (0)
+    , _running (true)
+{
+    NodeCpuList nodes;
+    ThreadAttributes attrs;
+    get_numa_nodes (nodes);
+
+    for (uint32_t node = 0; node < nodes.size (); ++node) {
+        uint32_t count = CPU_COUNT (&nodes[node]);
+        if (workers_per_node && workers_per_node < count)
+            count = workers_per_node;
+        attrs.cpus = nodes[node];
+        for (uint32_t i = 0; i < count; ++i) {
+            SmartPtr<ExecutorWorker> worker =
+                new ExecutorWorker (this, _workers.size (), node, "xcam_worker");
+            worker->set_attributes (attrs);
+            _workers.push_back (worker);
+        }
+    }
+
+    // a task waiting for another stage to stop needs a second worker to run it
+    if (_workers.size () < 2) {
+        attrs.cpus = nodes[0];
+        _workers.push_back (new ExecutorWorker (this, _workers.size (), 0, "xcam_worker"));
+        _workers.back ()->set_attributes (attrs);
+    }
+
+    start_workers ();
+    XCAM_LOG_INFO (
+        "executor started %d workers on %d nodes",
+        (uint32_t)_workers.size (), (uint32_t)nodes.size ());
+}
+
+Executor::Executor (const char *name, const ThreadAttributes &attrs)
+    : _queued (0)
+    , _sleepers (0)
+    , _next_worker (0)
+    , _running (true)
+{
+    SmartPtr<ExecutorWorker> worker = new ExecutorWorker (this, 0, 0, name);
+    if (!worker->set_attributes (attrs)) {
+        XCAM_LOG_WARNING ("executor(%s) attributes not accepted, use default", XCAM_STR (name));
+    }
+    _workers.push_back (worker);
+    start_workers ();
+}
+
+SmartPtr<Executor>
+Executor::create_dedicated (const char *name, const ThreadAttributes &attrs)
+{
+    return new Executor (name, attrs);
+}
+
+void
+Executor::start_workers ()
+{
+    // workers are all created before any of them steals from the others
+    for (uint32_t i = 0; i < _workers.size (); ++i) {
+        if (!_workers[i]->start ()) {
+            XCAM_LOG_ERROR ("executor start worker(%d) failed", i);
+        }
+    }
+}
+
+Executor::~Executor ()
+{
+    stop ();
+}
+
+void
+Executor::stop ()
+{
+    {
+        SmartLock lock (_mutex);
+        _running = false;
+        _task_cond.broadcast ();
+    }
+    for (uint32_t i = 0; i < _workers.size (); ++i)
+        _workers[i]->stop ();
+}
+
+void
+Executor::post (const SmartPtr<Task> &task)
+{
+    ExecutorWorker *worker = current_worker;
+
+    XCAM_ASSERT (task.ptr ());
+    // tasks posted from a worker stay on it while it is busy, others may steal them
+    if (!worker || worker->_executor != this)
+        worker = _workers[_next_worker++ % _workers.size ()].ptr ();
+
+    // counted before published, a stealing worker never takes it below zero
+    ++_queued;
+    {
+        SmartLock lock (worker->_tasks_mutex);
+        worker->_tasks.push_back (task);
+    }
+
+    if (_sleepers) {
+        SmartLock lock (_mutex);
+        _task_cond.signal ();
+    }
+}
+
+SmartPtr<Task>
+Executor::take_task (uint32_t index)
+{
+    SmartPtr<Task> task;
+    ExecutorWorker *self = _workers[index].ptr ();
+    uint32_t count = _workers.size ();
+
+    {
+        SmartLock lock (self->_tasks_mutex);
+        if (!self->_tasks.empty ()) {
+            task = std::move (self->_tasks.front ());
+            self->_tasks.pop_front ();
+        }
+    }
+
+    // steal from same node first, then other nodes
+    for (uint32_t pass = 0; pass < 2 && !task.ptr (); ++pass) {
+        for (uint32_t i = 1; i < count && !task.ptr (); ++i) {
+            ExecutorWorker *victim = _workers[(index + i) % count].ptr ();
+            if ((victim->_node == self->_node) != (pass == 0))
+                continue;
+
+            SmartLock lock (victim->_tasks_mutex);
+            if (!victim->_tasks.empty ()) {
+                task = std::move (victim->_tasks.back ());
+                victim->_tasks.pop_back ();
+            }
+        }
+    }
+
+    if (task.ptr ())
+        --_queued;
+    return task;
+}
+
+bool
+Executor::is_current_worker () const
+{
+    return current_worker && current_worker->_executor == this;
+}
+
+SmartPtr<Task>
+Executor::wait_task (uint32_t index)
+{
+    while (_running) {
+        SmartPtr<Task> task = take_task (index);
+        if (task.ptr ())
+            return task;
+
+        SmartLock lock (_mutex);
+        ++_sleepers;
+        while (!_queued && _running)
+            _task_cond.wait (_mutex);
+        --_sleepers;
+    }
+    return NULL;
+}
+
+class TaskThreadRunner
+    : public Task
+{
+public:
+    explicit TaskThreadRunner (TaskThread *thread)
+        : _thread (thread)
+    {}
+
+    virtual void run () {
+        _thread->run ();
+    }
+
+private:
+    TaskThread  *_thread;
+};
+
+TaskThread::TaskThread (const char *name)
+    : _name (NULL)
+    , _started (false)
+    , _entered (false)
+    , _missed (0)
+    , _pending (0)
+{
+    if (name)
+        _name = strdup (name);
+
+    _runner = new TaskThreadRunner (this);
+    _executor = Executor::instance ();
+}
+
+TaskThread::~TaskThread ()
+{
+    {
+        // runner may still be queued on executor
+        SmartLock lock (_mutex);
+        _started = false;
+        while (_pending)
+            _idle_cond.wait (_mutex);
+    }
+
+    if (_name)
+        xcam_free (_name);
+}
+
+bool
+TaskThread::started ()
+{
+    XCAM_LOG_DEBUG ("TaskThread(%s) started", XCAM_STR(_name));
+    return true;
+}
+
+void
+TaskThread::stopped ()
+{
+    XCAM_LOG_DEBUG ("TaskThread(%s) stopped", XCAM_STR(_name));
+}
+
+bool
+TaskThread::set_attributes (const ThreadAttributes &attrs)
+{
+    SmartLock lock (_mutex);
+    XCAM_FAIL_RETURN (
+        WARNING,
+        !_started && !_pending,
+        false,
+        "TaskThread(%s) is running, set attributes before start", XCAM_STR(_name));
+
+    _executor = Executor::create_dedicated (_name, attrs);
+    return true;
+}
+
+bool
+TaskThread::start ()
+{
+    uint32_t missed = 0;
+    {
+        SmartLock lock (_mutex);
+        if (_started)
+            return true;
+        _started = true;
+        _entered = false;
+        missed = _missed;
+        _missed = 0;
+    }
+
+    // one run for started (), one loop for each wakeup that came while stopped
+    if (_pending.fetch_add (missed + 1) == 0)
+        _executor->post (_runner);
+    return true;
+}
+
+bool
+TaskThread::stop ()
+{
+    if (current_task_thread == this) {
+        // called from own loop (), the running call is pending itself, don't wait for it
+        {
+            SmartLock lock (_mutex);
+            if (!_started)
+                return true;
+            _started = false;
+        }
+        stopped ();
+        return true;
+    }
+
+    // a single worker can't run our pending loop while blocked here
+    XCAM_FAIL_RETURN (
+        ERROR,
+        !_executor->is_current_worker () || _executor->get_worker_count () > 1,
+        false,
+        "TaskThread(%s) stop from a task on its single worker executor would deadlock", XCAM_STR(_name));
+
+    {
+        SmartLock lock (_mutex);
+        if (!_started)
+            return true;
+        _started = false;
+        while (_pending)
+            _idle_cond.wait (_mutex);
+        // items of this session are dropped by owner, only later wakeups count
+        _missed = 0;
+    }
+
+    stopped ();
+    return true;
+}
+
+bool
+TaskThread::is_running ()
+{
+    SmartLock lock (_mutex);
+    return _started;
+}
+
+void
+TaskThread::wakeup ()
+{
+    if (_pending++ == 0)
+        _executor->post (_runner);
+}
+
+void
+TaskThread::run ()
+{
+    for (uint32_t i = 0; i < XCAM_TASK_THREAD_BATCH_COUNT; ++i) {
+        bool running = false, first = false;
+
+        {
+            SmartLock lock (_mutex);
+            running = _started;
+            first = (running && !_entered);
+            _entered = _entered || running;
+            // queued item not taken, replayed on next start
+            if (!running)
+                ++_missed;
+        }
+
+        current_task_thread = this;
+        bool loop_stopped = running && !(first ? started () : loop ());
+        current_task_thread = NULL;
+
+        if (loop_stopped) {
+            bool stop_here = false;
+            {
+                SmartLock lock (_mutex);
+                stop_here = _started;
+                _started = false;
+            }
+            if (stop_here)
+                stopped ();
+        }
+
+        SmartLock lock (_mutex);
+        if (--_pending == 0) {
+            _idle_cond.broadcast ();
+            return;
+        }
+    }
+
+    // more wakeups pending, queue again behind other tasks
+    _executor->post (_runner);
+}
+
+};
@@ -0,0 +1,153 @@
+/*
+ * xcam_executor.h - process-wide task executor
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_EXECUTOR_H
+#define XCAM_EXECUTOR_H
+
+#include "xcam_utils.h"
+#include "xcam_mutex.h"
+#include "xcam_thread.h"
+#include "smartptr.h"
+#include <atomic>
+#include <vector>
+
+#define XCAM_EXECUTOR_DEFAULT_WORKERS_PER_NODE 4
+// loops a TaskThread runs before giving its worker to other tasks
+#define XCAM_TASK_THREAD_BATCH_COUNT 16
+
+namespace XCam {
+
+class ExecutorWorker;
+
+class Task
+    : public RefObj
+{
+public:
+    Task () {}
+    virtual ~Task () {}
+
+    virtual void run () = 0;
+
+private:
+    XCAM_DEAD_COPY (Task);
+};
+
+/*
+ * Executor, worker threads shared by all pipeline stages of the process.
+ * Workers are spread over NUMA nodes and pinned to the CPUs of their node,
+ * each worker runs its own tasks in post order, when idle it steals the newest
+ * tasks of workers on the same node first, then of other nodes.
+ */
+class Executor {
+    friend class ExecutorWorker;
+
+public:
+    ~Executor ();
+
+    static SmartPtr<Executor> instance ();
+    // must be called before first instance (), 0 means one worker per CPU
+    static void set_workers_per_node (uint32_t count);
+    // private executor of one worker created with @attrs, for stages needing own CPU/priority
+    static SmartPtr<Executor> create_dedicated (const char *name, const ThreadAttributes &attrs);
+
+    void post (const SmartPtr<Task> &task);
+    uint32_t get_worker_count () const {
+        return _workers.size ();
+    }
+    // true if called from a worker of this executor
+    bool is_current_worker () const;
+
+private:
+    explicit Executor (uint32_t workers_per_node);
+    explicit Executor (const char *name, const ThreadAttributes &attrs);
+    void start_workers ();
+    SmartPtr<Task> take_task (uint32_t index);
+    SmartPtr<Task> wait_task (uint32_t index);
+    void stop ();
+    XCAM_DEAD_COPY (Executor);
+
+private:
+    static SmartPtr<Executor>              _instance;
+    static Mutex                           _instance_mutex;
+    static uint32_t                        _workers_per_node;
+
+    std::vector<SmartPtr<ExecutorWorker> > _workers;
+    std::atomic<uint32_t>                  _queued;
+    std::atomic<uint32_t>                  _sleepers;
+    std::atomic<uint32_t>                  _next_worker;
+    std::atomic<bool>                      _running;
+    Mutex                                  _mutex;
+    Cond                                   _task_cond;
+};
+
+/*
+ * TaskThread, pipeline stage with the same start/stop/loop contract as Thread,
+ * but loop () runs on Executor workers instead of a dedicated thread.
+ * loop () is called once per wakeup (), in order and never concurrently,
+ * so it must not block waiting for input; producers call wakeup ()
+ * after queuing each item. started () runs as the first call after start (),
+ * wakeups that came while stopped each get their loop () after it.
+ * stop () from own loop () returns without waiting for the running call.
+ */
+class TaskThread {
+    friend class TaskThreadRunner;
+
+public:
+    explicit TaskThread (const char *name = NULL);
+    virtual ~TaskThread ();
+
+    // run on a dedicated worker with @attrs instead of shared workers, call before start
+    bool set_attributes (const ThreadAttributes &attrs);
+
+    bool start ();
+    bool stop ();
+    bool is_running ();
+    void wakeup ();
+
+    const char *get_name () const {
+        return _name;
+    }
+
+protected:
+    // return true to start loop, else the task thread stopped
+    virtual bool started ();
+    virtual void stopped ();
+    // return true to continue; false to stop
+    virtual bool loop () = 0;
+
+private:
+    void run ();
+    XCAM_DEAD_COPY (TaskThread);
+
+private:
+    char                  *_name;
+    Mutex                  _mutex;
+    Cond                   _idle_cond;
+    bool                   _started;
+    bool                   _entered;
+    uint32_t               _missed;     // wakeups while stopped
+    std::atomic<uint32_t>  _pending;
+    SmartPtr<Task>         _runner;
+    SmartPtr<Executor>     _executor;
+};
+
+};
+
+#endif //XCAM_EXECUTOR_H
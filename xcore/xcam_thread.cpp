@@ -21,9 +21,58 @@
 #include "xcam_thread.h"
 #include "xcam_mutex.h"
 #include <errno.h>
+#include <limits.h>
 
 namespace XCam {
 
+ThreadAttributes::ThreadAttributes ()
+    : policy (SCHED_OTHER)
+    , priority (0)
+    , stack_size (0)
+{
+    CPU_ZERO (&cpus);
+}
+
+void
+ThreadAttributes::add_cpu (uint32_t cpu)
+{
+    XCAM_ASSERT (cpu < CPU_SETSIZE);
+    CPU_SET (cpu, &cpus);
+}
+
+bool
+ThreadAttributes::has_cpus () const
+{
+    return CPU_COUNT (&cpus) > 0;
+}
+
+static void
+init_pthread_attr (pthread_attr_t &attr, const ThreadAttributes &attrs, bool realtime)
+{
+    pthread_attr_init (&attr);
+
+    if (attrs.stack_size) {
+        size_t stack_size = attrs.stack_size;
+        if (stack_size < (size_t)PTHREAD_STACK_MIN)
+            stack_size = PTHREAD_STACK_MIN;
+        pthread_attr_setstacksize (&attr, stack_size);
+    }
+
+    if (realtime) {
+        struct sched_param param;
+        xcam_mem_clear (param);
+        param.sched_priority = attrs.priority;
+        pthread_attr_setinheritsched (&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy (&attr, attrs.policy);
+        pthread_attr_setschedparam (&attr, &param);
+    }
+
+#ifdef __USE_GNU
+    if (attrs.has_cpus ())
+        pthread_attr_setaffinity_np (&attr, sizeof (attrs.cpus), &attrs.cpus);
+#endif
+}
+
 Thread::Thread (const char *name)
     : _name (NULL)
     , _thread_id (0)
@@ -50,25 +99,39 @@ Thread::thread_func (void *user_data)
         SmartLock locker(thread->_mutex);
         pthread_detach (pthread_self());
     }
+
+#ifdef __USE_GNU
+    // named in new thread, detached thread may already be gone for creator
+    char thread_name[16];
+    xcam_mem_clear (thread_name);
+    snprintf (thread_name, sizeof (thread_name), "xc:%s", XCAM_STR(thread->_name));
+    int name_ret = pthread_setname_np (pthread_self (), thread_name);
+    if (name_ret != 0) {
+        XCAM_LOG_WARNING ("Thread(%s) set name failed.(%d, %s)", XCAM_STR(thread->_name), name_ret, strerror(name_ret));
+    }
+#endif
     ret = thread->started ();
 
     while (true) {
         {
             SmartLock locker(thread->_mutex);
-            if (!thread->_started || ret == false) {
-                thread->_started = false;
-                thread->_thread_id = 0;
-                thread->_exit_cond.signal();
-                ret = false;
+            if (!thread->_started || ret == false)
                 break;
-            }
         }
 
         ret = thread->loop ();
     }
 
+    // before signal, thread object may be freed once stop () returns
     thread->stopped ();
 
+    {
+        SmartLock locker(thread->_mutex);
+        thread->_started = false;
+        thread->_thread_id = 0;
+        thread->_exit_cond.signal();
+    }
+
     return 0;
 }
 
@@ -85,25 +148,55 @@ Thread::stopped ()
     XCAM_LOG_DEBUG ("Thread(%s) stopped", XCAM_STR(_name));
 }
 
+bool
+Thread::set_attributes (const ThreadAttributes &attrs)
+{
+    SmartLock locker(_mutex);
+    XCAM_FAIL_RETURN (
+        WARNING,
+        !_started,
+        false,
+        "Thread(%s) is running, set attributes before start", XCAM_STR(_name));
+
+    if (attrs.policy == SCHED_FIFO || attrs.policy == SCHED_RR) {
+        XCAM_FAIL_RETURN (
+            WARNING,
+            attrs.priority >= sched_get_priority_min (attrs.policy) &&
+            attrs.priority <= sched_get_priority_max (attrs.policy),
+            false,
+            "Thread(%s) real-time priority(%d) out of range", XCAM_STR(_name), attrs.priority);
+    }
+    _attrs = attrs;
+    return true;
+}
+
 bool Thread::start ()
 {
+    void * (*func) (void*) = (void * (*)(void*))thread_func;
+    pthread_attr_t attr;
+    bool realtime = (_attrs.policy == SCHED_FIFO || _attrs.policy == SCHED_RR);
+    int ret = 0;
+
     SmartLock locker(_mutex);
     if (_started)
         return true;
 
-    if (pthread_create (&_thread_id, NULL, (void * (*)(void*))thread_func, this) != 0)
-        return false;
-    _started = true;
+    init_pthread_attr (attr, _attrs, realtime);
+    ret = pthread_create (&_thread_id, &attr, func, this);
+    pthread_attr_destroy (&attr);
 
-#ifdef __USE_GNU
-    char thread_name[16];
-    xcam_mem_clear (thread_name);
-    snprintf (thread_name, sizeof (thread_name), "xc:%s", XCAM_STR(_name));
-    int ret = pthread_setname_np (_thread_id, thread_name);
+    if (ret == EPERM && realtime) {
+        XCAM_LOG_WARNING (
+            "Thread(%s) real-time scheduling not permitted, use default policy", XCAM_STR(_name));
+        init_pthread_attr (attr, _attrs, false);
+        ret = pthread_create (&_thread_id, &attr, func, this);
+        pthread_attr_destroy (&attr);
+    }
     if (ret != 0) {
-        XCAM_LOG_WARNING ("Thread(%s) set name to thread_id failed.(%d, %s)", XCAM_STR(_name), ret, strerror(ret));
+        XCAM_LOG_ERROR ("Thread(%s) create failed.(%d, %s)", XCAM_STR(_name), ret, strerror(ret));
+        return false;
     }
-#endif
+    _started = true;
 
     return true;
 }
@@ -23,14 +23,38 @@
 
 #include "xcam_utils.h"
 #include "xcam_mutex.h"
+#include <sched.h>
 
 namespace XCam {
 
+/*
+ * ThreadAttributes, applied when thread is created.
+ * empty cpu set keeps inherited affinity, stack_size 0 keeps default stack.
+ * SCHED_FIFO/SCHED_RR need CAP_SYS_NICE or RLIMIT_RTPRIO, thread falls back
+ * to SCHED_OTHER if real-time scheduling is not permitted.
+ */
+struct ThreadAttributes {
+    cpu_set_t      cpus;
+    int            policy;
+    int            priority;
+    uint32_t       stack_size;
+
+    ThreadAttributes ();
+    void add_cpu (uint32_t cpu);
+    bool has_cpus () const;
+};
+
 class Thread {
 public:
     Thread (const char *name = NULL);
     virtual ~Thread ();
 
+    // must be called before start
+    bool set_attributes (const ThreadAttributes &attrs);
+    const ThreadAttributes &get_attributes () const {
+        return _attrs;
+    }
+
     bool start ();
     bool stop ();
     bool is_running ();
@@ -49,11 +73,12 @@ private:
     static int thread_func (void *user_data);
 
 private:
-    char           *_name;
-    pthread_t       _thread_id;
-    XCam::Mutex     _mutex;
-    XCam::Cond      _exit_cond;
-    bool            _started;
+    char             *_name;
+    pthread_t         _thread_id;
+    XCam::Mutex       _mutex;
+    XCam::Cond        _exit_cond;
+    bool              _started;
+    ThreadAttributes  _attrs;
 };
 
 };
@@ -0,0 +1,264 @@
+/*
+ * xcam_trace.cpp - runtime tracing of pipeline spans
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#include "xcam_utils.h"
+#include "xcam_trace.h"
+#include "xcam_mutex.h"
+#include "smartptr.h"
+#include <list>
+#include <algorithm>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace XCam {
+
+struct TraceEvent {
+    int64_t      start;
+    int64_t      end;
+    const char  *category;
+    char         name[XCAM_TRACE_NAME_SIZE];
+};
+
+class TraceRing
+    : public RefObj
+{
+public:
+    explicit TraceRing (uint32_t size)
+        : events (size)
+        , mask (size - 1)
+        , head (0)
+        , cleared (0)
+        , thread_exited (false)
+    {
+        tid = syscall (SYS_gettid);
+        xcam_mem_clear (thread_name);
+        pthread_getname_np (pthread_self (), thread_name, sizeof (thread_name));
+    }
+
+    // only called by owner thread
+    void record (const char *category, const char *name, int64_t start, int64_t end) {
+        uint64_t pos = head.load (std::memory_order_relaxed);
+        TraceEvent &event = events[pos & mask];
+        event.start = start;
+        event.end = end;
+        event.category = category;
+        strncpy (event.name, XCAM_STR (name), XCAM_TRACE_NAME_SIZE - 1);
+        event.name[XCAM_TRACE_NAME_SIZE - 1] = '\0';
+        head.store (pos + 1, std::memory_order_release);
+    }
+
+    pid_t                     tid;
+    char                      thread_name[16];
+    std::vector<TraceEvent>   events;
+    uint32_t                  mask;
+    std::atomic<uint64_t>     head;
+    std::atomic<uint64_t>     cleared;   // events before it dropped by clear ()
+    std::atomic<bool>         thread_exited;
+};
+
+typedef std::list<SmartPtr<TraceRing> > TraceRingList;
+
+static Mutex          trace_mutex;
+static TraceRingList  trace_rings;
+static uint32_t       trace_ring_size = XCAM_TRACE_DEFAULT_RING_SIZE;
+
+// ring stays registered after thread exit so its events can still be dumped,
+// at most XCAM_TRACE_MAX_EXITED_RINGS of them
+class ThreadTraceRing {
+public:
+    ~ThreadTraceRing () {
+        uint32_t exited = 0;
+
+        if (!ring.ptr ())
+            return;
+
+        SmartLock lock (trace_mutex);
+        ring->thread_exited = true;
+        for (TraceRingList::iterator i_ring = trace_rings.begin (); i_ring != trace_rings.end (); ++i_ring)
+            exited += (*i_ring)->thread_exited ? 1 : 0;
+        // oldest first, list kept in registration order
+        for (TraceRingList::iterator i_ring = trace_rings.begin ();
+                i_ring != trace_rings.end () && exited > XCAM_TRACE_MAX_EXITED_RINGS;) {
+            if ((*i_ring)->thread_exited) {
+                i_ring = trace_rings.erase (i_ring);
+                --exited;
+            } else
+                ++i_ring;
+        }
+    }
+
+    TraceRing *get () {
+        if (!ring.ptr ()) {
+            SmartLock lock (trace_mutex);
+            ring = new TraceRing (trace_ring_size);
+            trace_rings.push_back (ring);
+        }
+        return ring.ptr ();
+    }
+
+private:
+    SmartPtr<TraceRing>  ring;
+};
+
+static thread_local ThreadTraceRing thread_ring;
+
+std::atomic<bool> Trace::_enabled (false);
+
+void
+Trace::enable (bool enable)
+{
+    _enabled.store (enable);
+    XCAM_LOG_INFO ("tracing %s", enable ? "enabled" : "disabled");
+}
+
+void
+Trace::set_ring_size (uint32_t size)
+{
+    uint32_t power = 1;
+    while (power < size && power < (1u << 31))
+        power <<= 1;
+
+    SmartLock lock (trace_mutex);
+    trace_ring_size = power;
+}
+
+void
+Trace::record (const char *category, const char *name, int64_t start, int64_t end)
+{
+    thread_ring.get ()->record (category, name, start, end);
+}
+
+static void
+write_json_string (FILE *file, const char *str)
+{
+    fputc ('"', file);
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\')
+            fputc ('\\', file);
+        if ((unsigned char)*str >= 0x20)
+            fputc (*str, file);
+    }
+    fputc ('"', file);
+}
+
+bool
+Trace::dump (const char *path)
+{
+    TraceRingList rings;
+    std::vector<TraceRing *> exited_rings;
+    pid_t pid = getpid ();
+    bool first = true;
+    FILE *file = NULL;
+
+    XCAM_ASSERT (path);
+    {
+        SmartLock lock (trace_mutex);
+        rings = trace_rings;
+    }
+
+    file = fopen (path, "w");
+    XCAM_FAIL_RETURN (
+        ERROR, file, false,
+        "trace dump open file(%s) failed", path);
+
+    fprintf (file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (TraceRingList::iterator i_ring = rings.begin (); i_ring != rings.end (); ++i_ring) {
+        TraceRing *ring = i_ring->ptr ();
+        if (ring->thread_exited)
+            exited_rings.push_back (ring);
+        uint64_t head = ring->head.load (std::memory_order_acquire);
+        uint64_t count = XCAM_MIN (head, (uint64_t)ring->events.size ());
+        count = XCAM_MIN (count, head - XCAM_MIN (head, ring->cleared.load ()));
+
+        fprintf (file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                 first ? "" : ",", pid, ring->tid);
+        write_json_string (file, ring->thread_name);
+        fprintf (file, "}}");
+        first = false;
+
+        for (uint64_t pos = head - count; pos < head; ++pos) {
+            const TraceEvent &event = ring->events[pos & ring->mask];
+            fprintf (file, ",\n{\"ph\":\"X\",\"cat\":\"%s\",\"name\":", event.category);
+            write_json_string (file, event.name);
+            fprintf (file, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                     pid, ring->tid, event.start / 1000.0, (event.end - event.start) / 1000.0);
+        }
+    }
+    fprintf (file, "\n]}\n");
+
+    if (fclose (file) != 0) {
+        XCAM_LOG_ERROR ("trace dump write file(%s) failed", path);
+        return false;
+    }
+
+    // events of exited threads can't grow any more, written once is enough
+    if (!exited_rings.empty ()) {
+        SmartLock lock (trace_mutex);
+        for (TraceRingList::iterator i_ring = trace_rings.begin (); i_ring != trace_rings.end ();) {
+            if (std::find (exited_rings.begin (), exited_rings.end (), i_ring->ptr ()) != exited_rings.end ())
+                i_ring = trace_rings.erase (i_ring);
+            else
+                ++i_ring;
+        }
+    }
+    XCAM_LOG_INFO ("trace dumped to %s", path);
+    return true;
+}
+
+void
+Trace::clear ()
+{
+    SmartLock lock (trace_mutex);
+    for (TraceRingList::iterator i_ring = trace_rings.begin (); i_ring != trace_rings.end ();) {
+        if ((*i_ring)->thread_exited) {
+            i_ring = trace_rings.erase (i_ring);
+            continue;
+        }
+        // head is only written by owner thread
+        (*i_ring)->cleared.store ((*i_ring)->head.load ());
+        ++i_ring;
+    }
+}
+
+static void
+dump_trace_at_exit ()
+{
+    const char *path = getenv (XCAM_TRACE_FILE_ENV);
+    Trace::enable (false);
+    if (path)
+        Trace::dump (path);
+}
+
+class TraceEnvInit {
+public:
+    TraceEnvInit () {
+        const char *path = getenv (XCAM_TRACE_FILE_ENV);
+        if (!path || !*path)
+            return;
+        Trace::enable (true);
+        atexit (dump_trace_at_exit);
+    }
+};
+
+static TraceEnvInit trace_env_init;
+
+};
@@ -0,0 +1,107 @@
+/*
+ * xcam_trace.h - runtime tracing of pipeline spans
+ *
+ *  Copyright (c) 2015 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Author: Wind Yuan <feng.yuan@intel.com>
+ */
+
+#ifndef XCAM_TRACE_H
+#define XCAM_TRACE_H
+
+#include <base/xcam_defs.h>
+#include <base/xcam_common.h>
+#include <time.h>
+#include <atomic>
+
+#define XCAM_TRACE_DEFAULT_RING_SIZE 4096
+#define XCAM_TRACE_NAME_SIZE         48
+// rings of exited threads kept for dump, oldest dropped beyond it
+#define XCAM_TRACE_MAX_EXITED_RINGS  16
+// env var, trace file written at process exit, tracing enabled from start
+#define XCAM_TRACE_FILE_ENV          "XCAM_TRACE_FILE"
+
+#define XCAM_TRACE_CAT_HANDLER   "handler"
+#define XCAM_TRACE_CAT_KERNEL    "kernel"
+#define XCAM_TRACE_CAT_QUEUE     "queue"
+#define XCAM_TRACE_CAT_POOL      "pool"
+#define XCAM_TRACE_CAT_ANALYZER  "analyzer"
+#define XCAM_TRACE_CAT_PROCESSOR "processor"
+
+#define XCAM_TRACE_CONCAT_(a, b) a##b
+#define XCAM_TRACE_CONCAT(a, b) XCAM_TRACE_CONCAT_(a, b)
+
+// span from here to end of current scope, @category must be a string literal
+#define XCAM_TRACE_SCOPE(category, name) \
+    XCam::TraceScope XCAM_TRACE_CONCAT(_xcam_trace_scope_, __LINE__) (category, name)
+
+namespace XCam {
+
+/*
+ * Trace, spans recorded into a per-thread ring of last events,
+ * dumped as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+ * Recording is lock-free, each thread only writes its own ring;
+ * disable tracing before dump to get a consistent snapshot.
+ */
+class Trace {
+public:
+    static bool is_enabled () {
+        return _enabled.load (std::memory_order_relaxed);
+    }
+    static void enable (bool enable);
+    // events kept per thread, rounded up to power of 2, for rings created afterwards
+    static void set_ring_size (uint32_t size);
+
+    // monotonic time in nanoseconds
+    static int64_t now () {
+        struct timespec ts;
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * INT64_C(1000000000) + ts.tv_nsec;
+    }
+    static void record (const char *category, const char *name, int64_t start, int64_t end);
+
+    // rings of exited threads dropped once dumped
+    static bool dump (const char *path);
+    // drop recorded events and rings of exited threads
+    static void clear ();
+
+private:
+    static std::atomic<bool>    _enabled;
+};
+
+class TraceScope {
+public:
+    TraceScope (const char *category, const char *name)
+        : _category (category)
+        , _name (name)
+        , _start (Trace::is_enabled () ? Trace::now () : -1)
+    {}
+    ~TraceScope () {
+        if (_start >= 0)
+            Trace::record (_category, _name, _start, Trace::now ());
+    }
+
+private:
+    XCAM_DEAD_COPY (TraceScope);
+
+private:
+    const char   *_category;
+    const char   *_name;
+    int64_t       _start;
+};
+
+};
+
+#endif //XCAM_TRACE_H
@@ -26,7 +26,7 @@
 #endif
 
 #include <base/xcam_common.h>
-#include <xcam_obj_debug.h>
+#include <time.h>
 extern "C" {
 #include <linux/videodev2.h>
 }
@@ -119,6 +119,15 @@ linear_interpolate_p4(double value_lt, double value_rt,
     return value;
 }
 
+// monotonic time in microseconds, for measuring intervals
+inline int64_t
+xcam_get_monotonic_time ()
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return XCAM_TIMESPEC_2_USEC (now);
+}
+
 };
 
 #endif //XCAM_UTILS_H